@@ -0,0 +1,238 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "time.h"
+
+/* Wall-clock time in microseconds, for multi-threaded runs. */
+static inline uint64_t wall_usec(void)
+{
+	struct timespec t;
+	clk_gettime(CLK_REALTIME, &t);
+	return (uint64_t)t.tv_sec*1000000 + t.tv_nsec/1000;
+}
+
+/* Thread CPU time in nanoseconds, for timing short single-threaded steps. */
+static inline uint64_t cpu_nsec(void)
+{
+	struct timespec t;
+	clk_gettime(CLK_THREAD_CPUTIME, &t);
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+/*
+ * Cycle counter for timing single operations: the TSC on x86, serialized
+ * against earlier instructions. Elsewhere, a monotonic clock in
+ * nanoseconds. Convert with a ratio calibrated against clk_gettime().
+ */
+static inline uint64_t tsc_read(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_lfence();
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+#endif
+}
+
+/* Tick rate of tsc_read() and the cost of an empty measurement in ticks. */
+struct TscClock
+{
+	double nsPerTick;
+	uint64_t overhead;
+};
+
+/* Calibrate tsc_read() against clk_gettime(); takes about 50ms. */
+void tsc_calibrate(struct TscClock* c);
+
+/*
+ * Latency histogram (bench_hist.c): 2^HIST_SUB_BITS linear sub-buckets per
+ * power of two, i.e. about 3% relative precision over the 64-bit range.
+ */
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (2 * HIST_SUB + (64 - HIST_SUB_BITS - 1) * HIST_SUB)
+
+struct Hist
+{
+	uint64_t count[HIST_BUCKETS];
+	uint64_t n;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+};
+
+void hist_init(struct Hist* h);
+void hist_merge(struct Hist* into, const struct Hist* from);
+
+/* Value at or below which a fraction 'p' of the samples fall. */
+uint64_t hist_percentile(const struct Hist* h, double p);
+
+static inline int hist_index(uint64_t v)
+{
+	int shift;
+
+	if(v < 2 * HIST_SUB)
+		return (int)v;
+
+	shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return 2 * HIST_SUB + (shift - 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+}
+
+static inline void hist_record(struct Hist* h, uint64_t v)
+{
+	++h->count[hist_index(v)];
+	++h->n;
+	h->sum += v;
+	if(v < h->min)
+		h->min = v;
+	if(v > h->max)
+		h->max = v;
+}
+
+/*
+ * Hardware performance counters around a measured phase (bench_perf.c).
+ * perf_open() returns the number of events available, possibly 0; the
+ * harness then runs without them. perf_stop() reports each event's count
+ * since perf_start(), or a negative value if it is unavailable.
+ */
+enum
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_BRANCH_MISSES,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_NUM_EVENTS
+};
+
+#define PERF_NUM_GROUPS 2
+
+struct Perf
+{
+	int fd[PERF_NUM_EVENTS];
+	int numOpen;
+
+	/* per group: leader fd (-1 if none) and member events in read order */
+	int leader[PERF_NUM_GROUPS];
+	int members[PERF_NUM_GROUPS][PERF_NUM_EVENTS];
+	int numMembers[PERF_NUM_GROUPS];
+};
+
+extern const char* const perfEventNames[PERF_NUM_EVENTS];
+
+int perf_open(struct Perf* p);
+void perf_start(struct Perf* p);
+void perf_stop(struct Perf* p, double values[PERF_NUM_EVENTS]);
+void perf_close(struct Perf* p);
+
+/* Selection and output format for the workload suite. */
+struct SuiteOptions
+{
+	/* comma-separated names; 0 selects all */
+	const char* workloads;
+	const char* heaps;
+
+	/* heap sizes to sweep */
+	const int* sizes;
+	int numSizes;
+
+	/* JSON instead of CSV */
+	int json;
+
+	/* report hardware counters per operation */
+	int perf;
+};
+
+/*
+ * suite: named workloads (hold, edf, timer, dijkstra, topk) over every heap
+ * variant, for each size and for numSeeds consecutive seeds. Fails if the
+ * variants disagree on a workload's checksum.
+ */
+int bench_suite(int numSeeds, int numOps, const struct SuiteOptions* opts,
+                unsigned int seed);
+
+/*
+ * Other benchmark modes of heaptest.
+ * Each returns 0 on success and non-zero if a check failed.
+ */
+
+/* twheel: expiry order across cascades and cancels. */
+int bench_twheel(int numTrials, int numOps, int size, unsigned int seed);
+
+/* spill: spillheap against a reference sbinheap, with and without an array. */
+int bench_spill(int numTrials, int numOps, int size, unsigned int seed);
+
+/* shared: shbinheap recovery after killing a child that holds the lock. */
+int bench_shared(int numTrials, int numOps, int size, unsigned int seed);
+
+/* snapshot: sbinheap_save/load round trip, corrupt file, too small a heap. */
+int bench_snapshot(int numTrials, int size, unsigned int seed);
+
+/* cbinheap: multi-threaded stress test, then scaling against a locked sbinheap. */
+int bench_cbinheap(int numTrials, int numOps, int size, int numThreads,
+                   unsigned int seed);
+
+/* multiqueue: rank-error quality, then scaling against a locked sbinheap. */
+int bench_multiqueue(int numTrials, int numOps, int size, int numThreads,
+                     unsigned int seed);
+
+/* mpsc: producer-side insert latency, lock-free front-end vs. locked binheap. */
+int bench_mpsc(int numTrials, int numOps, int size, int numThreads,
+               unsigned int seed);
+
+/* cpuheap: global-EDF simulation, cpuheap vs. a linear scan over CPUs. */
+int bench_cpuheap(int numTrials, int numJobs, int nrCpus, unsigned int seed);
+
+/* build: incremental add vs. serial and parallel bulk build of an sbinheap. */
+int bench_build(int numTrials, int size, int numThreads, unsigned int seed);
+
+/* batch: one add at a time vs. append + add_batch, by batch size. */
+int bench_batch(int numTrials, int batch, int size, unsigned int seed);
+
+/* timerq: connection timeouts, lazy vs. per-change timerfd reprogramming. */
+int bench_timerq(int numTrials, int numOps, int size, unsigned int seed);
+
+/*
+ * verify: cost of verify and repair; 'corrupt' keys are changed in place
+ * before the repair.
+ */
+int bench_verify(int numTrials, int corrupt, int size, unsigned int seed);
+
+/* heaptop: lock-free peeks at a published top vs. peeking under the lock. */
+int bench_heaptop(int numTrials, int numOps, int size, int numThreads,
+                  unsigned int seed);
+
+/* rebuild: bounded-work incremental rebuild after a priority remap. */
+int bench_rebuild(int numTrials, int budget, int size, unsigned int seed);
+
+/* lazy: Dijkstra and deadline adjustment, eager vs. deferred decrease-key. */
+int bench_lazy(int numTrials, int degree, int n, unsigned int seed);
+
+/* iterate: for_each callbacks vs. for_each_entry macros. */
+int bench_iter(int numTrials, int numWalks, int size, unsigned int seed);
+
+/*
+ * latency: per-operation latency histograms (add, delete_root, delete) with
+ * tail percentiles; 'cold' flushes the heap from the caches before each
+ * operation.
+ */
+int bench_latency(int numTrials, int numOps, int size, int cold,
+                  unsigned int seed);
+
+/*
+ * contention: mixed add/delete_root/delete from 1..numThreads threads on
+ * a mutex-protected heap, a spinlock-protected heap, and per-thread heaps
+ * with periodic merging; throughput and latency per thread count.
+ */
+int bench_contend(int numTrials, int numOps, int size, int numThreads,
+                  unsigned int seed);
+
+/* prefetch: hold-model sift-down cost by prefetch distance, small and large. */
+int bench_prefetch(int numTrials, int numOps, int size, unsigned int seed);
+
+#endif
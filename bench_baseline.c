@@ -0,0 +1,662 @@
+#include <stdlib.h>
+
+#include "bench_suite.h"
+
+/*
+ * Reference priority queues for the benchmark suite, written the way a
+ * program without this library would: an array heap in the style of
+ * std::priority_queue (extended with a position index so that remove and
+ * decrease-key work), a red-black tree with a cached minimum (as with
+ * Linux's rb_root_cached), and a binomial heap.
+ * Keys are unique, so ties need no care.
+ */
+
+static void no_stats(void* h, struct heap_stats* s)
+{
+	static const struct heap_stats zero;
+	*s = zero;
+}
+
+
+/* Array heap: sifts move a hole instead of swapping. */
+
+struct ArrayHeap
+{
+	struct Item** a;
+	long size;
+};
+
+static void* ah_create(int maxSize)
+{
+	struct ArrayHeap* h = malloc(sizeof(*h));
+	h->a = malloc(sizeof(*h->a) * maxSize);
+	h->size = 0;
+	return h;
+}
+
+static void ah_destroy(void* h)
+{
+	free(((struct ArrayHeap*)h)->a);
+	free(h);
+}
+
+static inline void ah_place(struct ArrayHeap* h, long i, struct Item* it)
+{
+	h->a[i] = it;
+	it->pos = i;
+}
+
+static void ah_sift_up(struct ArrayHeap* h, long i, struct Item* it)
+{
+	while(i > 0)
+	{
+		long p = (i - 1) / 2;
+
+		if(!(it->key < h->a[p]->key))
+			break;
+		ah_place(h, i, h->a[p]);
+		i = p;
+	}
+	ah_place(h, i, it);
+}
+
+static void ah_sift_down(struct ArrayHeap* h, long i, struct Item* it)
+{
+	for(;;)
+	{
+		long c = 2 * i + 1;
+
+		if(c >= h->size)
+			break;
+		if(c + 1 < h->size && h->a[c + 1]->key < h->a[c]->key)
+			++c;
+		if(!(h->a[c]->key < it->key))
+			break;
+		ah_place(h, i, h->a[c]);
+		i = c;
+	}
+	ah_place(h, i, it);
+}
+
+static void ah_add(void* h, struct Item* it)
+{
+	struct ArrayHeap* heap = h;
+
+	ah_sift_up(heap, heap->size++, it);
+}
+
+static struct Item* ah_top(void* h)
+{
+	struct ArrayHeap* heap = h;
+
+	return heap->size ? heap->a[0] : 0;
+}
+
+static void ah_pop(void* h)
+{
+	struct ArrayHeap* heap = h;
+	struct Item* last = heap->a[--heap->size];
+
+	if(heap->size)
+		ah_sift_down(heap, 0, last);
+}
+
+static void ah_remove(void* h, struct Item* it)
+{
+	struct ArrayHeap* heap = h;
+	struct Item* last = heap->a[--heap->size];
+
+	if(last == it)
+		return;
+	if(last->key < it->key)
+		ah_sift_up(heap, it->pos, last);
+	else
+		ah_sift_down(heap, it->pos, last);
+}
+
+static void ah_decrease(void* h, struct Item* it)
+{
+	ah_sift_up(h, it->pos, it);
+}
+
+const struct HeapImpl arrayHeapImpl =
+{
+	"array", ah_create, ah_destroy, ah_add, ah_top, ah_pop, ah_remove,
+	ah_decrease, no_stats
+};
+
+
+/* Red-black tree (CLRS, with a sentinel) and a cached leftmost node. */
+
+struct RbTree
+{
+	struct Item nil;
+	struct Item* root;
+	struct Item* min;
+};
+
+static void* rb_create(int maxSize)
+{
+	struct RbTree* t = malloc(sizeof(*t));
+
+	t->nil.rb.red = 0;
+	t->nil.rb.parent = t->nil.rb.left = t->nil.rb.right = &t->nil;
+	t->root = &t->nil;
+	t->min = &t->nil;
+	return t;
+}
+
+static void rb_destroy(void* h)
+{
+	free(h);
+}
+
+static void rb_rotate_left(struct RbTree* t, struct Item* x)
+{
+	struct Item* y = x->rb.right;
+
+	x->rb.right = y->rb.left;
+	if(y->rb.left != &t->nil)
+		y->rb.left->rb.parent = x;
+	y->rb.parent = x->rb.parent;
+	if(x->rb.parent == &t->nil)
+		t->root = y;
+	else if(x == x->rb.parent->rb.left)
+		x->rb.parent->rb.left = y;
+	else
+		x->rb.parent->rb.right = y;
+	y->rb.left = x;
+	x->rb.parent = y;
+}
+
+static void rb_rotate_right(struct RbTree* t, struct Item* x)
+{
+	struct Item* y = x->rb.left;
+
+	x->rb.left = y->rb.right;
+	if(y->rb.right != &t->nil)
+		y->rb.right->rb.parent = x;
+	y->rb.parent = x->rb.parent;
+	if(x->rb.parent == &t->nil)
+		t->root = y;
+	else if(x == x->rb.parent->rb.right)
+		x->rb.parent->rb.right = y;
+	else
+		x->rb.parent->rb.left = y;
+	y->rb.right = x;
+	x->rb.parent = y;
+}
+
+static void rb_add(void* h, struct Item* z)
+{
+	struct RbTree* t = h;
+	struct Item* y = &t->nil;
+	struct Item* x = t->root;
+
+	while(x != &t->nil)
+	{
+		y = x;
+		x = (z->key < x->key) ? x->rb.left : x->rb.right;
+	}
+	z->rb.parent = y;
+	if(y == &t->nil)
+		t->root = z;
+	else if(z->key < y->key)
+		y->rb.left = z;
+	else
+		y->rb.right = z;
+	z->rb.left = z->rb.right = &t->nil;
+	z->rb.red = 1;
+
+	if(t->min == &t->nil || z->key < t->min->key)
+		t->min = z;
+
+	while(z->rb.parent->rb.red)
+	{
+		struct Item* p = z->rb.parent;
+		struct Item* g = p->rb.parent;
+
+		if(p == g->rb.left)
+		{
+			struct Item* u = g->rb.right;
+
+			if(u->rb.red)
+			{
+				p->rb.red = 0;
+				u->rb.red = 0;
+				g->rb.red = 1;
+				z = g;
+				continue;
+			}
+			if(z == p->rb.right)
+			{
+				z = p;
+				rb_rotate_left(t, z);
+				p = z->rb.parent;
+			}
+			p->rb.red = 0;
+			g->rb.red = 1;
+			rb_rotate_right(t, g);
+		}
+		else
+		{
+			struct Item* u = g->rb.left;
+
+			if(u->rb.red)
+			{
+				p->rb.red = 0;
+				u->rb.red = 0;
+				g->rb.red = 1;
+				z = g;
+				continue;
+			}
+			if(z == p->rb.left)
+			{
+				z = p;
+				rb_rotate_right(t, z);
+				p = z->rb.parent;
+			}
+			p->rb.red = 0;
+			g->rb.red = 1;
+			rb_rotate_left(t, g);
+		}
+	}
+	t->root->rb.red = 0;
+}
+
+static struct Item* rb_minimum(struct RbTree* t, struct Item* x)
+{
+	while(x->rb.left != &t->nil)
+		x = x->rb.left;
+	return x;
+}
+
+static void rb_transplant(struct RbTree* t, struct Item* u, struct Item* v)
+{
+	if(u->rb.parent == &t->nil)
+		t->root = v;
+	else if(u == u->rb.parent->rb.left)
+		u->rb.parent->rb.left = v;
+	else
+		u->rb.parent->rb.right = v;
+	v->rb.parent = u->rb.parent;
+}
+
+static void rb_erase_fixup(struct RbTree* t, struct Item* x)
+{
+	while(x != t->root && !x->rb.red)
+	{
+		struct Item* p = x->rb.parent;
+
+		if(x == p->rb.left)
+		{
+			struct Item* w = p->rb.right;
+
+			if(w->rb.red)
+			{
+				w->rb.red = 0;
+				p->rb.red = 1;
+				rb_rotate_left(t, p);
+				w = p->rb.right;
+			}
+			if(!w->rb.left->rb.red && !w->rb.right->rb.red)
+			{
+				w->rb.red = 1;
+				x = p;
+				continue;
+			}
+			if(!w->rb.right->rb.red)
+			{
+				w->rb.left->rb.red = 0;
+				w->rb.red = 1;
+				rb_rotate_right(t, w);
+				w = p->rb.right;
+			}
+			w->rb.red = p->rb.red;
+			p->rb.red = 0;
+			w->rb.right->rb.red = 0;
+			rb_rotate_left(t, p);
+			x = t->root;
+		}
+		else
+		{
+			struct Item* w = p->rb.left;
+
+			if(w->rb.red)
+			{
+				w->rb.red = 0;
+				p->rb.red = 1;
+				rb_rotate_right(t, p);
+				w = p->rb.left;
+			}
+			if(!w->rb.right->rb.red && !w->rb.left->rb.red)
+			{
+				w->rb.red = 1;
+				x = p;
+				continue;
+			}
+			if(!w->rb.left->rb.red)
+			{
+				w->rb.right->rb.red = 0;
+				w->rb.red = 1;
+				rb_rotate_left(t, w);
+				w = p->rb.left;
+			}
+			w->rb.red = p->rb.red;
+			p->rb.red = 0;
+			w->rb.left->rb.red = 0;
+			rb_rotate_right(t, p);
+			x = t->root;
+		}
+	}
+	x->rb.red = 0;
+}
+
+static void rb_remove(void* h, struct Item* z)
+{
+	struct RbTree* t = h;
+	struct Item* y = z;
+	struct Item* x;
+	int wasRed = y->rb.red;
+
+	if(z == t->min)
+	{
+		/* the minimum has no left child: its successor is close by */
+		t->min = (z->rb.right != &t->nil) ? rb_minimum(t, z->rb.right) : z->rb.parent;
+	}
+
+	if(z->rb.left == &t->nil)
+	{
+		x = z->rb.right;
+		rb_transplant(t, z, z->rb.right);
+	}
+	else if(z->rb.right == &t->nil)
+	{
+		x = z->rb.left;
+		rb_transplant(t, z, z->rb.left);
+	}
+	else
+	{
+		y = rb_minimum(t, z->rb.right);
+		wasRed = y->rb.red;
+		x = y->rb.right;
+		if(y->rb.parent == z)
+		{
+			x->rb.parent = y;
+		}
+		else
+		{
+			rb_transplant(t, y, y->rb.right);
+			y->rb.right = z->rb.right;
+			y->rb.right->rb.parent = y;
+		}
+		rb_transplant(t, z, y);
+		y->rb.left = z->rb.left;
+		y->rb.left->rb.parent = y;
+		y->rb.red = z->rb.red;
+	}
+
+	if(!wasRed)
+		rb_erase_fixup(t, x);
+}
+
+static struct Item* rb_top(void* h)
+{
+	struct RbTree* t = h;
+
+	return (t->min != &t->nil) ? t->min : 0;
+}
+
+static void rb_pop(void* h)
+{
+	rb_remove(h, ((struct RbTree*)h)->min);
+}
+
+static void rb_decrease(void* h, struct Item* it)
+{
+	rb_remove(h, it);
+	rb_add(h, it);
+}
+
+const struct HeapImpl rbtreeImpl =
+{
+	"rbtree", rb_create, rb_destroy, rb_add, rb_top, rb_pop, rb_remove,
+	rb_decrease, no_stats
+};
+
+
+/*
+ * Binomial heap. Nodes come from a pool, and decrease-key swaps items
+ * between nodes, so each item tracks the node currently holding it.
+ */
+
+struct BinomialNode
+{
+	struct Item* item;
+	struct BinomialNode* parent;
+	struct BinomialNode* child;
+	struct BinomialNode* sibling;
+	int degree;
+};
+
+struct BinomialHeap
+{
+	struct BinomialNode* pool;
+	struct BinomialNode* free;
+
+	/* roots by increasing degree */
+	struct BinomialNode* head;
+
+	/* root with the minimum, or 0 if not known */
+	struct BinomialNode* min;
+};
+
+static void* bh_create(int maxSize)
+{
+	struct BinomialHeap* h = malloc(sizeof(*h));
+	int i;
+
+	h->pool = malloc(sizeof(*h->pool) * maxSize);
+	h->free = 0;
+	for(i = maxSize - 1; i >= 0; --i)
+	{
+		h->pool[i].sibling = h->free;
+		h->free = &h->pool[i];
+	}
+	h->head = 0;
+	h->min = 0;
+	return h;
+}
+
+static void bh_destroy(void* h)
+{
+	free(((struct BinomialHeap*)h)->pool);
+	free(h);
+}
+
+/* Merge two root lists by degree. */
+static struct BinomialNode* bh_merge(struct BinomialNode* a, struct BinomialNode* b)
+{
+	struct BinomialNode head;
+	struct BinomialNode* tail = &head;
+
+	while(a && b)
+	{
+		if(a->degree <= b->degree)
+		{
+			tail->sibling = a;
+			a = a->sibling;
+		}
+		else
+		{
+			tail->sibling = b;
+			b = b->sibling;
+		}
+		tail = tail->sibling;
+	}
+	tail->sibling = a ? a : b;
+	return head.sibling;
+}
+
+static void bh_link(struct BinomialNode* child, struct BinomialNode* parent)
+{
+	child->parent = parent;
+	child->sibling = parent->child;
+	parent->child = child;
+	++parent->degree;
+}
+
+static void bh_union(struct BinomialHeap* h, struct BinomialNode* list)
+{
+	struct BinomialNode *prev = 0, *x, *next;
+
+	h->head = bh_merge(h->head, list);
+	if(!h->head)
+		return;
+
+	x = h->head;
+	next = x->sibling;
+	while(next)
+	{
+		if(x->degree != next->degree ||
+		   (next->sibling && next->sibling->degree == x->degree))
+		{
+			prev = x;
+			x = next;
+		}
+		else if(x->item->key < next->item->key)
+		{
+			x->sibling = next->sibling;
+			bh_link(next, x);
+		}
+		else
+		{
+			if(prev)
+				prev->sibling = next;
+			else
+				h->head = next;
+			bh_link(x, next);
+			x = next;
+		}
+		next = x->sibling;
+	}
+}
+
+static void bh_add(void* h, struct Item* it)
+{
+	struct BinomialHeap* heap = h;
+	struct BinomialNode* node = heap->free;
+
+	heap->free = node->sibling;
+	node->item = it;
+	node->parent = node->child = node->sibling = 0;
+	node->degree = 0;
+	it->binom = node;
+
+	/* a new minimum wins every link, so it stays a root */
+	if(heap->min && it->key < heap->min->item->key)
+		heap->min = node;
+	bh_union(heap, node);
+	if(!heap->min && heap->head == node && !node->sibling)
+		heap->min = node;
+}
+
+static struct Item* bh_top(void* h)
+{
+	struct BinomialHeap* heap = h;
+
+	if(!heap->head)
+		return 0;
+	if(!heap->min)
+	{
+		struct BinomialNode* r;
+
+		heap->min = heap->head;
+		for(r = heap->head->sibling; r; r = r->sibling)
+		{
+			if(r->item->key < heap->min->item->key)
+				heap->min = r;
+		}
+	}
+	return heap->min->item;
+}
+
+/* Remove root 'root' and put its children back. */
+static void bh_remove_root(struct BinomialHeap* heap, struct BinomialNode* root)
+{
+	struct BinomialNode *prev = 0, *r, *child, *rev = 0;
+
+	for(r = heap->head; r != root; r = r->sibling)
+		prev = r;
+	if(prev)
+		prev->sibling = root->sibling;
+	else
+		heap->head = root->sibling;
+
+	/* children are by decreasing degree; reverse into a root list */
+	child = root->child;
+	while(child)
+	{
+		struct BinomialNode* next = child->sibling;
+
+		child->parent = 0;
+		child->sibling = rev;
+		rev = child;
+		child = next;
+	}
+	bh_union(heap, rev);
+
+	root->sibling = heap->free;
+	heap->free = root;
+	heap->min = 0;
+}
+
+static void bh_pop(void* h)
+{
+	struct BinomialHeap* heap = h;
+
+	(void)bh_top(h);
+	bh_remove_root(heap, heap->min);
+}
+
+/* Move an item up to its node's parent; returns the parent. */
+static struct BinomialNode* bh_swap_up(struct BinomialNode* node)
+{
+	struct BinomialNode* p = node->parent;
+	struct Item* it = node->item;
+
+	node->item = p->item;
+	node->item->binom = node;
+	p->item = it;
+	it->binom = p;
+	return p;
+}
+
+static void bh_decrease(void* h, struct Item* it)
+{
+	struct BinomialHeap* heap = h;
+	struct BinomialNode* node = it->binom;
+
+	while(node->parent && it->key < node->parent->item->key)
+		node = bh_swap_up(node);
+
+	if(!node->parent && heap->min && it->key < heap->min->item->key)
+		heap->min = node;
+}
+
+static void bh_remove(void* h, struct Item* it)
+{
+	struct BinomialHeap* heap = h;
+	struct BinomialNode* node = it->binom;
+
+	/* as if decreased to minus infinity */
+	while(node->parent)
+		node = bh_swap_up(node);
+	bh_remove_root(heap, node);
+}
+
+const struct HeapImpl binomialHeapImpl =
+{
+	"binomial", bh_create, bh_destroy, bh_add, bh_top, bh_pop, bh_remove,
+	bh_decrease, no_stats
+};
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Batched insert: a producer delivers 'batch' new keys at once into a heap
+ * of 'size' entries, which then drops back to 'size' by popping. Only the
+ * inserts are timed: one add at a time vs. append + add_batch.
+ */
+
+struct BatchData
+{
+	uint64_t key;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	return binheap_entry(A, struct BatchData, heap_node)->key <
+	       binheap_entry(B, struct BatchData, heap_node)->key;
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return sbinheap_entry(A, struct BatchData, sheap_node)->key <
+	       sbinheap_entry(B, struct BatchData, sheap_node)->key;
+}
+
+/*
+ * Where new keys fall relative to the heap's. 'sorted' is a run of keys
+ * below the heap's in descending order, the worst case for sift-up.
+ */
+enum { KEYS_RANDOM, KEYS_LATER, KEYS_EARLIER, KEYS_SORTED, NUM_KEY_KINDS };
+static const char* keyNames[] = {"random", "later", "earlier", "sorted"};
+
+/*
+ * Keys of the next batch. 'base' is the current time: popped keys are
+ * below it, heap keys within [base, base + span).
+ */
+static void next_keys(struct BatchData** batch, int n, int kind, uint64_t base,
+                      uint64_t span, unsigned int* seed)
+{
+	int i;
+
+	for(i = 0; i < n; ++i)
+	{
+		uint64_t r = rand_r(seed) % span;
+
+		if(kind == KEYS_LATER)
+			batch[i]->key = base + span + r;
+		else if(kind == KEYS_EARLIER)
+			batch[i]->key = base - span + r;
+		else if(kind == KEYS_SORTED)
+			batch[i]->key = base - 1 - i;
+		else
+			batch[i]->key = base + r;
+	}
+}
+
+/*
+ * One trial for one heap and method. Returns the total insert time in ns,
+ * and a checksum of popped keys in 'check'; 0 time means an invalid heap.
+ */
+static uint64_t run(int sbin, int batched, int kind, int numBatches, int batch,
+                    int size, unsigned int seed, uint64_t* check)
+{
+	struct BatchData* items = malloc(sizeof(*items) * (size + batch));
+	struct BatchData** free_items = malloc(sizeof(*free_items) * batch);
+	struct binheap bheap;
+	struct sbinheap sheap;
+	const uint64_t span = (uint64_t)1 << 40;
+	uint64_t base = span, nsec = 0;
+	int i, b, ok = 1;
+
+	INIT_BINHEAP(&bheap, less);
+	sheap.compare = sless;
+	sheap.max_size = size + batch;
+	sheap.buf = malloc(sizeof(*sheap.buf) * (size + batch));
+	INIT_SBINHEAP(&sheap);
+
+	for(i = 0; i < size + batch; ++i)
+	{
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		INIT_SBINHEAP_NODE(&items[i].sheap_node);
+	}
+	for(i = 0; i < size; ++i)
+	{
+		items[i].key = base + rand_r(&seed) % span;
+		if(sbin)
+			sbinheap_add(&items[i].sheap_node, &sheap, struct BatchData, sheap_node);
+		else
+			binheap_add(&items[i].heap_node, &bheap, struct BatchData, heap_node);
+	}
+	for(i = 0; i < batch; ++i)
+		free_items[i] = &items[size + i];
+
+	*check = 0;
+	for(b = 0; b < numBatches && ok; ++b)
+	{
+		uint64_t start;
+		idx_t first = sheap.size;
+
+		next_keys(free_items, batch, kind, base, span, &seed);
+
+		start = cpu_nsec();
+		for(i = 0; i < batch; ++i)
+		{
+			struct BatchData* d = free_items[i];
+
+			if(sbin && batched)
+				sbinheap_append(&d->sheap_node, &sheap, struct BatchData, sheap_node);
+			else if(sbin)
+				sbinheap_add(&d->sheap_node, &sheap, struct BatchData, sheap_node);
+			else if(batched)
+				binheap_append(&d->heap_node, &bheap, struct BatchData, heap_node);
+			else
+				binheap_add(&d->heap_node, &bheap, struct BatchData, heap_node);
+		}
+		if(sbin && batched)
+			sbinheap_add_batch(&sheap, first);
+		else if(batched)
+			binheap_add_batch(&bheap);
+		nsec += cpu_nsec() - start;
+
+		/* the first batches of small heaps are checked */
+		if(b < 64 && size + batch <= 4096)
+		{
+			if(sbin)
+				ok = (sbinheap_verify(&sheap) == SBINHEAP_VERIFY_OK);
+			else
+				ok = (binheap_verify(&bheap) == BINHEAP_VERIFY_OK);
+		}
+
+		/* back to 'size' entries; popped entries make up the next batch */
+		for(i = 0; i < batch; ++i)
+		{
+			struct BatchData* d;
+
+			if(sbin)
+				d = sbinheap_delete_root(&sheap, struct BatchData, sheap_node);
+			else
+				d = binheap_delete_root(&bheap, struct BatchData, heap_node);
+			*check = *check * 31 + d->key;
+			free_items[i] = d;
+			if(d->key > base)
+				base = d->key;
+		}
+	}
+
+	free(sheap.buf);
+	free(free_items);
+	free(items);
+
+	return ok ? (nsec ? nsec : 1) : 0;
+}
+
+int bench_batch(int numTrials, int batch, int size, unsigned int seed)
+{
+	static const char* methods[] = {"add", "add_batch"};
+	int numBatches, kind, sbin, m, t;
+
+	if(batch <= 0 || size < 0)
+		return 0;
+
+	/* about a million inserts per trial */
+	numBatches = 1000000 / batch + 1;
+
+	printf("%d batches of %d into a heap of %d, %d trials; ns per insert\n",
+		numBatches, batch, size, numTrials);
+	printf("%-9s %-8s %12s %12s\n", "heap", "keys", methods[0], methods[1]);
+
+	for(sbin = 0; sbin < 2; ++sbin)
+	{
+		for(kind = 0; kind < NUM_KEY_KINDS; ++kind)
+		{
+			uint64_t sums[2] = {0, 0};
+
+			for(t = 0; t < numTrials; ++t)
+			{
+				uint64_t check[2];
+
+				for(m = 0; m < 2; ++m)
+				{
+					uint64_t nsec = run(sbin, m, kind, numBatches, batch, size,
+					                    seed + t, &check[m]);
+
+					if(!nsec)
+					{
+						printf("%s %s produced an invalid heap!\n",
+							sbin ? "sbinheap" : "binheap", methods[m]);
+						return 1;
+					}
+					sums[m] += nsec;
+				}
+				if(check[0] != check[1])
+				{
+					printf("%s add_batch popped a different sequence!\n",
+						sbin ? "sbinheap" : "binheap");
+					return 1;
+				}
+			}
+
+			printf("%-9s %-8s %12.2f %12.2f\n", sbin ? "sbinheap" : "binheap",
+				keyNames[kind],
+				(double)sums[0] / numTrials / ((double)numBatches * batch),
+				(double)sums[1] / numTrials / ((double)numBatches * batch));
+		}
+	}
+	printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sbinheap.h"
+#include "sbinheap_parallel.h"
+
+#include "bench.h"
+
+struct BData
+{
+	unsigned int val;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct BData* a = sbinheap_entry(A, struct BData, sheap_node);
+	struct BData* b = sbinheap_entry(B, struct BData, sheap_node);
+
+	return(a->val < b->val);
+}
+
+/* Heap order and back-references must hold at every node. */
+static int check_heap(struct sbinheap* heap, int size)
+{
+	idx_t i;
+
+	if(heap->size != size)
+		return 0;
+
+	for(i = 0; i < heap->size; ++i)
+	{
+		struct sbinheap_node* n = heap->buf + i;
+
+		if(n->idx != i || *(n->ref_ptr) != n ||
+		   &((struct BData*)n->data)->sheap_node != n->ref_ptr)
+			return 0;
+		if(i > 0 && less(n, heap->buf + (i - 1) / 2))
+			return 0;
+	}
+	return 1;
+}
+
+static void fill(struct BData* data, int size, unsigned int seed)
+{
+	int i;
+
+	for(i = 0; i < size; ++i)
+	{
+		data[i].val = rand_r(&seed);
+		INIT_SBINHEAP_NODE(&data[i].sheap_node);
+	}
+}
+
+/* method: 0 = one __sbinheap_add() at a time, 1 = serial build, else parallel */
+static uint64_t build(struct sbinheap* heap, struct BData* data, int size,
+                      int method, int numThreads)
+{
+	uint64_t start;
+	int i;
+
+	INIT_SBINHEAP(heap);
+
+	start = wall_usec();
+	for(i = 0; i < size; ++i)
+	{
+		if(method == 0)
+			sbinheap_add(&data[i].sheap_node, heap, struct BData, sheap_node);
+		else
+			sbinheap_append(&data[i].sheap_node, heap, struct BData, sheap_node);
+	}
+	if(method == 1)
+		sbinheap_build(heap);
+	else if(method == 2)
+		(void)sbinheap_build_parallel(heap, numThreads);
+
+	return wall_usec() - start;
+}
+
+int bench_build(int numTrials, int size, int numThreads, unsigned int seed)
+{
+	static const char* names[] = {"incremental add", "serial build", "parallel build"};
+	struct sbinheap heap;
+	struct BData* data;
+	uint64_t sums[3] = {0, 0, 0};
+	int t, m, failed = 0;
+
+	if(size <= 0)
+		return 0;
+
+	data = malloc(sizeof(*data) * size);
+	heap.compare = less;
+	heap.max_size = size;
+	heap.buf = malloc(sizeof(*heap.buf) * size);
+	if(!data || !heap.buf)
+	{
+		printf("out of memory\n");
+		free(heap.buf);
+		free(data);
+		return 1;
+	}
+
+	for(t = 0; t < numTrials && !failed; ++t)
+	{
+		for(m = 0; m < 3; ++m)
+		{
+			fill(data, size, seed + t);
+			sums[m] += build(&heap, data, size, m, numThreads);
+			if(!check_heap(&heap, size))
+			{
+				printf("%s produced an invalid heap!\n", names[m]);
+				failed = 1;
+				break;
+			}
+		}
+	}
+
+	if(!failed)
+	{
+		printf("bulk load of %d entries, %d threads\n", size, numThreads);
+		for(m = 0; m < 3; ++m)
+			printf("%s time (microseconds): %f\n", names[m], (float)sums[m] / numTrials);
+		printf("\n");
+	}
+
+	free(heap.buf);
+	free(data);
+
+	return failed;
+}
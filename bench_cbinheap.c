@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "cbinheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+static const int RANGE = 10000;
+
+struct CData
+{
+	int val;
+	int inHeap;
+	sbinheap_node_t sheap_node;
+};
+
+static int cless(const struct cbinheap_node* A, const struct cbinheap_node* B)
+{
+	struct CData* a = cbinheap_entry(A, struct CData, unused);
+	struct CData* b = cbinheap_entry(B, struct CData, unused);
+
+	return(a->val < b->val);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct CData* a = sbinheap_entry(A, struct CData, sheap_node);
+	struct CData* b = sbinheap_entry(B, struct CData, sheap_node);
+
+	return(a->val < b->val);
+}
+
+struct Worker
+{
+	pthread_t thread;
+	int id;
+	int numThreads;
+	int numOps;
+	unsigned int seed;
+
+	struct CData* items;
+	int numItems;
+
+	struct cbinheap* cheap;
+	struct sbinheap* sheap;
+	pthread_mutex_t* lock;
+
+	int errors;
+};
+
+/* Mixed add/delete_root. Every popped item must have been in the heap. */
+static void* stress_worker(void* arg)
+{
+	struct Worker* w = arg;
+	int op;
+
+	for(op = 0; op < w->numOps; ++op)
+	{
+		if(rand_r(&w->seed) & 1)
+		{
+			/* insert one of our own items that is not in the heap */
+			int i = w->id + w->numThreads*(rand_r(&w->seed) % (w->numItems / w->numThreads));
+			struct CData* d = &w->items[i];
+
+			if(__atomic_load_n(&d->inHeap, __ATOMIC_ACQUIRE))
+				continue;
+
+			d->val = rand_r(&w->seed) % RANGE;
+			__atomic_store_n(&d->inHeap, 1, __ATOMIC_RELEASE);
+			if(cbinheap_add(d, w->cheap) != 0)
+			{
+				++w->errors;
+			}
+		}
+		else
+		{
+			struct CData* d = cbinheap_delete_root(w->cheap, struct CData);
+			if(d && __atomic_exchange_n(&d->inHeap, 0, __ATOMIC_ACQ_REL) != 1)
+			{
+				/* delivered twice */
+				++w->errors;
+			}
+		}
+	}
+	return 0;
+}
+
+static int stress_cbinheap(int numOps, int size, int numThreads, unsigned int seed)
+{
+	struct cbinheap_node* buf = calloc(CBINHEAP_BUF_SIZE(size), sizeof(*buf));
+	struct CData* items = calloc(size, sizeof(*items));
+	struct Worker* workers = calloc(numThreads, sizeof(*workers));
+	struct cbinheap heap = {cless, 0, 0, size, 0, buf};
+	int i, errors = 0, inHeap = 0, drained = 0, last = -1;
+
+	INIT_CBINHEAP(&heap);
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		workers[i].id = i;
+		workers[i].numThreads = numThreads;
+		workers[i].numOps = numOps;
+		workers[i].seed = seed + i;
+		workers[i].items = items;
+		workers[i].numItems = size;
+		workers[i].cheap = &heap;
+		pthread_create(&workers[i].thread, 0, stress_worker, &workers[i]);
+	}
+	for(i = 0; i < numThreads; ++i)
+	{
+		pthread_join(workers[i].thread, 0);
+		errors += workers[i].errors;
+	}
+
+	/* quiescent: the heap must drain in order and hold exactly the marked items */
+	for(i = 0; i < size; ++i)
+	{
+		inHeap += items[i].inHeap;
+	}
+	while(!cbinheap_empty(&heap))
+	{
+		struct CData* d = cbinheap_delete_root(&heap, struct CData);
+		if(d->val < last || !d->inHeap)
+			++errors;
+		last = d->val;
+		d->inHeap = 0;
+		++drained;
+	}
+	if(drained != inHeap)
+		++errors;
+
+	free(workers);
+	free(items);
+	free(buf);
+
+	return errors;
+}
+
+/* Hold model: delete the root and re-insert it with a new key. */
+static void* hold_worker(void* arg)
+{
+	struct Worker* w = arg;
+	int op;
+
+	for(op = 0; op < w->numOps; ++op)
+	{
+		struct CData* d;
+
+		if(w->cheap)
+		{
+			d = cbinheap_delete_root(w->cheap, struct CData);
+			d->val += rand_r(&w->seed) % RANGE;
+			cbinheap_add(d, w->cheap);
+		}
+		else
+		{
+			pthread_mutex_lock(w->lock);
+			d = sbinheap_top_entry(w->sheap, struct CData, sheap_node);
+			(void)sbinheap_delete_root(w->sheap, struct CData, sheap_node);
+			pthread_mutex_unlock(w->lock);
+
+			d->val += rand_r(&w->seed) % RANGE;
+
+			pthread_mutex_lock(w->lock);
+			sbinheap_add(&d->sheap_node, w->sheap, struct CData, sheap_node);
+			pthread_mutex_unlock(w->lock);
+		}
+	}
+	return 0;
+}
+
+/* Returns average wall time per trial in microseconds. */
+static float scale_test(int useCbinheap, int numTrials, int numOps, int size,
+                        int numThreads, unsigned int seed)
+{
+	struct cbinheap_node* cbuf = calloc(CBINHEAP_BUF_SIZE(size), sizeof(*cbuf));
+	struct sbinheap_node* sbuf = calloc(size, sizeof(*sbuf));
+	struct CData* items = calloc(size, sizeof(*items));
+	struct Worker* workers = calloc(numThreads, sizeof(*workers));
+	struct cbinheap cheap = {cless, 0, 0, size, 0, cbuf};
+	struct sbinheap sheap = {sless, 0, size, sbuf};
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	uint64_t total = 0;
+	int i, t;
+
+	for(t = 0; t < numTrials; ++t)
+	{
+		uint64_t start;
+
+		INIT_CBINHEAP(&cheap);
+		INIT_SBINHEAP(&sheap);
+		srand(seed);
+
+		/* half full, so every thread always finds a root to take */
+		for(i = 0; i < size / 2; ++i)
+		{
+			items[i].val = rand() % RANGE;
+			if(useCbinheap)
+				cbinheap_add(&items[i], &cheap);
+			else
+				sbinheap_add(&items[i].sheap_node, &sheap, struct CData, sheap_node);
+		}
+
+		start = wall_usec();
+		for(i = 0; i < numThreads; ++i)
+		{
+			workers[i].numOps = numOps / numThreads;
+			workers[i].seed = seed + i;
+			workers[i].cheap = useCbinheap ? &cheap : 0;
+			workers[i].sheap = &sheap;
+			workers[i].lock = &lock;
+			pthread_create(&workers[i].thread, 0, hold_worker, &workers[i]);
+		}
+		for(i = 0; i < numThreads; ++i)
+		{
+			pthread_join(workers[i].thread, 0);
+		}
+		total += wall_usec() - start;
+	}
+
+	free(workers);
+	free(items);
+	free(sbuf);
+	free(cbuf);
+
+	return (float)total / numTrials;
+}
+
+int bench_cbinheap(int numTrials, int numOps, int size, int numThreads,
+                   unsigned int seed)
+{
+	int p, errors;
+
+	if(size < 2*numThreads)
+	{
+		fprintf(stderr, "heap_size must be at least twice the thread count\n");
+		return -1;
+	}
+
+	printf("starting cbinheap stress test (%d threads)...\n", numThreads); fflush(0);
+	errors = stress_cbinheap(numOps, size, numThreads, seed);
+	printf("cbinheap stress errors: %d\n\n", errors); fflush(0);
+
+	printf("threads, cbinheap time (microseconds), locked sbinheap time (microseconds)\n");
+	for(p = 1; p <= numThreads; p *= 2)
+	{
+		float c = scale_test(1, numTrials, numOps, size, p, seed);
+		float s = scale_test(0, numTrials, numOps, size, p, seed);
+		printf("%d, %f, %f\n", p, c, s); fflush(0);
+
+		if(p < numThreads && 2*p > numThreads)
+			p = numThreads / 2;
+	}
+	printf("\n");
+
+	return errors;
+}
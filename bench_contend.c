@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Heaps shared by N threads doing a mix of add, delete_root and delete
+ * (of a random element), under three protection schemes:
+ *
+ *  mutex      one sbinheap behind a pthread mutex
+ *  spinlock   the same behind a test-and-test-and-set spinlock
+ *  perthread  each thread works on its own small heap without locking and
+ *             periodically merges it into a shared heap (under the mutex),
+ *             taking back a batch of the globally smallest elements; pops
+ *             are therefore only approximately in order
+ *
+ * Each operation is timed individually, so both throughput and the
+ * latency distribution (including lock waits) are reported per thread
+ * count.
+ */
+
+static const int RANGE = 10000;
+
+/* elements each thread holds outside the heap at the start */
+#define FREE_PER_THREAD 64
+
+/* perthread: local heap capacity, merge period and batch taken back */
+#define LOCAL_MAX 256
+#define MERGE_EVERY 256
+#define LOCAL_BATCH 32
+
+enum Scheme { MUTEX, SPINLOCK, PERTHREAD, NUM_SCHEMES };
+static const char* schemeNames[NUM_SCHEMES] = {"mutex", "spinlock", "perthread"};
+
+struct CItem
+{
+	uint64_t key;
+	sbinheap_node_t hnode;
+};
+
+static int less(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct CItem* a = sbinheap_entry(A, struct CItem, hnode);
+	struct CItem* b = sbinheap_entry(B, struct CItem, hnode);
+
+	return(a->key < b->key);
+}
+
+struct Shared
+{
+	enum Scheme scheme;
+	struct sbinheap heap;
+	pthread_mutex_t mutex;
+	int spin;
+};
+
+struct Worker
+{
+	pthread_t thread;
+	struct Shared* shared;
+	const struct TscClock* clk;
+	int numOps;
+	unsigned int seed;
+
+	/* elements this thread removed and may add again */
+	struct CItem** free;
+	int numFree;
+
+	/* perthread scheme */
+	struct sbinheap local;
+
+	/* base for new keys: the last key this thread removed */
+	uint64_t now;
+
+	struct Hist hist;
+};
+
+static inline void lock(struct Shared* s)
+{
+	if(s->scheme == SPINLOCK)
+	{
+		while(__atomic_exchange_n(&s->spin, 1, __ATOMIC_ACQUIRE))
+		{
+			while(__atomic_load_n(&s->spin, __ATOMIC_RELAXED))
+				cpu_relax();
+		}
+	}
+	else
+	{
+		pthread_mutex_lock(&s->mutex);
+	}
+}
+
+static inline void unlock(struct Shared* s)
+{
+	if(s->scheme == SPINLOCK)
+		__atomic_store_n(&s->spin, 0, __ATOMIC_RELEASE);
+	else
+		pthread_mutex_unlock(&s->mutex);
+}
+
+static inline void add(struct Worker* w, struct sbinheap* heap)
+{
+	struct CItem* it = w->free[--w->numFree];
+
+	it->key = w->now + rand_r(&w->seed) % RANGE;
+	sbinheap_add(&it->hnode, heap, struct CItem, hnode);
+}
+
+static inline void take(struct Worker* w, struct CItem* it)
+{
+	w->now = it->key;
+	w->free[w->numFree++] = it;
+}
+
+static inline void delete_root(struct Worker* w, struct sbinheap* heap)
+{
+	struct CItem* it = sbinheap_top_entry(heap, struct CItem, hnode);
+
+	(void)sbinheap_delete_root(heap, struct CItem, hnode);
+	take(w, it);
+}
+
+static inline void delete_any(struct Worker* w, struct sbinheap* heap)
+{
+	struct sbinheap_node* node = &heap->buf[rand_r(&w->seed) % heap->size];
+
+	take(w, __sbinheap_delete(node, heap));
+}
+
+/* perthread: move up to LOCAL_BATCH of the smallest shared elements here. */
+static void refill_locked(struct Worker* w)
+{
+	struct sbinheap* shared = &w->shared->heap;
+	int i;
+
+	for(i = 0; i < LOCAL_BATCH && !sbinheap_empty(shared); ++i)
+	{
+		struct CItem* it = sbinheap_top_entry(shared, struct CItem, hnode);
+
+		(void)sbinheap_delete_root(shared, struct CItem, hnode);
+		sbinheap_add(&it->hnode, &w->local, struct CItem, hnode);
+	}
+}
+
+/* perthread: merge the local heap into the shared one, then refill. */
+static void merge(struct Worker* w)
+{
+	struct sbinheap* shared = &w->shared->heap;
+
+	lock(w->shared);
+	while(!sbinheap_empty(&w->local))
+	{
+		struct CItem* it = sbinheap_top_entry(&w->local, struct CItem, hnode);
+
+		(void)sbinheap_delete_root(&w->local, struct CItem, hnode);
+		sbinheap_add(&it->hnode, shared, struct CItem, hnode);
+	}
+	refill_locked(w);
+	unlock(w->shared);
+}
+
+/* One operation: 0-1 add, 2 delete_root, 3 delete; falls back when it can't. */
+static void shared_op(struct Worker* w, int op)
+{
+	struct Shared* s = w->shared;
+
+	lock(s);
+	if(op >= 2 && sbinheap_empty(&s->heap))
+		op = 0;
+	if(op < 2 && !w->numFree)
+		op = 2;
+	if(op >= 2 && sbinheap_empty(&s->heap))
+	{
+		/* nothing free and nothing to delete */
+		unlock(s);
+		return;
+	}
+
+	if(op < 2)
+		add(w, &s->heap);
+	else if(op == 2)
+		delete_root(w, &s->heap);
+	else
+		delete_any(w, &s->heap);
+	unlock(s);
+}
+
+static void local_op(struct Worker* w, int op, int i)
+{
+	if(i % MERGE_EVERY == MERGE_EVERY - 1)
+		merge(w);
+
+	if(op < 2 && !w->numFree)
+		op = 2;
+	if(op >= 2 && sbinheap_empty(&w->local))
+	{
+		lock(w->shared);
+		refill_locked(w);
+		unlock(w->shared);
+		if(sbinheap_empty(&w->local))
+			op = 0;
+	}
+	if(op < 2 && !w->numFree)
+		return;
+
+	if(op < 2)
+	{
+		if(w->local.size == LOCAL_MAX)
+			merge(w);
+		add(w, &w->local);
+	}
+	else if(op == 2)
+	{
+		delete_root(w, &w->local);
+	}
+	else
+	{
+		delete_any(w, &w->local);
+	}
+}
+
+static void* worker(void* arg)
+{
+	struct Worker* w = arg;
+	uint64_t overhead = w->clk->overhead;
+	int i;
+
+	for(i = 0; i < w->numOps; ++i)
+	{
+		int op = rand_r(&w->seed) % 4;
+		uint64_t start = tsc_read(), d;
+
+		if(w->shared->scheme == PERTHREAD)
+			local_op(w, op, i);
+		else
+			shared_op(w, op);
+
+		d = tsc_read() - start;
+		hist_record(&w->hist, d > overhead ? d - overhead : 0);
+	}
+	return 0;
+}
+
+/*
+ * One run with 'numThreads' threads. Adds the time taken to 'elapsed' and
+ * the latencies to 'hist'. Returns non-zero if elements went missing.
+ */
+static int contend(enum Scheme scheme, int numOps, int size, int numThreads,
+                   unsigned int seed, const struct TscClock* clk,
+                   uint64_t* elapsed, struct Hist* hist)
+{
+	const int total = size + numThreads * FREE_PER_THREAD;
+	struct Shared s;
+	struct Worker* workers = calloc(numThreads, sizeof(*workers));
+	struct CItem* items = calloc(total, sizeof(*items));
+	struct CItem** freeBuf = malloc(sizeof(*freeBuf) * (size_t)total * numThreads);
+	struct sbinheap_node* localBuf =
+		malloc(sizeof(*localBuf) * (size_t)LOCAL_MAX * numThreads);
+	uint64_t start;
+	int i, held;
+
+	s.scheme = scheme;
+	s.spin = 0;
+	pthread_mutex_init(&s.mutex, 0);
+	s.heap.compare = less;
+	s.heap.max_size = total;
+	s.heap.buf = malloc(sizeof(*s.heap.buf) * total);
+	INIT_SBINHEAP(&s.heap);
+
+	for(i = 0; i < size; ++i)
+	{
+		items[i].key = rand_r(&seed) % RANGE;
+		sbinheap_add(&items[i].hnode, &s.heap, struct CItem, hnode);
+	}
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		struct Worker* w = &workers[i];
+		int f;
+
+		w->shared = &s;
+		w->clk = clk;
+		w->numOps = numOps / numThreads;
+		w->seed = seed + i;
+		w->free = freeBuf + (size_t)i * total;
+		for(f = 0; f < FREE_PER_THREAD; ++f)
+			w->free[w->numFree++] = &items[size + i * FREE_PER_THREAD + f];
+		w->local.compare = less;
+		w->local.max_size = LOCAL_MAX;
+		w->local.buf = localBuf + (size_t)i * LOCAL_MAX;
+		INIT_SBINHEAP(&w->local);
+		hist_init(&w->hist);
+	}
+
+	start = wall_usec();
+	for(i = 0; i < numThreads; ++i)
+		pthread_create(&workers[i].thread, 0, worker, &workers[i]);
+	for(i = 0; i < numThreads; ++i)
+		pthread_join(workers[i].thread, 0);
+	*elapsed += wall_usec() - start;
+
+	/* every element is in the shared heap, a local heap or a free list */
+	held = s.heap.size;
+	for(i = 0; i < numThreads; ++i)
+	{
+		held += workers[i].local.size + workers[i].numFree;
+		hist_merge(hist, &workers[i].hist);
+	}
+
+	pthread_mutex_destroy(&s.mutex);
+	free(s.heap.buf);
+	free(localBuf);
+	free(freeBuf);
+	free(items);
+	free(workers);
+
+	if(held != total)
+	{
+		printf("%s: %d of %d elements accounted for!\n", schemeNames[scheme],
+			held, total);
+		return 1;
+	}
+	return 0;
+}
+
+int bench_contend(int numTrials, int numOps, int size, int numThreads,
+                  unsigned int seed)
+{
+	struct TscClock clk;
+	struct Hist* hist = malloc(sizeof(*hist));
+	int scheme, p, t, failed = 0;
+
+	tsc_calibrate(&clk);
+
+	printf("scheme, threads, ops per microsecond, p50 (ns), p99 (ns), "
+		"p99.9 (ns), max (ns)\n");
+	for(scheme = 0; scheme < NUM_SCHEMES && !failed; ++scheme)
+	{
+		/* 1, 2, 4, ..., then numThreads itself */
+		for(p = 1; p <= numThreads && !failed;
+		    p = (p < numThreads && 2*p > numThreads) ? numThreads : 2*p)
+		{
+			uint64_t elapsed = 0;
+
+			hist_init(hist);
+			for(t = 0; t < numTrials && !failed; ++t)
+			{
+				failed |= contend(scheme, numOps, size, p, seed + t, &clk,
+					&elapsed, hist);
+			}
+
+			printf("%s, %d, %f, %.0f, %.0f, %.0f, %.0f\n", schemeNames[scheme], p,
+				(double)hist->n / (elapsed ? elapsed : 1),
+				hist_percentile(hist, 0.50) * clk.nsPerTick,
+				hist_percentile(hist, 0.99) * clk.nsPerTick,
+				hist_percentile(hist, 0.999) * clk.nsPerTick,
+				hist->max * clk.nsPerTick);
+			fflush(stdout);
+		}
+	}
+	printf("\n");
+
+	free(hist);
+	return failed;
+}
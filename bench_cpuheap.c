@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+#include "cpuheap.h"
+
+#include "bench.h"
+
+/*
+ * Global-EDF simulation. Jobs are released at random times with random
+ * relative deadlines and execution times. On each release, the scheduler
+ * looks up the CPU running the lowest-priority (latest-deadline) job and
+ * preempts it if the new job has an earlier deadline; otherwise the job
+ * waits in a ready queue. Completions pull the earliest-deadline ready job.
+ *
+ * The same simulation runs once with cpuheap and once with a linear scan
+ * over the CPUs, so the difference is the cost of the preemption checks.
+ * Preemption counts can differ slightly since the two break ties between
+ * equal-priority CPUs differently.
+ */
+
+struct Job
+{
+	uint64_t deadline;
+	uint64_t remaining;
+	struct binheap_node ready_node;
+};
+
+struct Cpu
+{
+	struct Job* job;
+	uint64_t finish;
+	sbinheap_node_t finish_node;
+
+	/* for the linear-scan variant */
+	uint64_t prio;
+};
+
+struct Sim
+{
+	int useCpuheap;
+	int nrCpus;
+	struct Cpu* cpus;
+
+	struct cpuheap cheap;
+
+	/* ready jobs by deadline */
+	struct binheap ready;
+
+	/* busy CPUs by completion time */
+	struct sbinheap finish;
+
+	long preemptions;
+	long mismatches;
+};
+
+static int ready_less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct Job* a = binheap_entry(A, struct Job, ready_node);
+	struct Job* b = binheap_entry(B, struct Job, ready_node);
+
+	return(a->deadline < b->deadline);
+}
+
+static int finish_less(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct Cpu* a = sbinheap_entry(A, struct Cpu, finish_node);
+	struct Cpu* b = sbinheap_entry(B, struct Cpu, finish_node);
+
+	return(a->finish < b->finish);
+}
+
+static void set_prio(struct Sim* s, int cpu, uint64_t prio)
+{
+	if(s->useCpuheap)
+		cpuheap_update(&s->cheap, cpu, prio);
+	if(s->useCpuheap != 1)
+		s->cpus[cpu].prio = prio;
+}
+
+/* CPU running the lowest-priority job, and that priority. */
+static int find_lowest(struct Sim* s, uint64_t* prio)
+{
+	int i, lowest = 0;
+
+	if(s->useCpuheap == 1)
+	{
+		cpuheap_read_lowest(&s->cheap, &lowest, prio);
+		return lowest;
+	}
+
+	for(i = 1; i < s->nrCpus; ++i)
+	{
+		if(s->cpus[i].prio > s->cpus[lowest].prio)
+			lowest = i;
+	}
+	*prio = s->cpus[lowest].prio;
+
+	if(s->useCpuheap == 2)
+	{
+		/* verifying: ties may pick a different CPU, but not a different prio */
+		int cpu;
+		uint64_t heapPrio;
+
+		cpuheap_read_lowest(&s->cheap, &cpu, &heapPrio);
+		if(heapPrio != *prio || s->cpus[cpu].prio != heapPrio)
+			s->mismatches++;
+		return cpu;
+	}
+	return lowest;
+}
+
+/* Run 'job' (or nothing) on 'cpu' starting at time 'now'. */
+static void dispatch(struct Sim* s, int cpu, struct Job* job, uint64_t now)
+{
+	struct Cpu* c = &s->cpus[cpu];
+	int wasBusy = (c->job != 0);
+
+	c->job = job;
+	if(job)
+	{
+		c->finish = now + job->remaining;
+		if(wasBusy)
+			sbinheap_update(c->finish_node, &s->finish);
+		else
+			sbinheap_add(&c->finish_node, &s->finish, struct Cpu, finish_node);
+		set_prio(s, cpu, job->deadline);
+	}
+	else
+	{
+		if(wasBusy)
+			(void)sbinheap_delete(&c->finish_node, &s->finish);
+		set_prio(s, cpu, CPUHEAP_IDLE);
+	}
+}
+
+static void complete_until(struct Sim* s, uint64_t now)
+{
+	while(!sbinheap_empty(&s->finish))
+	{
+		struct Cpu* c = sbinheap_top_entry(&s->finish, struct Cpu, finish_node);
+		struct Job* next = 0;
+		uint64_t when = c->finish;
+
+		if(when > now)
+			break;
+
+		if(!binheap_empty(&s->ready))
+		{
+			next = binheap_top_entry(&s->ready, struct Job, ready_node);
+			(void)binheap_delete_root(&s->ready, struct Job, ready_node);
+		}
+		dispatch(s, (int)(c - s->cpus), next, when);
+	}
+}
+
+static void release(struct Sim* s, struct Job* job, uint64_t now)
+{
+	uint64_t lowestPrio;
+	int lowest = find_lowest(s, &lowestPrio);
+
+	if(job->deadline < lowestPrio)
+	{
+		struct Job* preempted = s->cpus[lowest].job;
+
+		if(preempted)
+		{
+			preempted->remaining = s->cpus[lowest].finish - now;
+			binheap_add(&preempted->ready_node, &s->ready, struct Job, ready_node);
+			++s->preemptions;
+		}
+		dispatch(s, lowest, job, now);
+	}
+	else
+	{
+		binheap_add(&job->ready_node, &s->ready, struct Job, ready_node);
+	}
+}
+
+/*
+ * useCpuheap: 0 = linear scan, 1 = cpuheap, 2 = cpuheap checked against a
+ * scan. Returns CPU time in microseconds.
+ */
+static uint64_t simulate(int useCpuheap, int numJobs, int nrCpus,
+                         unsigned int seed, long* preemptions, long* mismatches)
+{
+	struct Sim s;
+	struct Job* jobs = calloc(numJobs, sizeof(*jobs));
+	struct cpuheap_entry* entries = calloc(nrCpus, sizeof(*entries));
+	struct sbinheap_node* cbuf = calloc(nrCpus, sizeof(*cbuf));
+	struct sbinheap_node* fbuf = calloc(nrCpus, sizeof(*fbuf));
+	struct timespec start, end, diff;
+	uint64_t now = 0;
+	int i;
+
+	s.useCpuheap = useCpuheap;
+	s.nrCpus = nrCpus;
+	s.cpus = calloc(nrCpus, sizeof(*s.cpus));
+	s.preemptions = 0;
+	s.mismatches = 0;
+	for(i = 0; i < nrCpus; ++i)
+		s.cpus[i].prio = CPUHEAP_IDLE;
+	cpuheap_init(&s.cheap, entries, cbuf, nrCpus);
+	INIT_BINHEAP(&s.ready, ready_less);
+	s.finish.compare = finish_less;
+	s.finish.max_size = nrCpus;
+	s.finish.buf = fbuf;
+	INIT_SBINHEAP(&s.finish);
+
+	/* pre-generate jobs so both variants see identical work */
+	srand(seed);
+	for(i = 0; i < numJobs; ++i)
+	{
+		INIT_BINHEAP_NODE(&jobs[i].ready_node);
+		jobs[i].remaining = 100 + rand() % 1000;
+		jobs[i].deadline = jobs[i].remaining + rand() % 10000;
+	}
+
+	clk_gettime(CLK_THREAD_CPUTIME, &start);
+	for(i = 0; i < numJobs; ++i)
+	{
+		/* releases keep the system slightly overloaded */
+		now += rand() % (1200 / nrCpus + 1);
+		jobs[i].deadline += now;
+
+		complete_until(&s, now);
+		release(&s, &jobs[i], now);
+	}
+	complete_until(&s, UINT64_MAX);
+	clk_gettime(CLK_THREAD_CPUTIME, &end);
+
+	timediff(&start, &end, &diff);
+	*preemptions = s.preemptions;
+	*mismatches = s.mismatches;
+
+	free(s.cpus);
+	free(fbuf);
+	free(cbuf);
+	free(entries);
+	free(jobs);
+
+	return (uint64_t)diff.tv_sec*1000000 + diff.tv_nsec/1000;
+}
+
+int bench_cpuheap(int numTrials, int numJobs, int nrCpus, unsigned int seed)
+{
+	uint64_t sumHeap = 0, sumScan = 0;
+	long preemptHeap = 0, preemptScan = 0, mismatches = 0, bad;
+	int t;
+
+	if(nrCpus <= 0 || numJobs <= 0)
+		return 0;
+
+	/* an empty cpuheap reads as no CPU at idle priority */
+	{
+		struct cpuheap empty;
+		struct sbinheap_node ebuf[1];
+		uint64_t prio = 0;
+		int cpu = 0;
+
+		cpuheap_init(&empty, NULL, ebuf, 0);
+		cpuheap_read_lowest(&empty, &cpu, &prio);
+		if(cpu != -1 || prio != CPUHEAP_IDLE)
+		{
+			printf("empty cpuheap read cpu %d, priority %llu!\n",
+				cpu, (unsigned long long)prio);
+			return 1;
+		}
+	}
+
+	(void)simulate(2, numJobs, nrCpus, seed, &preemptHeap, &mismatches);
+	if(mismatches)
+	{
+		printf("cpuheap disagreed with the linear scan %ld times!\n", mismatches);
+		return 1;
+	}
+
+	for(t = 0; t < numTrials; ++t)
+	{
+		sumHeap += simulate(1, numJobs, nrCpus, seed + t, &preemptHeap, &bad);
+		sumScan += simulate(0, numJobs, nrCpus, seed + t, &preemptScan, &bad);
+	}
+
+	printf("G-EDF simulation: %d jobs on %d CPUs\n", numJobs, nrCpus);
+	printf("cpuheap time (microseconds): %f (preemptions: %ld)\n",
+		(float)sumHeap / numTrials, preemptHeap);
+	printf("linear scan time (microseconds): %f (preemptions: %ld)\n\n",
+		(float)sumScan / numTrials, preemptScan);
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "binheap.h"
+#include "heaptop.h"
+
+#include "bench.h"
+
+static const int RANGE = 10000;
+
+struct TData
+{
+	uint64_t val;
+	int idx;
+	struct binheap_node heap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct TData* a = binheap_entry(A, struct TData, heap_node);
+	struct TData* b = binheap_entry(B, struct TData, heap_node);
+
+	return(a->val < b->val);
+}
+
+/*
+ * The key also encodes the element's index, so a reader can tell whether
+ * a published (data, key) pair is consistent without dereferencing stale
+ * values.
+ */
+static uint64_t key_of(const void* data)
+{
+	const struct TData* d = data;
+	return d->val << 32 | (uint64_t)d->idx;
+}
+
+struct Shared
+{
+	int usePub;
+	int done;
+	struct binheap heap;
+	struct heaptop top;
+	pthread_mutex_t lock;
+};
+
+struct Reader
+{
+	pthread_t thread;
+	struct Shared* shared;
+	long reads;
+	long torn;
+};
+
+static void* reader(void* arg)
+{
+	struct Reader* r = arg;
+	struct Shared* s = r->shared;
+
+	while(!__atomic_load_n(&s->done, __ATOMIC_ACQUIRE))
+	{
+		void* data = 0;
+		uint64_t key = HEAPTOP_EMPTY_KEY;
+
+		if(s->usePub)
+		{
+			(void)heaptop_read(&s->top, &data, &key);
+		}
+		else
+		{
+			pthread_mutex_lock(&s->lock);
+			if(!binheap_empty(&s->heap))
+			{
+				data = binheap_top_entry(&s->heap, struct TData, heap_node);
+				key = key_of(data);
+			}
+			pthread_mutex_unlock(&s->lock);
+		}
+
+		if(data && (int)(key & 0xffffffff) != ((struct TData*)data)->idx)
+			++r->torn;
+		++r->reads;
+	}
+	return 0;
+}
+
+static int heaptop_test(int usePub, int numOps, int size, int numThreads,
+                        unsigned int seed)
+{
+	struct Shared s;
+	struct Reader* readers = calloc(numThreads, sizeof(*readers));
+	struct TData* items = calloc(size, sizeof(*items));
+	uint64_t start, elapsed;
+	long reads = 0, torn = 0;
+	int i;
+
+	s.usePub = usePub;
+	s.done = 0;
+	INIT_BINHEAP(&s.heap, less);
+	INIT_HEAPTOP(&s.top, key_of);
+	if(usePub)
+		binheap_publish_top(&s.heap, &s.top);
+	pthread_mutex_init(&s.lock, 0);
+
+	for(i = 0; i < size; ++i)
+	{
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		items[i].idx = i;
+		items[i].val = rand_r(&seed) % RANGE;
+		binheap_add(&items[i].heap_node, &s.heap, struct TData, heap_node);
+	}
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		readers[i].shared = &s;
+		pthread_create(&readers[i].thread, 0, reader, &readers[i]);
+	}
+
+	/* writer: hold model, pop the minimum and re-insert it later in time */
+	start = wall_usec();
+	for(i = 0; i < numOps; ++i)
+	{
+		struct TData* d;
+
+		pthread_mutex_lock(&s.lock);
+		d = binheap_top_entry(&s.heap, struct TData, heap_node);
+		(void)binheap_delete_root(&s.heap, struct TData, heap_node);
+		d->val += rand_r(&seed) % RANGE;
+		binheap_add(&d->heap_node, &s.heap, struct TData, heap_node);
+		pthread_mutex_unlock(&s.lock);
+	}
+	elapsed = wall_usec() - start;
+	__atomic_store_n(&s.done, 1, __ATOMIC_RELEASE);
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		pthread_join(readers[i].thread, 0);
+		reads += readers[i].reads;
+		torn += readers[i].torn;
+	}
+
+	printf("%s, %d, %f, %f\n", usePub ? "heaptop" : "mutex", numThreads,
+		(double)numOps / (elapsed ? elapsed : 1), (double)reads / (elapsed ? elapsed : 1));
+
+	pthread_mutex_destroy(&s.lock);
+	free(items);
+	free(readers);
+
+	if(torn)
+		printf("%ld inconsistent reads!\n", torn);
+	return torn ? 1 : 0;
+}
+
+int bench_heaptop(int numTrials, int numOps, int size, int numThreads,
+                  unsigned int seed)
+{
+	int t, failed = 0;
+
+	if(size <= 0)
+		return 0;
+
+	printf("peek, readers, writer ops per microsecond, reads per microsecond\n");
+	for(t = 0; t < numTrials && !failed; ++t)
+	{
+		failed |= heaptop_test(1, numOps, size, numThreads, seed + t);
+		failed |= heaptop_test(0, numOps, size, numThreads, seed + t);
+	}
+	printf("\n");
+
+	return failed;
+}
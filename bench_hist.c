@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "bench.h"
+
+void tsc_calibrate(struct TscClock* c)
+{
+	uint64_t t0, t1, w0, w1, best = UINT64_MAX;
+	int i;
+
+	w0 = wall_usec();
+	t0 = tsc_read();
+	do
+	{
+		w1 = wall_usec();
+	} while(w1 - w0 < 50000);
+	t1 = tsc_read();
+	c->nsPerTick = (double)(w1 - w0) * 1000.0 / (double)(t1 - t0);
+
+	for(i = 0; i < 10000; ++i)
+	{
+		uint64_t a = tsc_read();
+		uint64_t b = tsc_read();
+
+		if(b - a < best)
+			best = b - a;
+	}
+	c->overhead = best;
+}
+
+
+void hist_init(struct Hist* h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+void hist_merge(struct Hist* into, const struct Hist* from)
+{
+	int i;
+
+	for(i = 0; i < HIST_BUCKETS; ++i)
+		into->count[i] += from->count[i];
+	into->n += from->n;
+	into->sum += from->sum;
+	if(from->min < into->min)
+		into->min = from->min;
+	if(from->max > into->max)
+		into->max = from->max;
+}
+
+/* Highest value that falls in bucket 'i'. */
+static uint64_t hist_value(int i)
+{
+	int shift;
+	uint64_t top;
+
+	if(i < 2 * HIST_SUB)
+		return i;
+
+	shift = (i - 2 * HIST_SUB) / HIST_SUB + 1;
+	top = (i - 2 * HIST_SUB) % HIST_SUB + HIST_SUB;
+	return ((top + 1) << shift) - 1;
+}
+
+uint64_t hist_percentile(const struct Hist* h, double p)
+{
+	uint64_t want = (uint64_t)(p * h->n + 0.999999);
+	uint64_t seen = 0;
+	int i;
+
+	if(want == 0)
+		want = 1;
+	for(i = 0; i < HIST_BUCKETS; ++i)
+	{
+		seen += h->count[i];
+		if(seen >= want)
+			return hist_value(i) < h->max ? hist_value(i) : h->max;
+	}
+	return h->max;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+struct IData
+{
+	uint64_t val;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct IData* a = binheap_entry(A, struct IData, heap_node);
+	struct IData* b = binheap_entry(B, struct IData, heap_node);
+
+	return(a->val < b->val);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct IData* a = sbinheap_entry(A, struct IData, sheap_node);
+	struct IData* b = sbinheap_entry(B, struct IData, sheap_node);
+
+	return(a->val < b->val);
+}
+
+static void sum_node(struct binheap_node* node, void* args)
+{
+	*(uint64_t*)args += binheap_entry(node, struct IData, heap_node)->val;
+}
+
+static void sum_snode(sbinheap_node_t node, void* args)
+{
+	*(uint64_t*)args += sbinheap_entry(node, struct IData, sheap_node)->val;
+}
+
+/*
+ * Sum every element of a heap ('numWalks' times) with the for_each
+ * callbacks and with the for_each_entry macros.
+ */
+int bench_iter(int numTrials, int numWalks, int size, unsigned int seed)
+{
+	struct IData* items;
+	struct IData* pos;
+	struct binheap heap;
+	struct sbinheap sheap;
+	uint64_t expect = 0, sums[4] = {0, 0, 0, 0}, times[4] = {0, 0, 0, 0};
+	uint64_t start;
+	int t, w, i, failed = 0;
+
+	if(size <= 0 || numWalks <= 0)
+		return 0;
+
+	items = malloc(sizeof(*items) * size);
+	sheap.compare = sless;
+	sheap.max_size = size;
+	sheap.buf = malloc(sizeof(*sheap.buf) * size);
+
+	INIT_BINHEAP(&heap, less);
+	INIT_SBINHEAP(&sheap);
+	for(i = 0; i < size; ++i)
+	{
+		items[i].val = rand_r(&seed);
+		expect += items[i].val;
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		binheap_add(&items[i].heap_node, &heap, struct IData, heap_node);
+		sbinheap_add(&items[i].sheap_node, &sheap, struct IData, sheap_node);
+	}
+
+	for(t = 0; t < numTrials && !failed; ++t)
+	{
+		for(i = 0; i < 4; ++i)
+			sums[i] = 0;
+
+		start = cpu_nsec();
+		for(w = 0; w < numWalks; ++w)
+			binheap_for_each(&heap, sum_node, &sums[0]);
+		times[0] += cpu_nsec() - start;
+
+		start = cpu_nsec();
+		for(w = 0; w < numWalks; ++w)
+			binheap_for_each_entry(pos, &heap, struct IData, heap_node)
+				sums[1] += pos->val;
+		times[1] += cpu_nsec() - start;
+
+		start = cpu_nsec();
+		for(w = 0; w < numWalks; ++w)
+			sbinheap_for_each(&sheap, sum_snode, &sums[2]);
+		times[2] += cpu_nsec() - start;
+
+		start = cpu_nsec();
+		for(w = 0; w < numWalks; ++w)
+			sbinheap_for_each_entry(pos, &sheap, struct IData, sheap_node)
+				sums[3] += pos->val;
+		times[3] += cpu_nsec() - start;
+
+		for(i = 0; i < 4; ++i)
+			if(sums[i] != expect * numWalks)
+				failed = 1;
+	}
+
+	if(failed)
+	{
+		printf("an iteration missed or repeated elements!\n");
+	}
+	else
+	{
+		printf("walks over %d elements (nanoseconds per element)\n", size);
+		printf("binheap_for_each: %f\n", (double)times[0] / numTrials / numWalks / size);
+		printf("binheap_for_each_entry: %f\n", (double)times[1] / numTrials / numWalks / size);
+		printf("sbinheap_for_each: %f\n", (double)times[2] / numTrials / numWalks / size);
+		printf("sbinheap_for_each_entry: %f\n\n", (double)times[3] / numTrials / numWalks / size);
+	}
+
+	free(sheap.buf);
+	free(items);
+
+	return failed;
+}
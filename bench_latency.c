@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Per-operation latency. Every add, delete_root and delete is timed on its
+ * own with the cycle counter and recorded in a log-linear (HDR-style)
+ * histogram, so the tail (p99.9, max) is reported instead of an average.
+ *
+ * In cold mode the heap's memory is flushed from the caches before each
+ * operation (outside the timed region), approximating the worst case of a
+ * heap touched after the caller ran something else.
+ */
+
+static const int RANGE = 1000000;
+
+struct LatData
+{
+	uint64_t val;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct LatData* a = binheap_entry(A, struct LatData, heap_node);
+	struct LatData* b = binheap_entry(B, struct LatData, heap_node);
+
+	return(a->val < b->val);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct LatData* a = sbinheap_entry(A, struct LatData, sheap_node);
+	struct LatData* b = sbinheap_entry(B, struct LatData, sheap_node);
+
+	return(a->val < b->val);
+}
+
+
+/* Memory of the heap under test, for cold mode. */
+struct Footprint
+{
+	const void* base[2];
+	size_t len[2];
+	char* evict;
+	size_t evictLen;
+};
+
+static void flush(const struct Footprint* f)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	int r;
+	size_t off;
+
+	for(r = 0; r < 2; ++r)
+	{
+		for(off = 0; off < f->len[r]; off += 64)
+			__builtin_ia32_clflush((const char*)f->base[r] + off);
+	}
+	__builtin_ia32_mfence();
+#else
+	/* no portable flush; stream through a buffer larger than the LLC */
+	static volatile char sink;
+	size_t off;
+	char acc = 0;
+
+	for(off = 0; off < f->evictLen; off += 64)
+		acc ^= f->evict[off];
+	sink = acc;
+#endif
+}
+
+enum { OP_ADD, OP_DELETE_ROOT, OP_DELETE, NUM_OPS };
+static const char* opNames[NUM_OPS] = {"add", "delete_root", "delete"};
+
+struct LatRun
+{
+	struct Hist hist[NUM_OPS];
+	const struct TscClock* clk;
+	const struct Footprint* cold;
+};
+
+static inline uint64_t ticks_since(const struct LatRun* r, uint64_t start)
+{
+	uint64_t d = tsc_read() - start;
+
+	return d > r->clk->overhead ? d - r->clk->overhead : 0;
+}
+
+/*
+ * Times one operation. The flush stays outside the timed region and the
+ * statement runs between two counter reads.
+ */
+#define TIMED(r, op, stmt) \
+	do { \
+		uint64_t __t; \
+		if((r)->cold) \
+			flush((r)->cold); \
+		__t = tsc_read(); \
+		stmt; \
+		hist_record(&(r)->hist[op], ticks_since((r), __t)); \
+	} while(0)
+
+/* Fill, hold (delete_root + add), random delete + add, drain. */
+static void run_binheap(struct LatRun* r, struct LatData* items, int size,
+                        int numOps, unsigned int* seed)
+{
+	struct binheap heap;
+	int i;
+
+	INIT_BINHEAP(&heap, less);
+
+	for(i = 0; i < size; ++i)
+	{
+		struct LatData* d = &items[i];
+
+		d->val = rand_r(seed) % RANGE;
+		INIT_BINHEAP_NODE(&d->heap_node);
+		TIMED(r, OP_ADD, binheap_add(&d->heap_node, &heap, struct LatData, heap_node));
+	}
+	for(i = 0; i < numOps; ++i)
+	{
+		struct LatData* d = binheap_top_entry(&heap, struct LatData, heap_node);
+
+		TIMED(r, OP_DELETE_ROOT,
+			(void)binheap_delete_root(&heap, struct LatData, heap_node));
+		d->val += rand_r(seed) % RANGE;
+		TIMED(r, OP_ADD, binheap_add(&d->heap_node, &heap, struct LatData, heap_node));
+	}
+	for(i = 0; i < numOps; ++i)
+	{
+		struct LatData* d = &items[rand_r(seed) % size];
+
+		TIMED(r, OP_DELETE, (void)binheap_delete(&d->heap_node, &heap));
+		d->val = rand_r(seed) % RANGE;
+		TIMED(r, OP_ADD, binheap_add(&d->heap_node, &heap, struct LatData, heap_node));
+	}
+	while(!binheap_empty(&heap))
+	{
+		TIMED(r, OP_DELETE_ROOT,
+			(void)binheap_delete_root(&heap, struct LatData, heap_node));
+	}
+}
+
+static void run_sbinheap(struct LatRun* r, struct LatData* items,
+                         struct sbinheap* heap, int size, int numOps,
+                         unsigned int* seed)
+{
+	int i;
+
+	INIT_SBINHEAP(heap);
+
+	for(i = 0; i < size; ++i)
+	{
+		struct LatData* d = &items[i];
+
+		d->val = rand_r(seed) % RANGE;
+		TIMED(r, OP_ADD, sbinheap_add(&d->sheap_node, heap, struct LatData, sheap_node));
+	}
+	for(i = 0; i < numOps; ++i)
+	{
+		struct LatData* d = sbinheap_top_entry(heap, struct LatData, sheap_node);
+
+		TIMED(r, OP_DELETE_ROOT,
+			(void)sbinheap_delete_root(heap, struct LatData, sheap_node));
+		d->val += rand_r(seed) % RANGE;
+		TIMED(r, OP_ADD, sbinheap_add(&d->sheap_node, heap, struct LatData, sheap_node));
+	}
+	for(i = 0; i < numOps; ++i)
+	{
+		struct LatData* d = &items[rand_r(seed) % size];
+
+		TIMED(r, OP_DELETE, (void)sbinheap_delete(&d->sheap_node, heap));
+		d->val = rand_r(seed) % RANGE;
+		TIMED(r, OP_ADD, sbinheap_add(&d->sheap_node, heap, struct LatData, sheap_node));
+	}
+	while(!sbinheap_empty(heap))
+	{
+		TIMED(r, OP_DELETE_ROOT,
+			(void)sbinheap_delete_root(heap, struct LatData, sheap_node));
+	}
+}
+
+static void report(const char* name, const struct LatRun* r)
+{
+	double k = r->clk->nsPerTick;
+	int op;
+
+	printf("%-9s %-12s %10s %8s %8s %8s %8s %8s %8s %10s\n", name, "op", "count",
+		"min", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+	for(op = 0; op < NUM_OPS; ++op)
+	{
+		const struct Hist* h = &r->hist[op];
+
+		if(!h->n)
+			continue;
+		printf("%-9s %-12s %10llu %8.0f %8.0f %8.0f %8.0f %8.0f %8.0f %10.0f\n",
+			name, opNames[op], (unsigned long long)h->n,
+			h->min * k,
+			hist_percentile(h, 0.50) * k,
+			hist_percentile(h, 0.90) * k,
+			hist_percentile(h, 0.99) * k,
+			hist_percentile(h, 0.999) * k,
+			hist_percentile(h, 0.9999) * k,
+			h->max * k);
+	}
+	printf("\n");
+}
+
+#if !defined(__x86_64__) && !defined(__i386__)
+/* Twice the last-level cache, for the fallback eviction buffer. */
+static size_t evict_size(void)
+{
+	long llc = -1;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+	if(llc <= 0)
+		llc = 32 << 20;
+	return 2 * (size_t)llc;
+}
+#endif
+
+int bench_latency(int numTrials, int numOps, int size, int cold,
+                  unsigned int seed)
+{
+	struct TscClock clk;
+	struct Footprint fp;
+	struct LatRun* runs;
+	struct LatData* items;
+	struct sbinheap sheap;
+	int t, h;
+
+	if(size <= 0)
+		return 0;
+
+	runs = malloc(2 * sizeof(*runs));
+	items = calloc(size, sizeof(*items));
+	sheap.compare = sless;
+	sheap.max_size = size;
+	sheap.buf = malloc(sizeof(*sheap.buf) * size);
+
+	tsc_calibrate(&clk);
+	printf("timer: %.3f ns/tick, overhead %llu ticks (subtracted)\n",
+		clk.nsPerTick, (unsigned long long)clk.overhead);
+	printf("latencies in ns%s\n\n", cold ? ", caches flushed before each operation" : "");
+
+	memset(&fp, 0, sizeof(fp));
+	if(cold)
+	{
+		fp.base[0] = items;
+		fp.len[0] = sizeof(*items) * size;
+		fp.base[1] = sheap.buf;
+		fp.len[1] = sizeof(*sheap.buf) * size;
+#if !defined(__x86_64__) && !defined(__i386__)
+		fp.evictLen = evict_size();
+		fp.evict = malloc(fp.evictLen);
+		memset(fp.evict, 1, fp.evictLen);
+#endif
+	}
+
+	for(h = 0; h < 2; ++h)
+	{
+		hist_init(&runs[h].hist[OP_ADD]);
+		hist_init(&runs[h].hist[OP_DELETE_ROOT]);
+		hist_init(&runs[h].hist[OP_DELETE]);
+		runs[h].clk = &clk;
+		runs[h].cold = cold ? &fp : 0;
+	}
+
+	for(t = 0; t < numTrials; ++t)
+	{
+		unsigned int s = seed + t;
+
+		run_binheap(&runs[0], items, size, numOps, &s);
+		s = seed + t;
+		run_sbinheap(&runs[1], items, &sheap, size, numOps, &s);
+	}
+
+	report("binheap", &runs[0]);
+	report("sbinheap", &runs[1]);
+
+	free(fp.evict);
+	free(sheap.buf);
+	free(items);
+	free(runs);
+	return 0;
+}
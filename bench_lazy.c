@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+#include "lazyheap.h"
+
+#include "bench.h"
+
+#define INF (UINT64_MAX / 2)
+
+struct Vertex
+{
+	uint64_t dist;
+	int id;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+struct Edge
+{
+	int to;
+	int weight;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct Vertex* a = binheap_entry(A, struct Vertex, heap_node);
+	struct Vertex* b = binheap_entry(B, struct Vertex, heap_node);
+
+	return(a->dist < b->dist);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct Vertex* a = sbinheap_entry(A, struct Vertex, sheap_node);
+	struct Vertex* b = sbinheap_entry(B, struct Vertex, sheap_node);
+
+	return(a->dist < b->dist);
+}
+
+enum Variant
+{
+	EAGER_BINHEAP,
+	LAZY_BINHEAP,
+	EAGER_SBINHEAP,
+	LAZY_SBINHEAP,
+	NUM_VARIANTS
+};
+
+static const char* variantNames[] =
+{
+	"binheap", "lazy binheap", "sbinheap", "lazy sbinheap"
+};
+
+/*
+ * Dijkstra's algorithm with decrease-key over a random graph. Every vertex
+ * starts in the heap at INF; a round pops the closest vertex and relaxes
+ * its edges, so each round may decrease many keys before the next top.
+ */
+static uint64_t dijkstra(enum Variant v, struct Vertex* verts, int n,
+                         const struct Edge* edges, int degree,
+                         struct lazyheap_dirty* dirty)
+{
+	struct lazy_binheap lb;
+	struct lazy_sbinheap ls;
+	uint64_t start;
+	int i;
+
+	INIT_LAZY_BINHEAP(&lb, less, dirty, degree);
+	ls.heap.compare = sless;
+	ls.heap.max_size = n;
+	ls.heap.buf = malloc(sizeof(*ls.heap.buf) * n);
+	INIT_LAZY_SBINHEAP(&ls, dirty, degree);
+
+	for(i = 0; i < n; ++i)
+	{
+		verts[i].id = i;
+		verts[i].dist = i ? INF : 0;
+		INIT_BINHEAP_NODE(&verts[i].heap_node);
+		INIT_SBINHEAP_NODE(&verts[i].sheap_node);
+	}
+
+	start = cpu_nsec();
+	for(i = 0; i < n; ++i)
+	{
+		if(v <= LAZY_BINHEAP)
+			lazy_binheap_add(&verts[i].heap_node, &lb, struct Vertex, heap_node);
+		else
+			lazy_sbinheap_add(&verts[i].sheap_node, &ls, struct Vertex, sheap_node);
+	}
+
+	for(;;)
+	{
+		struct Vertex* u;
+		const struct Edge* e;
+
+		if(v <= LAZY_BINHEAP)
+		{
+			if(lazy_binheap_empty(&lb))
+				break;
+			u = lazy_binheap_top_entry(&lb, struct Vertex, heap_node);
+			(void)lazy_binheap_delete_root(&lb, struct Vertex, heap_node);
+		}
+		else
+		{
+			if(lazy_sbinheap_empty(&ls))
+				break;
+			u = lazy_sbinheap_top_entry(&ls, struct Vertex, sheap_node);
+			(void)lazy_sbinheap_delete_root(&ls, struct Vertex, sheap_node);
+		}
+		if(u->dist == INF)
+			continue;
+
+		for(e = edges + (size_t)u->id * degree; e < edges + (size_t)(u->id + 1) * degree; ++e)
+		{
+			struct Vertex* w = &verts[e->to];
+
+			if(u->dist + e->weight >= w->dist)
+				continue;
+			w->dist = u->dist + e->weight;
+
+			switch(v)
+			{
+				case EAGER_BINHEAP:
+					binheap_decrease(&w->heap_node, &lb.heap);
+					break;
+				case LAZY_BINHEAP:
+					lazy_binheap_decrease(&w->heap_node, &lb);
+					break;
+				case EAGER_SBINHEAP:
+					sbinheap_decrease(w->sheap_node, &ls.heap);
+					break;
+				default:
+					lazy_sbinheap_decrease(&w->sheap_node, &ls);
+					break;
+			}
+		}
+	}
+
+	free(ls.heap.buf);
+
+	return cpu_nsec() - start;
+}
+
+/* Size of the set of elements that deadline adjustments go to. */
+static const int HOT = 8;
+
+/*
+ * Deadline adjustment: each round decreases 'degree' keys drawn from a
+ * small hot set, so the same nodes are decreased repeatedly before the
+ * next top, then pops the minimum and re-inserts it later. The low bits of
+ * every key hold the element's id, so keys are unique and all variants pop
+ * the same sequence. Returns the sum of popped keys in 'check'.
+ */
+static uint64_t adjust(enum Variant v, struct Vertex* verts, int n, int degree,
+                       struct lazyheap_dirty* dirty, unsigned int seed,
+                       uint64_t* check)
+{
+	struct lazy_binheap lb;
+	struct lazy_sbinheap ls;
+	uint64_t start, step, sum = 0;
+	int i, r, d;
+
+	INIT_LAZY_BINHEAP(&lb, less, dirty, degree);
+	ls.heap.compare = sless;
+	ls.heap.max_size = n;
+	ls.heap.buf = malloc(sizeof(*ls.heap.buf) * n);
+	INIT_LAZY_SBINHEAP(&ls, dirty, degree);
+
+	for(i = 0; i < n; ++i)
+	{
+		verts[i].id = i;
+		verts[i].dist = ((uint64_t)(1 << 20) + rand_r(&seed) % (1 << 20)) << 24 | i;
+		INIT_BINHEAP_NODE(&verts[i].heap_node);
+		INIT_SBINHEAP_NODE(&verts[i].sheap_node);
+		if(v <= LAZY_BINHEAP)
+			lazy_binheap_add(&verts[i].heap_node, &lb, struct Vertex, heap_node);
+		else
+			lazy_sbinheap_add(&verts[i].sheap_node, &ls, struct Vertex, sheap_node);
+	}
+
+	start = cpu_nsec();
+	for(r = 0; r < n; ++r)
+	{
+		struct Vertex* u;
+
+		for(d = 0; d < degree; ++d)
+		{
+			struct Vertex* w = &verts[rand_r(&seed) % (n < HOT ? n : HOT)];
+
+			/* each adjustment moves the deadline earlier by a fraction */
+			step = (w->dist >> 24) / 8;
+			if(!step)
+				continue;
+			w->dist -= step << 24;
+
+			switch(v)
+			{
+				case EAGER_BINHEAP:
+					binheap_decrease(&w->heap_node, &lb.heap);
+					break;
+				case LAZY_BINHEAP:
+					lazy_binheap_decrease(&w->heap_node, &lb);
+					break;
+				case EAGER_SBINHEAP:
+					sbinheap_decrease(w->sheap_node, &ls.heap);
+					break;
+				default:
+					lazy_sbinheap_decrease(&w->sheap_node, &ls);
+					break;
+			}
+		}
+
+		if(v <= LAZY_BINHEAP)
+		{
+			u = lazy_binheap_top_entry(&lb, struct Vertex, heap_node);
+			(void)lazy_binheap_delete_root(&lb, struct Vertex, heap_node);
+		}
+		else
+		{
+			u = lazy_sbinheap_top_entry(&ls, struct Vertex, sheap_node);
+			(void)lazy_sbinheap_delete_root(&ls, struct Vertex, sheap_node);
+		}
+		sum += u->dist;
+
+		u->dist += ((uint64_t)(1 << 20) + rand_r(&seed) % (1 << 20)) << 24;
+		if(v <= LAZY_BINHEAP)
+			lazy_binheap_add(&u->heap_node, &lb, struct Vertex, heap_node);
+		else
+			lazy_sbinheap_add(&u->sheap_node, &ls, struct Vertex, sheap_node);
+	}
+
+	free(ls.heap.buf);
+
+	*check = sum;
+	return cpu_nsec() - start;
+}
+
+int bench_lazy(int numTrials, int degree, int n, unsigned int seed)
+{
+	struct Vertex* verts;
+	struct Edge* edges;
+	struct lazyheap_dirty* dirty;
+	uint64_t* reference;
+	uint64_t sums[NUM_VARIANTS] = {0};
+	uint64_t adjustSums[NUM_VARIANTS] = {0};
+	uint64_t check, refCheck = 0;
+	int t, v, i, failed = 0;
+
+	if(n <= 0 || degree <= 0)
+		return 0;
+
+	verts = malloc(sizeof(*verts) * n);
+	edges = malloc(sizeof(*edges) * (size_t)n * degree);
+	dirty = malloc(sizeof(*dirty) * degree);
+	reference = malloc(sizeof(*reference) * n);
+
+	for(t = 0; t < numTrials && !failed; ++t)
+	{
+		unsigned int s = seed + t;
+
+		for(i = 0; i < n * degree; ++i)
+		{
+			edges[i].to = rand_r(&s) % n;
+			edges[i].weight = 1 + rand_r(&s) % 100;
+		}
+
+		for(v = 0; v < NUM_VARIANTS; ++v)
+		{
+			sums[v] += dijkstra(v, verts, n, edges, degree, dirty);
+
+			/* all variants must find the same distances */
+			for(i = 0; i < n; ++i)
+			{
+				if(v == 0)
+					reference[i] = verts[i].dist;
+				else if(reference[i] != verts[i].dist)
+					failed = 1;
+			}
+			if(failed)
+			{
+				printf("%s found different distances!\n", variantNames[v]);
+				break;
+			}
+
+			adjustSums[v] += adjust(v, verts, n, degree, dirty, s, &check);
+			if(v == 0)
+				refCheck = check;
+			else if(check != refCheck)
+			{
+				printf("%s popped a different sequence!\n", variantNames[v]);
+				failed = 1;
+				break;
+			}
+		}
+	}
+
+	if(!failed)
+	{
+		printf("Dijkstra over %d vertices, out-degree %d\n", n, degree);
+		for(v = 0; v < NUM_VARIANTS; ++v)
+			printf("%s time (microseconds): %f\n", variantNames[v],
+				(double)sums[v] / 1000 / numTrials);
+		printf("\n");
+
+		printf("Deadline adjustment: %d decreases to %d hot entries per pop\n",
+			degree, HOT);
+		for(v = 0; v < NUM_VARIANTS; ++v)
+			printf("%s time (microseconds): %f\n", variantNames[v],
+				(double)adjustSums[v] / 1000 / numTrials);
+		printf("\n");
+	}
+
+	free(reference);
+	free(dirty);
+	free(edges);
+	free(verts);
+
+	return failed;
+}
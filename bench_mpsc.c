@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+#include "mpscheap.h"
+
+#include "bench.h"
+
+static const int RANGE = 10000;
+
+struct PData
+{
+	int val;
+	int free;
+	struct binheap_node heap_node;
+	struct mpsc_link link;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct PData* a = binheap_entry(A, struct PData, heap_node);
+	struct PData* b = binheap_entry(B, struct PData, heap_node);
+
+	return(a->val < b->val);
+}
+
+struct Shared
+{
+	int useMpsc;
+	struct mpsc_binheap q;
+	pthread_mutex_t lock;
+};
+
+struct Producer
+{
+	pthread_t thread;
+	struct Shared* shared;
+	struct PData* items;
+	int numItems;
+	int numOps;
+	unsigned int seed;
+
+	uint64_t totalNsec;
+	uint64_t maxNsec;
+};
+
+static uint64_t now_nsec(void)
+{
+	struct timespec t;
+	clk_gettime(CLK_REALTIME, &t);
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+static void* producer(void* arg)
+{
+	struct Producer* p = arg;
+	struct Shared* s = p->shared;
+	int op;
+
+	for(op = 0; op < p->numOps; ++op)
+	{
+		struct PData* d = &p->items[op % p->numItems];
+		uint64_t start, elapsed;
+
+		/* wait for the consumer to hand the item back */
+		while(!__atomic_load_n(&d->free, __ATOMIC_ACQUIRE))
+			sched_yield();
+		d->free = 0;
+		d->val = rand_r(&p->seed) % RANGE;
+
+		start = now_nsec();
+		if(s->useMpsc)
+		{
+			mpsc_binheap_add(&d->link, &d->heap_node, &s->q, struct PData, heap_node);
+		}
+		else
+		{
+			pthread_mutex_lock(&s->lock);
+			binheap_add(&d->heap_node, &s->q.heap, struct PData, heap_node);
+			pthread_mutex_unlock(&s->lock);
+		}
+		elapsed = now_nsec() - start;
+
+		p->totalNsec += elapsed;
+		if(elapsed > p->maxNsec)
+			p->maxNsec = elapsed;
+	}
+	return 0;
+}
+
+/* The owner pops until it has seen every pushed item. */
+static void consume(struct Shared* s, long total)
+{
+	long popped = 0;
+
+	while(popped < total)
+	{
+		struct PData* d = 0;
+
+		if(s->useMpsc)
+		{
+			if(!mpsc_binheap_empty(&s->q))
+			{
+				d = mpsc_binheap_top_entry(&s->q, struct PData, heap_node);
+				(void)mpsc_binheap_delete_root(&s->q, struct PData, heap_node);
+			}
+		}
+		else
+		{
+			pthread_mutex_lock(&s->lock);
+			if(!binheap_empty(&s->q.heap))
+			{
+				d = binheap_top_entry(&s->q.heap, struct PData, heap_node);
+				(void)binheap_delete_root(&s->q.heap, struct PData, heap_node);
+			}
+			pthread_mutex_unlock(&s->lock);
+		}
+
+		if(d)
+		{
+			__atomic_store_n(&d->free, 1, __ATOMIC_RELEASE);
+			++popped;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+}
+
+static void mpsc_test(int useMpsc, int numOps, int size, int numThreads,
+                      unsigned int seed)
+{
+	struct Shared s;
+	struct Producer* producers = calloc(numThreads, sizeof(*producers));
+	struct PData* items = calloc(size, sizeof(*items));
+	int perThread = size / numThreads;
+	uint64_t total = 0, worst = 0;
+	long pushes = 0;
+	int i;
+
+	s.useMpsc = useMpsc;
+	INIT_MPSC_BINHEAP(&s.q, less);
+	pthread_mutex_init(&s.lock, 0);
+
+	for(i = 0; i < size; ++i)
+	{
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		items[i].free = 1;
+	}
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		producers[i].shared = &s;
+		producers[i].items = items + i*perThread;
+		producers[i].numItems = perThread;
+		producers[i].numOps = numOps / numThreads;
+		producers[i].seed = seed + i;
+		pushes += producers[i].numOps;
+		pthread_create(&producers[i].thread, 0, producer, &producers[i]);
+	}
+
+	consume(&s, pushes);
+
+	for(i = 0; i < numThreads; ++i)
+	{
+		pthread_join(producers[i].thread, 0);
+		total += producers[i].totalNsec;
+		if(producers[i].maxNsec > worst)
+			worst = producers[i].maxNsec;
+	}
+
+	printf("%s, %d, %f, %llu\n", useMpsc ? "mpsc" : "mutex", numThreads,
+		(double)total / pushes, (unsigned long long)worst);
+
+	pthread_mutex_destroy(&s.lock);
+	free(items);
+	free(producers);
+}
+
+struct DData
+{
+	int val;
+	sbinheap_node_t hnode;
+	struct mpsc_link link;
+};
+
+static int dless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return ((struct DData*)A->data)->val < ((struct DData*)B->data)->val;
+}
+
+/*
+ * Deferral in the sbinheap front-end, single-threaded: 'numItems' pushes in
+ * random batches into a heap of a quarter the size, with somewhat fewer
+ * pops in between so links pile up deferred. Each drain must admit the
+ * oldest deferred links first, as many as fit, and every item must come
+ * out in the end.
+ */
+static int deferred_test(int numItems, unsigned int seed)
+{
+	struct DData* items = calloc(numItems, sizeof(*items));
+	struct mpsc_sbinheap q;
+	int pushed = 0, admitted = 0, popped = 0, ok = 1;
+	int i;
+
+	q.heap.compare = dless;
+	q.heap.max_size = numItems / 4 + 1;
+	q.heap.buf = calloc(q.heap.max_size, sizeof(*q.heap.buf));
+	INIT_MPSC_SBINHEAP(&q);
+
+	while(ok && popped < numItems)
+	{
+		int batch = rand_r(&seed) % 8;
+		int room, count;
+
+		for(i = 0; i < batch && pushed < numItems; ++i, ++pushed)
+		{
+			items[pushed].val = rand_r(&seed) % RANGE;
+			INIT_SBINHEAP_NODE(&items[pushed].hnode);
+			mpsc_sbinheap_add(&items[pushed].link, &items[pushed].hnode, &q,
+				struct DData, hnode);
+		}
+
+		room = q.heap.max_size - q.heap.size;
+		count = mpsc_sbinheap_drain(&q);
+		ok &= (count == ((pushed - admitted < room) ? pushed - admitted : room));
+		for(i = admitted; i < admitted + count; ++i)
+			ok &= sbinheap_is_in_heap(items[i].hnode);
+		admitted += count;
+		if(admitted < numItems)
+			ok &= !sbinheap_is_in_heap(items[admitted].hnode);
+
+		for(i = rand_r(&seed) % 6; i > 0 && !sbinheap_empty(&q.heap); --i)
+		{
+			(void)sbinheap_delete_root(&q.heap, struct DData, hnode);
+			++popped;
+		}
+	}
+	ok &= mpsc_sbinheap_empty(&q);
+
+	free(q.heap.buf);
+	free(items);
+
+	return ok;
+}
+
+int bench_mpsc(int numTrials, int numOps, int size, int numThreads,
+               unsigned int seed)
+{
+	int t;
+
+	if(size < numThreads)
+	{
+		fprintf(stderr, "heap_size must be at least the thread count\n");
+		return -1;
+	}
+
+	if(!deferred_test(4 * size, seed))
+	{
+		printf("mpsc_sbinheap admitted deferred items out of order or lost "
+			"one!\n");
+		return 1;
+	}
+
+	printf("front-end, producers, mean push time (nanoseconds), max push time (nanoseconds)\n");
+	for(t = 0; t < numTrials; ++t)
+	{
+		mpsc_test(1, numOps, size, numThreads, seed + t);
+		mpsc_test(0, numOps, size, numThreads, seed + t);
+	}
+	printf("\n");
+
+	return 0;
+}
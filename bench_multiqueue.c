@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "multiqueue.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/* shards per thread */
+static const int MQ_FACTOR = 2;
+
+/* keys are drawn from [0, KEYS) so ranks can be counted exactly */
+#define KEYS (1 << 20)
+
+struct MData
+{
+	struct multiqueue_node mq_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct MData* a = sbinheap_entry(A, struct MData, sheap_node);
+	struct MData* b = sbinheap_entry(B, struct MData, sheap_node);
+
+	return(a->mq_node.key < b->mq_node.key);
+}
+
+/* Shards are cache-line aligned, which calloc() does not guarantee. */
+static struct multiqueue_shard* alloc_shards(int nr_shards)
+{
+	size_t bytes = nr_shards*sizeof(struct multiqueue_shard);
+	void* shards = 0;
+	if(posix_memalign(&shards, 64, bytes) == 0)
+		memset(shards, 0, bytes);
+	return shards;
+}
+
+static uint32_t next_rand(uint32_t* state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return (*state = x);
+}
+
+/* Fenwick tree over key values: number of queued keys below k. */
+static void fenwick_add(int* tree, uint64_t key, int delta)
+{
+	for(uint64_t i = key + 1; i <= KEYS; i += i & -i)
+		tree[i] += delta;
+}
+
+static long fenwick_below(const int* tree, uint64_t key)
+{
+	long sum = 0;
+	for(uint64_t i = key; i > 0; i -= i & -i)
+		sum += tree[i];
+	return sum;
+}
+
+/*
+ * Rank error of each delete_min: the number of queued keys smaller than the
+ * one returned. Threads are interleaved round-robin in a single thread so
+ * ranks are exact.
+ */
+static void quality_test(int numOps, int size, int numThreads, unsigned int seed)
+{
+	int nr_shards = MQ_FACTOR*numThreads;
+	struct multiqueue_shard* shards = alloc_shards(nr_shards);
+	struct sbinheap_node* buf = calloc((size_t)nr_shards*size, sizeof(*buf));
+	struct MData* items = calloc(size, sizeof(*items));
+	uint32_t* rng = calloc(numThreads, sizeof(*rng));
+	int* tree = calloc(KEYS + 1, sizeof(*tree));
+	struct multiqueue mq;
+	double sumRank = 0;
+	long maxRank = 0;
+	int i, op;
+
+	multiqueue_init(&mq, shards, nr_shards, buf, size);
+	for(i = 0; i < numThreads; ++i)
+		rng[i] = seed + i + 1;
+
+	for(i = 0; i < size / 2; ++i)
+	{
+		uint64_t key = next_rand(&rng[0]) % KEYS;
+		multiqueue_add(&items[i].mq_node, &mq, key, &rng[i % numThreads]);
+		fenwick_add(tree, key, 1);
+	}
+
+	for(op = 0; op < numOps; ++op)
+	{
+		uint32_t* r = &rng[op % numThreads];
+		struct multiqueue_node* n = multiqueue_delete_min(&mq, r);
+		long rank = fenwick_below(tree, n->key);
+		uint64_t key = next_rand(r) % KEYS;
+
+		sumRank += rank;
+		if(rank > maxRank)
+			maxRank = rank;
+
+		fenwick_add(tree, n->key, -1);
+		multiqueue_add(n, &mq, key, r);
+		fenwick_add(tree, key, 1);
+	}
+
+	printf("%d, %d, %f, %ld\n", numThreads, nr_shards, sumRank / numOps, maxRank);
+
+	free(tree);
+	free(rng);
+	free(items);
+	free(buf);
+	free(shards);
+}
+
+struct Worker
+{
+	pthread_t thread;
+	int numOps;
+	uint32_t rng;
+
+	struct multiqueue* mq;
+	struct sbinheap* sheap;
+	pthread_mutex_t* lock;
+};
+
+/* Hold model: delete the (approximate) minimum and re-insert it later. */
+static void* hold_worker(void* arg)
+{
+	struct Worker* w = arg;
+	int op;
+
+	for(op = 0; op < w->numOps; ++op)
+	{
+		if(w->mq)
+		{
+			struct multiqueue_node* n = multiqueue_delete_min(w->mq, &w->rng);
+			multiqueue_add(n, w->mq, n->key + next_rand(&w->rng) % KEYS, &w->rng);
+		}
+		else
+		{
+			struct MData* d;
+
+			pthread_mutex_lock(w->lock);
+			d = sbinheap_top_entry(w->sheap, struct MData, sheap_node);
+			(void)sbinheap_delete_root(w->sheap, struct MData, sheap_node);
+			pthread_mutex_unlock(w->lock);
+
+			d->mq_node.key += next_rand(&w->rng) % KEYS;
+
+			pthread_mutex_lock(w->lock);
+			sbinheap_add(&d->sheap_node, w->sheap, struct MData, sheap_node);
+			pthread_mutex_unlock(w->lock);
+		}
+	}
+	return 0;
+}
+
+/* Returns average wall time per trial in microseconds. */
+static float scale_test(int useMultiqueue, int numTrials, int numOps, int size,
+                        int numThreads, unsigned int seed)
+{
+	int nr_shards = MQ_FACTOR*numThreads;
+	struct multiqueue_shard* shards = alloc_shards(nr_shards);
+	struct sbinheap_node* mbuf = calloc((size_t)nr_shards*size, sizeof(*mbuf));
+	struct sbinheap_node* sbuf = calloc(size, sizeof(*sbuf));
+	struct MData* items = calloc(size, sizeof(*items));
+	struct Worker* workers = calloc(numThreads, sizeof(*workers));
+	struct sbinheap sheap = {sless, 0, size, sbuf};
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	struct multiqueue mq;
+	uint64_t total = 0;
+	int i, t;
+
+	for(t = 0; t < numTrials; ++t)
+	{
+		uint32_t rng = seed + 1;
+		uint64_t start;
+
+		multiqueue_init(&mq, shards, nr_shards, mbuf, size);
+		INIT_SBINHEAP(&sheap);
+
+		for(i = 0; i < size / 2; ++i)
+		{
+			uint64_t key = next_rand(&rng) % KEYS;
+			if(useMultiqueue)
+			{
+				multiqueue_add(&items[i].mq_node, &mq, key, &rng);
+			}
+			else
+			{
+				items[i].mq_node.key = key;
+				sbinheap_add(&items[i].sheap_node, &sheap, struct MData, sheap_node);
+			}
+		}
+
+		start = wall_usec();
+		for(i = 0; i < numThreads; ++i)
+		{
+			workers[i].numOps = numOps / numThreads;
+			workers[i].rng = seed + i + 1;
+			workers[i].mq = useMultiqueue ? &mq : 0;
+			workers[i].sheap = &sheap;
+			workers[i].lock = &lock;
+			pthread_create(&workers[i].thread, 0, hold_worker, &workers[i]);
+		}
+		for(i = 0; i < numThreads; ++i)
+		{
+			pthread_join(workers[i].thread, 0);
+		}
+		total += wall_usec() - start;
+	}
+
+	free(workers);
+	free(items);
+	free(sbuf);
+	free(mbuf);
+	free(shards);
+
+	return (float)total / numTrials;
+}
+
+/*
+ * The largest key is a valid key, not an empty marker: fill every shard
+ * with it and with small keys, and every item must come back out.
+ */
+static int max_key_test(int size, int numThreads, unsigned int seed)
+{
+	int nr_shards = MQ_FACTOR * numThreads;
+	struct multiqueue_shard* shards = alloc_shards(nr_shards);
+	struct sbinheap_node* buf = calloc((size_t)nr_shards * size, sizeof(*buf));
+	struct MData* items = calloc(size, sizeof(*items));
+	struct multiqueue mq;
+	uint32_t rng = seed + 1;
+	int i, ok, added = 0, deleted = 0;
+
+	multiqueue_init(&mq, shards, nr_shards, buf, size);
+	for(i = 0; i < size; ++i)
+	{
+		uint64_t key = (i % 4) ? UINT64_MAX : next_rand(&rng) % KEYS;
+
+		added += (multiqueue_add(&items[i].mq_node, &mq, key, &rng) == 0);
+	}
+	while(multiqueue_delete_min(&mq, &rng))
+		++deleted;
+	ok = (deleted == added) && multiqueue_empty(&mq);
+
+	free(items);
+	free(buf);
+	free(shards);
+
+	return ok;
+}
+
+int bench_multiqueue(int numTrials, int numOps, int size, int numThreads,
+                     unsigned int seed)
+{
+	int p;
+
+	if(size < 2*numThreads)
+	{
+		fprintf(stderr, "heap_size must be at least twice the thread count\n");
+		return -1;
+	}
+
+	if(!max_key_test(size, numThreads, seed))
+	{
+		printf("multiqueue lost items queued with key UINT64_MAX!\n");
+		return 1;
+	}
+
+	printf("multiqueue rank error (exact, round-robin interleaving of threads)\n");
+	printf("threads, shards, mean rank error, max rank error\n");
+	for(p = 1; p <= numThreads; p *= 2)
+	{
+		quality_test(numOps, size, p, seed);
+
+		if(p < numThreads && 2*p > numThreads)
+			p = numThreads / 2;
+	}
+	printf("\n");
+
+	printf("threads, multiqueue time (microseconds), locked sbinheap time (microseconds)\n");
+	for(p = 1; p <= numThreads; p *= 2)
+	{
+		float m = scale_test(1, numTrials, numOps, size, p, seed);
+		float s = scale_test(0, numTrials, numOps, size, p, seed);
+		printf("%d, %f, %f\n", p, m, s); fflush(0);
+
+		if(p < numThreads && 2*p > numThreads)
+			p = numThreads / 2;
+	}
+	printf("\n");
+
+	return 0;
+}
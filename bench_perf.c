@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+
+#include "bench.h"
+
+/*
+ * Hardware counters for benchmark phases, through perf_event_open(2).
+ *
+ * Events are opened in two groups, so that each group fits the PMU's
+ * general-purpose counters and is scheduled as a unit: the pipeline group
+ * (cycles, instructions, branch misses) and the memory group (L1D, LLC and
+ * dTLB read misses). If the kernel still has to multiplex, counts are
+ * scaled by the time each group actually ran. An event the CPU or kernel
+ * does not support is left out, and without perf_event_open (no kernel
+ * support, perf_event_paranoid, seccomp, non-Linux) every event reads as
+ * unavailable and the benchmarks run as before.
+ */
+
+const char* const perfEventNames[PERF_NUM_EVENTS] =
+{
+	"cycles", "instructions", "branch_misses",
+	"l1d_misses", "llc_misses", "dtlb_misses",
+};
+
+#ifdef __linux__
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define CACHE_READ_MISS(cache) \
+	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+	 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static void event_attr(int ev, struct perf_event_attr* attr)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+	attr->type = PERF_TYPE_HARDWARE;
+
+	switch(ev)
+	{
+		case PERF_CYCLES:
+			attr->config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case PERF_INSTRUCTIONS:
+			attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case PERF_BRANCH_MISSES:
+			attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		case PERF_L1D_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D);
+			break;
+		case PERF_LLC_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL);
+			break;
+		case PERF_DTLB_MISSES:
+			attr->type = PERF_TYPE_HW_CACHE;
+			attr->config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB);
+			break;
+	}
+
+	/* this thread, user space only (allowed at perf_event_paranoid 2) */
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+	attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+static int open_event(struct perf_event_attr* attr, int groupFd)
+{
+	return (int)syscall(__NR_perf_event_open, attr, 0, -1, groupFd, 0);
+}
+
+int perf_open(struct Perf* p)
+{
+	static const int groups[PERF_NUM_GROUPS][PERF_NUM_EVENTS / PERF_NUM_GROUPS] =
+	{
+		{PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES},
+		{PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_DTLB_MISSES},
+	};
+	int g, i, err = 0;
+
+	memset(p, 0, sizeof(*p));
+
+	for(g = 0; g < PERF_NUM_GROUPS; ++g)
+	{
+		p->leader[g] = -1;
+
+		for(i = 0; i < PERF_NUM_EVENTS / PERF_NUM_GROUPS; ++i)
+		{
+			struct perf_event_attr attr;
+			int ev = groups[g][i];
+			int fd;
+
+			event_attr(ev, &attr);
+			/* members follow the leader, which starts disabled */
+			attr.disabled = (p->leader[g] < 0);
+
+			fd = open_event(&attr, p->leader[g]);
+			if(fd < 0)
+			{
+				if(!err)
+					err = errno;
+				continue;
+			}
+
+			if(p->leader[g] < 0)
+				p->leader[g] = fd;
+			p->fd[p->numOpen] = fd;
+			p->members[g][p->numMembers[g]++] = ev;
+			++p->numOpen;
+		}
+	}
+
+	if(!p->numOpen)
+		fprintf(stderr, "hardware counters unavailable (%s); continuing without\n",
+			strerror(err));
+
+	return p->numOpen;
+}
+
+void perf_start(struct Perf* p)
+{
+	int g;
+
+	for(g = 0; g < PERF_NUM_GROUPS; ++g)
+	{
+		if(p->leader[g] < 0)
+			continue;
+		ioctl(p->leader[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(p->leader[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+void perf_stop(struct Perf* p, double values[PERF_NUM_EVENTS])
+{
+	int g, i;
+
+	for(g = 0; g < PERF_NUM_GROUPS; ++g)
+	{
+		if(p->leader[g] >= 0)
+			ioctl(p->leader[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	for(i = 0; i < PERF_NUM_EVENTS; ++i)
+		values[i] = -1.0;
+
+	for(g = 0; g < PERF_NUM_GROUPS; ++g)
+	{
+		/* nr, time_enabled, time_running, then one value per member */
+		uint64_t buf[3 + PERF_NUM_EVENTS];
+		ssize_t want = (ssize_t)sizeof(uint64_t) * (3 + p->numMembers[g]);
+
+		if(p->leader[g] < 0 || read(p->leader[g], buf, sizeof(buf)) < want)
+			continue;
+		if(!buf[2])
+			continue;	/* never scheduled */
+
+		for(i = 0; i < p->numMembers[g]; ++i)
+			values[p->members[g][i]] = (double)buf[3 + i] * buf[1] / buf[2];
+	}
+}
+
+void perf_close(struct Perf* p)
+{
+	int i;
+
+	for(i = 0; i < p->numOpen; ++i)
+		close(p->fd[i]);
+	memset(p, 0, sizeof(*p));
+	p->leader[0] = p->leader[1] = -1;
+}
+
+#else
+
+int perf_open(struct Perf* p)
+{
+	memset(p, 0, sizeof(*p));
+	p->leader[0] = p->leader[1] = -1;
+	fprintf(stderr, "hardware counters unavailable on this platform\n");
+	return 0;
+}
+
+void perf_start(struct Perf* p)
+{
+}
+
+void perf_stop(struct Perf* p, double values[PERF_NUM_EVENTS])
+{
+	int i;
+
+	for(i = 0; i < PERF_NUM_EVENTS; ++i)
+		values[i] = -1.0;
+}
+
+void perf_close(struct Perf* p)
+{
+}
+
+#endif
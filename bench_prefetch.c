@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+static const int RANGE = 1000000;
+
+/* Small heap size, to check that prefetching does not hurt cached heaps. */
+static const int SMALL = 1024;
+
+struct PfData
+{
+	uint64_t val;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+	/* pad to a cache line, as typical user structs are at least that big */
+	char pad[64 - sizeof(uint64_t) - sizeof(sbinheap_node_t)];
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct PfData* a = binheap_entry(A, struct PfData, heap_node);
+	struct PfData* b = binheap_entry(B, struct PfData, heap_node);
+
+	return(a->val < b->val);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct PfData* a = sbinheap_entry(A, struct PfData, sheap_node);
+	struct PfData* b = sbinheap_entry(B, struct PfData, sheap_node);
+
+	return(a->val < b->val);
+}
+
+/*
+ * Hold model: pop the minimum and re-insert it with a larger key, so every
+ * operation sifts the last element down from the root. Elements are
+ * inserted in random memory order. Returns the time per operation in
+ * nanoseconds and the sum of popped keys in 'check'.
+ */
+static double hold(int useSbinheap, int distance, struct PfData* items,
+                   struct PfData** order, int size, int numOps,
+                   unsigned int seed, uint64_t* check)
+{
+	struct binheap heap;
+	struct sbinheap sheap;
+	uint64_t start, sum = 0;
+	int i;
+
+	INIT_BINHEAP(&heap, less);
+	binheap_set_prefetch(&heap, distance);
+	sheap.compare = sless;
+	sheap.max_size = size;
+	sheap.buf = malloc(sizeof(*sheap.buf) * size);
+	INIT_SBINHEAP(&sheap);
+	sbinheap_set_prefetch(&sheap, distance);
+
+	for(i = 0; i < size; ++i)
+	{
+		struct PfData* d = order[i];
+
+		d->val = rand_r(&seed) % RANGE;
+		INIT_BINHEAP_NODE(&d->heap_node);
+		if(useSbinheap)
+			sbinheap_add(&d->sheap_node, &sheap, struct PfData, sheap_node);
+		else
+			binheap_add(&d->heap_node, &heap, struct PfData, heap_node);
+	}
+
+	start = cpu_nsec();
+	for(i = 0; i < numOps; ++i)
+	{
+		struct PfData* d;
+
+		if(useSbinheap)
+		{
+			d = sbinheap_top_entry(&sheap, struct PfData, sheap_node);
+			(void)sbinheap_delete_root(&sheap, struct PfData, sheap_node);
+		}
+		else
+		{
+			d = binheap_top_entry(&heap, struct PfData, heap_node);
+			(void)binheap_delete_root(&heap, struct PfData, heap_node);
+		}
+		sum += d->val;
+		d->val += rand_r(&seed) % RANGE;
+		if(useSbinheap)
+			sbinheap_add(&d->sheap_node, &sheap, struct PfData, sheap_node);
+		else
+			binheap_add(&d->heap_node, &heap, struct PfData, heap_node);
+	}
+	start = cpu_nsec() - start;
+
+	free(sheap.buf);
+	(void)items;
+
+	*check = sum;
+	return (double)start / numOps;
+}
+
+int bench_prefetch(int numTrials, int numOps, int size, unsigned int seed)
+{
+	const int sizes[2] = {SMALL, size};
+	struct PfData* items;
+	struct PfData** order;
+	int s, h, d, t, i, failed = 0;
+
+	if(size <= 0 || numOps <= 0)
+		return 0;
+
+	items = malloc(sizeof(*items) * (size > SMALL ? size : SMALL));
+	order = malloc(sizeof(*order) * (size > SMALL ? size : SMALL));
+
+	printf("heap, size, prefetch distance, time per pop+add (nanoseconds)\n");
+	for(s = 0; s < 2 && !failed; ++s)
+	{
+		int n = sizes[s];
+		unsigned int shuffleSeed = seed;
+
+		/* random memory order */
+		for(i = 0; i < n; ++i)
+			order[i] = &items[i];
+		for(i = n - 1; i > 0; --i)
+		{
+			int j = rand_r(&shuffleSeed) % (i + 1);
+			struct PfData* tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		for(h = 0; h < 2 && !failed; ++h)
+		{
+			uint64_t ref = 0;
+
+			for(d = 0; d <= 3 && !failed; ++d)
+			{
+				double total = 0;
+
+				for(t = 0; t < numTrials; ++t)
+				{
+					uint64_t check;
+
+					total += hold(h, d, items, order, n, numOps, seed + t, &check);
+					if(d == 0 && t == 0)
+						ref = check;
+					else if(d > 0 && t == 0 && check != ref)
+						failed = 1;
+				}
+				printf("%s, %d, %d, %f\n", h ? "sbinheap" : "binheap", n, d,
+					total / numTrials);
+			}
+		}
+	}
+	printf("\n");
+
+	if(failed)
+		printf("prefetching changed the results!\n");
+
+	free(order);
+	free(items);
+
+	return failed;
+}
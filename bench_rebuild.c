@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+static const int RANGE = 10000;
+
+/* Heaps up to this size are checked after every step. */
+static const int CHECK_SIZE = 2000;
+
+struct RData
+{
+	uint64_t key;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	struct RData* a = binheap_entry(A, struct RData, heap_node);
+	struct RData* b = binheap_entry(B, struct RData, heap_node);
+
+	return(a->key < b->key);
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	struct RData* a = sbinheap_entry(A, struct RData, sheap_node);
+	struct RData* b = sbinheap_entry(B, struct RData, sheap_node);
+
+	return(a->key < b->key);
+}
+
+/* A priority remap that does not preserve order. */
+static void remap(void* data, void* args)
+{
+	struct RData* d = data;
+	uint64_t salt = *(uint64_t*)args;
+
+	d->key = (d->key * 2654435761u + salt) % RANGE;
+}
+
+static uint64_t min_key(struct RData* items, int size)
+{
+	uint64_t m = UINT64_MAX;
+	int i;
+
+	for(i = 0; i < size; ++i)
+		if(items[i].key < m)
+			m = items[i].key;
+	return m;
+}
+
+struct Result
+{
+	uint64_t fullNsec;
+	uint64_t maxStepNsec;
+	long steps;
+	int ok;
+};
+
+/*
+ * Remap every key with one unbounded step, then again in steps of 'budget'
+ * units. When 'check' is set, top is compared against a scan of all keys
+ * after every step.
+ */
+static void run(int useSbinheap, struct RData* items, int size, int budget,
+                unsigned int seed, int check, struct Result* res)
+{
+	struct binheap heap;
+	struct sbinheap sheap;
+	struct binheap_rebuild bc;
+	struct sbinheap_rebuild sc;
+	uint64_t salt, start;
+	size_t left;
+	int i;
+
+	INIT_BINHEAP(&heap, less);
+	sheap.compare = sless;
+	sheap.max_size = size;
+	sheap.buf = malloc(sizeof(*sheap.buf) * size);
+	INIT_SBINHEAP(&sheap);
+
+	for(i = 0; i < size; ++i)
+	{
+		items[i].key = rand_r(&seed) % RANGE;
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		INIT_SBINHEAP_NODE(&items[i].sheap_node);
+		if(useSbinheap)
+			sbinheap_add(&items[i].sheap_node, &sheap, struct RData, sheap_node);
+		else
+			binheap_add(&items[i].heap_node, &heap, struct RData, heap_node);
+	}
+
+	res->ok = 1;
+	res->maxStepNsec = 0;
+	res->steps = 0;
+
+	/* the whole rebuild at once: the latency spike we want to avoid */
+	salt = rand_r(&seed);
+	start = cpu_nsec();
+	if(useSbinheap)
+	{
+		sbinheap_rebuild_start(&sc, &sheap, remap, &salt);
+		(void)sbinheap_rebuild_step(&sc, (size_t)-1);
+	}
+	else
+	{
+		binheap_rebuild_start(&bc, &heap, remap, &salt);
+		(void)binheap_rebuild_step(&bc, (size_t)-1);
+	}
+	res->fullNsec = cpu_nsec() - start;
+
+	/* and spread out */
+	salt = rand_r(&seed);
+	if(useSbinheap)
+		sbinheap_rebuild_start(&sc, &sheap, remap, &salt);
+	else
+		binheap_rebuild_start(&bc, &heap, remap, &salt);
+
+	do
+	{
+		uint64_t elapsed;
+
+		start = cpu_nsec();
+		left = useSbinheap ? sbinheap_rebuild_step(&sc, budget)
+		                   : binheap_rebuild_step(&bc, budget);
+		elapsed = cpu_nsec() - start;
+
+		if(elapsed > res->maxStepNsec)
+			res->maxStepNsec = elapsed;
+		++res->steps;
+
+		if(check)
+		{
+			struct RData* top = useSbinheap
+				? sbinheap_rebuild_top_entry(&sc, struct RData, sheap_node)
+				: binheap_rebuild_top_entry(&bc, struct RData, heap_node);
+
+			if(top->key != min_key(items, size))
+				res->ok = 0;
+		}
+	} while(left);
+
+	if(useSbinheap)
+	{
+		res->ok &= (sbinheap_verify(&sheap) == SBINHEAP_VERIFY_OK);
+		res->ok &= (sbinheap_top_entry(&sheap, struct RData, sheap_node)->key ==
+		            min_key(items, size));
+	}
+	else
+	{
+		res->ok &= (binheap_verify(&heap) == BINHEAP_VERIFY_OK);
+		res->ok &= (binheap_top_entry(&heap, struct RData, heap_node)->key ==
+		            min_key(items, size));
+	}
+
+	free(sheap.buf);
+}
+
+int bench_rebuild(int numTrials, int budget, int size, unsigned int seed)
+{
+	struct RData* items;
+	struct Result res;
+	int t, h, failed = 0;
+
+	if(size <= 0 || budget <= 0)
+		return 0;
+
+	items = malloc(sizeof(*items) * size);
+
+	/* correctness of top at every step, on a small heap */
+	for(h = 0; h < 2 && !failed; ++h)
+	{
+		run(h, items, size < CHECK_SIZE ? size : CHECK_SIZE,
+			budget < 7 ? budget : 7, seed, 1, &res);
+		if(!res.ok)
+		{
+			printf("%s rebuild produced a wrong top or an invalid heap!\n",
+				h ? "sbinheap" : "binheap");
+			failed = 1;
+		}
+	}
+
+	if(!failed)
+	{
+		printf("heap, full rebuild (nanoseconds), steps, max step (nanoseconds)\n");
+		for(t = 0; t < numTrials; ++t)
+		{
+			for(h = 0; h < 2; ++h)
+			{
+				run(h, items, size, budget, seed + t, 0, &res);
+				printf("%s, %llu, %ld, %llu\n", h ? "sbinheap" : "binheap",
+					(unsigned long long)res.fullNsec, res.steps,
+					(unsigned long long)res.maxStepNsec);
+				failed |= !res.ok;
+			}
+		}
+		printf("\n");
+	}
+
+	free(items);
+
+	return failed;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "shbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Crash recovery of the process-shared heap. In each round a child process
+ * takes the heap lock and runs random add, delete_root, delete and
+ * decrease operations on it, holding the lock across batches of numOps, and
+ * is killed with SIGKILL part way through:
+ *
+ *  - in odd rounds, by itself from inside its comparator, i.e. in the
+ *    middle of a sift with the lock held;
+ *  - in even rounds, by the parent after a random delay, so the kill may
+ *    also land inside a journal commit or between batches.
+ *
+ * The parent then takes the lock, which must either succeed or report
+ * EOWNERDEAD after replaying or discarding the journal. Either way the heap
+ * must pass shbinheap_verify(), and exactly the elements whose handles are
+ * bound must be in it. At the end the parent drains the heap in order.
+ */
+
+struct ShItem
+{
+	uint64_t key;
+	shbinheap_node_t handle;
+};
+
+/* comparisons left before the child kills itself; < 0 disables */
+static long killAfter = -1;
+
+static int less(const void* a, const void* b)
+{
+	if(killAfter >= 0 && killAfter-- == 0)
+		kill(getpid(), SIGKILL);
+
+	return ((const struct ShItem*)a)->key < ((const struct ShItem*)b)->key;
+}
+
+/* Child: run operations until killed. */
+static void churn(struct shbinheap* heap, struct ShItem* items, int numItems,
+                  int batch, unsigned int seed)
+{
+	for(;;)
+	{
+		int i;
+
+		shbinheap_lock(heap);
+		for(i = 0; i < batch; ++i)
+		{
+			struct ShItem* it = &items[rand_r(&seed) % numItems];
+			int op = rand_r(&seed) % 3;
+
+			if(!shbinheap_is_in_heap(it->handle))
+			{
+				it->key = rand_r(&seed) % 100000;
+				shbinheap_add(&it->handle, heap, struct ShItem, handle);
+			}
+			else if(op == 0)
+			{
+				shbinheap_delete_root(heap, struct ShItem, handle);
+			}
+			else if(op == 1)
+			{
+				shbinheap_delete(&it->handle, heap);
+			}
+			else
+			{
+				it->key -= it->key ? rand_r(&seed) % it->key : 0;
+				shbinheap_decrease(&it->handle, heap);
+			}
+		}
+		shbinheap_unlock(heap);
+	}
+}
+
+/* With the lock held: heap invariants, and bound handles match the size. */
+static int check(struct shbinheap* heap, struct ShItem* items, int numItems)
+{
+	long bound = 0;
+	int i;
+
+	if(shbinheap_verify(heap) != SHBINHEAP_VERIFY_OK)
+		return 0;
+
+	for(i = 0; i < numItems; ++i)
+	{
+		if(shbinheap_is_in_heap(items[i].handle))
+		{
+			shbinheap_idx_t idx = items[i].handle;
+
+			if(idx >= heap->sh->size ||
+			   shbinheap_ptr(heap, heap->sh->buf[idx].data) != &items[i])
+				return 0;
+			++bound;
+		}
+	}
+
+	return bound == heap->sh->size;
+}
+
+int bench_shared(int numTrials, int numOps, int size, unsigned int seed)
+{
+	const int numItems = size + size / 2;
+	size_t itemBytes = sizeof(struct ShItem) * numItems;
+	size_t bytes = itemBytes + shbinheap_shared_size(size);
+	char* base;
+	struct ShItem* items;
+	struct shbinheap heap;
+	int round, i, ret, ok = 1, dead = 0;
+
+	if(size <= 0 || numTrials <= 0 || numOps <= 0)
+		return 0;
+
+	base = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+	            -1, 0);
+	if(base == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+	items = (struct ShItem*)base;
+	for(i = 0; i < numItems; ++i)
+		INIT_SHBINHEAP_NODE(&items[i].handle);
+
+	ret = shbinheap_create(&heap, base, base + itemBytes, size, less);
+	if(ret)
+	{
+		errno = ret;
+		perror("shbinheap_create");
+		munmap(base, bytes);
+		return 1;
+	}
+
+	srand(seed);
+	for(round = 0; round < 2 * numTrials && ok; ++round)
+	{
+		pid_t pid;
+		int status;
+
+		pid = fork();
+		if(pid < 0)
+		{
+			perror("fork");
+			ok = 0;
+			break;
+		}
+		if(pid == 0)
+		{
+			if(round % 2)
+				killAfter = 1000 + rand() % 100000;
+			churn(&heap, items, numItems, numOps, seed + round);
+		}
+
+		/* odd rounds: the child kills itself */
+		if(round % 2 == 0)
+		{
+			usleep(1000 + rand() % 20000);
+			kill(pid, SIGKILL);
+		}
+		waitpid(pid, &status, 0);
+
+		ret = shbinheap_lock(&heap);
+		if(ret == EOWNERDEAD)
+			++dead;
+		else if(ret != 0)
+		{
+			errno = ret;
+			perror("shbinheap_lock");
+			ok = 0;
+			break;
+		}
+		ok = check(&heap, items, numItems);
+		shbinheap_unlock(&heap);
+	}
+
+	/* what is left must come out in order */
+	if(ok)
+	{
+		uint64_t prev = 0;
+
+		shbinheap_lock(&heap);
+		while(!shbinheap_empty(&heap))
+		{
+			struct ShItem* it = shbinheap_delete_root(&heap, struct ShItem, handle);
+
+			ok &= (it->key >= prev) && !shbinheap_is_in_heap(it->handle);
+			prev = it->key;
+		}
+		shbinheap_unlock(&heap);
+	}
+
+	shbinheap_destroy(&heap);
+	munmap(base, bytes);
+
+	printf("%d children killed, %d while holding the lock\n", round, dead);
+	if(!ok || !dead)
+	{
+		printf("shbinheap did not recover from a dead lock owner!\n");
+		return 1;
+	}
+	printf("\n");
+
+	return 0;
+}
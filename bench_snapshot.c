@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+
+#include "sbinheap.h"
+#include "sbinheap_io.h"
+#include "heaptop.h"
+
+#include "bench.h"
+
+/*
+ * Snapshot save and load of an sbinheap of 'size' entries:
+ *
+ *  roundtrip  save, load into a fresh heap that publishes its top, and
+ *             compare the restored heap and the published top with the
+ *             saved ones; the load is also timed against re-adding
+ *  corrupt    flip a byte in a record; the load must fail with EBADMSG
+ *             and leave the heap and every handle unbound
+ *  small      load into a heap with room for one element less; the load
+ *             must fail with ENOSPC
+ */
+
+struct SnapItem
+{
+	uint32_t id;
+	uint64_t key;
+	sbinheap_node_t hnode;
+};
+
+struct SnapRec
+{
+	uint32_t id;
+	uint32_t pad;
+	uint64_t key;
+};
+
+static int less(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return ((struct SnapItem*)A->data)->key < ((struct SnapItem*)B->data)->key;
+}
+
+static int save_rec(const struct sbinheap_node* node, void* rec, void* args)
+{
+	const struct SnapItem* it = node->data;
+	struct SnapRec* r = rec;
+
+	(void)args;
+	r->id = it->id;
+	r->key = it->key;
+	return 0;
+}
+
+static uint64_t item_key(const void* data)
+{
+	return ((const struct SnapItem*)data)->key;
+}
+
+/* Resolve by id into the item array passed in 'args'. */
+static int load_rec(const void* rec, void** data, sbinheap_node_t** ref,
+                    void* args)
+{
+	const struct SnapRec* r = rec;
+	struct SnapItem* it = (struct SnapItem*)args + r->id;
+
+	it->key = r->key;
+	*data = it;
+	*ref = &it->hnode;
+	return 0;
+}
+
+static void init_heap(struct sbinheap* heap, int max)
+{
+	heap->compare = less;
+	heap->size = 0;
+	heap->max_size = max;
+	heap->buf = malloc(sizeof(*heap->buf) * (max ? max : 1));
+	INIT_SBINHEAP(heap);
+}
+
+static void init_items(struct SnapItem* items, int size)
+{
+	int i;
+
+	for(i = 0; i < size; ++i)
+	{
+		items[i].id = i;
+		items[i].key = 0;
+		INIT_SBINHEAP_NODE(&items[i].hnode);
+	}
+}
+
+/* Flip one byte of the record area of the file at 'path'. */
+static int corrupt_file(const char* path, long offset)
+{
+	FILE* f = fopen(path, "r+b");
+	int c;
+
+	if(!f)
+		return -1;
+	fseek(f, offset, SEEK_SET);
+	c = fgetc(f);
+	fseek(f, offset, SEEK_SET);
+	fputc(c ^ 0x40, f);
+	return fclose(f);
+}
+
+int bench_snapshot(int numTrials, int size, unsigned int seed)
+{
+	char path[] = "/tmp/heaptest-snapshot-XXXXXX";
+	struct SnapItem* orig = malloc(sizeof(*orig) * size);
+	struct SnapItem* copy = malloc(sizeof(*copy) * size);
+	struct sbinheap src, dst, small;
+	struct heaptop top;
+	uint64_t saveNsec = 0, loadNsec = 0, addNsec = 0, start;
+	int fd, t, i, ret, ok = 1;
+
+	if(size <= 0)
+	{
+		free(copy);
+		free(orig);
+		return 0;
+	}
+
+	fd = mkstemp(path);
+	if(fd < 0)
+	{
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+
+	for(t = 0; t < numTrials && ok; ++t)
+	{
+		unsigned int s = seed + t;
+
+		init_items(orig, size);
+		init_heap(&src, size);
+		for(i = 0; i < size; ++i)
+		{
+			orig[i].key = rand_r(&s);
+			sbinheap_add(&orig[i].hnode, &src, struct SnapItem, hnode);
+		}
+
+		/* roundtrip */
+		start = cpu_nsec();
+		ret = sbinheap_save(&src, path, sizeof(struct SnapRec), save_rec, 0);
+		saveNsec += cpu_nsec() - start;
+		if(ret)
+		{
+			perror("sbinheap_save");
+			ok = 0;
+			break;
+		}
+
+		init_items(copy, size);
+		init_heap(&dst, size);
+		INIT_HEAPTOP(&top, item_key);
+		sbinheap_publish_top(&dst, &top);
+		start = cpu_nsec();
+		ret = sbinheap_load(&dst, path, load_rec, copy);
+		loadNsec += cpu_nsec() - start;
+		ok &= (ret == 0) && (dst.size == src.size) &&
+		      (sbinheap_verify(&dst) == SBINHEAP_VERIFY_OK);
+		/* a load publishes the new root */
+		ok &= (heaptop_read_key(&top) ==
+		       ((struct SnapItem*)src.buf->data)->key);
+
+		/* same array, slot by slot */
+		for(i = 0; ok && i < size; ++i)
+		{
+			const struct SnapItem* a = src.buf[i].data;
+			const struct SnapItem* b = dst.buf[i].data;
+
+			ok &= (a->id == b->id) && (a->key == b->key) &&
+			      (copy[b->id].hnode == &dst.buf[i]);
+		}
+		if(!ok)
+			printf("snapshot: restored heap differs from the saved one!\n");
+		free(dst.buf);
+
+		/* the reference: rebuild by re-adding every element */
+		{
+			struct sbinheap re;
+
+			init_heap(&re, size);
+			start = cpu_nsec();
+			for(i = 0; i < size; ++i)
+				sbinheap_add(&copy[i].hnode, &re, struct SnapItem, hnode);
+			addNsec += cpu_nsec() - start;
+			free(re.buf);
+		}
+
+		/* corrupt: the checksum must reject a flipped byte */
+		if(ok)
+		{
+			long rec = rand_r(&s) % size;
+
+			init_items(copy, size);
+			init_heap(&dst, size);
+			corrupt_file(path, (long)sizeof(struct sbinheap_snapshot_hdr) +
+			             rec * (long)sizeof(struct SnapRec) + 8);
+			errno = 0;
+			ret = sbinheap_load(&dst, path, load_rec, copy);
+			ok &= (ret == -1) && (errno == EBADMSG) && sbinheap_empty(&dst);
+			for(i = 0; i < size; ++i)
+				ok &= !copy[i].hnode;
+			if(!ok)
+				printf("snapshot: corrupt file was not rejected!\n");
+			free(dst.buf);
+		}
+
+		/* small: restore the file, then load it into too small a heap */
+		if(ok)
+		{
+			sbinheap_save(&src, path, sizeof(struct SnapRec), save_rec, 0);
+			init_items(copy, size);
+			init_heap(&small, size - 1);
+			errno = 0;
+			ret = sbinheap_load(&small, path, load_rec, copy);
+			ok &= (ret == -1) && (errno == ENOSPC) && sbinheap_empty(&small);
+			if(!ok)
+				printf("snapshot: load into a small heap did not fail!\n");
+			free(small.buf);
+		}
+
+		free(src.buf);
+	}
+
+	unlink(path);
+	free(copy);
+	free(orig);
+
+	if(!ok)
+		return 1;
+
+	printf("heap of %d, %d trials; ns per element\n", size, numTrials);
+	printf("save %.2f, load %.2f, rebuild by add %.2f\n",
+		(double)saveNsec / numTrials / size,
+		(double)loadNsec / numTrials / size,
+		(double)addNsec / numTrials / size);
+	printf("checksum rejected a corrupt file; a small heap was refused\n\n");
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spillheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Spill heap check: random add, delete_root, delete and decrease on a
+ * spillheap whose array holds 'size' entries, with about twice that many
+ * live, so entries keep spilling into the binheap and migrating back.
+ * Every operation is mirrored on a large sbinheap used as the reference;
+ * the tops must agree after every operation, and the array must be full
+ * whenever anything is spilled. An array of 0 entries, where every add
+ * spills, is checked with the same number of items.
+ */
+
+/* low bits of each key hold the item's id, so keys are unique */
+#define ID_BITS 20
+
+struct SItem
+{
+	uint64_t key;
+	/* not the first member, so node_offset is exercised */
+	struct spillheap_node node;
+	sbinheap_node_t ref;
+};
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return ((struct SItem*)A->data)->key < ((struct SItem*)B->data)->key;
+}
+
+static int bless(const struct binheap_node* A, const struct binheap_node* B)
+{
+	return binheap_entry(A, struct SItem, node)->key <
+	       binheap_entry(B, struct SItem, node)->key;
+}
+
+static uint64_t new_key(uint64_t high, int id)
+{
+	return (high << ID_BITS) | id;
+}
+
+/* Returns 1 if the heap agrees with the reference after every operation. */
+static int run(int numOps, int size, int numItems, unsigned int seed,
+               long* spills)
+{
+	struct SItem* items = malloc(sizeof(*items) * numItems);
+	struct spillheap heap;
+	struct sbinheap ref;
+	int i, ok = 1;
+
+	heap.array.compare = sless;
+	heap.array.max_size = size;
+	heap.array.buf = malloc(sizeof(*heap.array.buf) * (size + 1));
+	INIT_SPILLHEAP(&heap, bless, offsetof(struct SItem, node));
+
+	ref.compare = sless;
+	ref.size = 0;
+	ref.max_size = numItems;
+	ref.buf = malloc(sizeof(*ref.buf) * numItems);
+	INIT_SBINHEAP(&ref);
+
+	for(i = 0; i < numItems; ++i)
+	{
+		INIT_SPILLHEAP_NODE(&items[i].node);
+		INIT_SBINHEAP_NODE(&items[i].ref);
+	}
+
+	for(i = 0; i < numOps && ok; ++i)
+	{
+		int id = rand_r(&seed) % numItems;
+		struct SItem* it = &items[id];
+		int op = rand_r(&seed) % 3;
+
+		if(!spillheap_is_in_heap(&it->node))
+		{
+			it->key = new_key(rand_r(&seed) % 100000, id);
+			spillheap_add(&it->node, &heap, struct SItem, node);
+			sbinheap_add(&it->ref, &ref, struct SItem, ref);
+			*spills += spillheap_is_spilled(&it->node);
+		}
+		else if(op == 0)
+		{
+			struct SItem* a = spillheap_delete_root(&heap, struct SItem, node);
+			struct SItem* b = sbinheap_delete_root(&ref, struct SItem, ref);
+
+			ok &= (a == b) && !spillheap_is_in_heap(&a->node);
+		}
+		else if(op == 1)
+		{
+			ok &= (spillheap_delete(&it->node, &heap) == it);
+			sbinheap_delete(&it->ref, &ref);
+		}
+		else
+		{
+			uint64_t high = it->key >> ID_BITS;
+
+			it->key = new_key(high - rand_r(&seed) % (high + 1), id);
+			spillheap_decrease(&it->node, &heap);
+			sbinheap_decrease(it->ref, &ref);
+		}
+
+		if(!binheap_empty(&heap.spill))
+			ok &= (heap.array.size == heap.array.max_size);
+		if(sbinheap_empty(&ref))
+			ok &= spillheap_empty(&heap);
+		else
+			ok &= (spillheap_top_entry(&heap, struct SItem, node) ==
+			       sbinheap_top_entry(&ref, struct SItem, ref));
+	}
+
+	/* drain: spilled entries must come back in order */
+	while(ok && !sbinheap_empty(&ref))
+	{
+		struct SItem* a = spillheap_delete_root(&heap, struct SItem, node);
+		struct SItem* b = sbinheap_delete_root(&ref, struct SItem, ref);
+
+		ok &= (a == b);
+	}
+	ok &= spillheap_empty(&heap);
+
+	free(ref.buf);
+	free(heap.array.buf);
+	free(items);
+
+	return ok;
+}
+
+int bench_spill(int numTrials, int numOps, int size, unsigned int seed)
+{
+	static const int sizes[2] = {0, -1};
+	int s, t;
+
+	if(numOps <= 0 || size <= 0)
+		return 0;
+	if(2 * size + 16 > (1 << ID_BITS))
+	{
+		printf("spill: heap_size must be below %d\n", (1 << (ID_BITS - 1)) - 8);
+		return 1;
+	}
+
+	printf("%d operations per trial, %d trials\n", numOps, numTrials);
+	for(s = 0; s < 2; ++s)
+	{
+		int arraySize = (sizes[s] < 0) ? size : sizes[s];
+		long spills = 0;
+
+		for(t = 0; t < numTrials; ++t)
+		{
+			if(!run(numOps, arraySize, 2 * size + 16, seed + t, &spills))
+			{
+				printf("spillheap with an array of %d disagreed with the "
+					"reference!\n", arraySize);
+				return 1;
+			}
+		}
+		printf("array of %d: ok, %ld adds spilled per trial\n", arraySize,
+			spills / numTrials);
+	}
+	printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,834 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+#include "pairheap.h"
+#include "seqheap.h"
+
+#include "bench.h"
+#include "bench_suite.h"
+
+/*
+ * Workload-driven benchmark suite. Every workload runs against every heap
+ * variant through the same small interface, so results are comparable
+ * across variants, sizes and seeds. Each run also yields a checksum of
+ * what the workload observed (popped keys, distances, ...); all variants
+ * must agree on it for a given workload, size and seed.
+ *
+ * Keys carry the element id in their low bits, so they are unique and
+ * every variant makes exactly the same decisions.
+ */
+
+#define ID_BITS 28
+#define MAX_SIZE (1 << (ID_BITS - 1))
+#define KEY(value, id) (((uint64_t)(value) << ID_BITS) | (uint64_t)(id))
+#define VALUE(key) ((key) >> ID_BITS)
+
+/* binheap */
+
+static int bless(const struct binheap_node* A, const struct binheap_node* B)
+{
+	return binheap_entry(A, struct Item, heap_node)->key <
+	       binheap_entry(B, struct Item, heap_node)->key;
+}
+
+static void* b_create(int maxSize)
+{
+	struct binheap* h = malloc(sizeof(*h));
+	INIT_BINHEAP(h, bless);
+	return h;
+}
+
+static void b_destroy(void* h)
+{
+	free(h);
+}
+
+static void b_add(void* h, struct Item* it)
+{
+	INIT_BINHEAP_NODE(&it->heap_node);
+	binheap_add(&it->heap_node, (struct binheap*)h, struct Item, heap_node);
+}
+
+static struct Item* b_top(void* h)
+{
+	struct binheap* heap = h;
+	return binheap_empty(heap) ? 0 : binheap_top_entry(heap, struct Item, heap_node);
+}
+
+static void b_pop(void* h)
+{
+	(void)binheap_delete_root((struct binheap*)h, struct Item, heap_node);
+}
+
+static void b_remove(void* h, struct Item* it)
+{
+	(void)binheap_delete(&it->heap_node, (struct binheap*)h);
+}
+
+static void b_decrease(void* h, struct Item* it)
+{
+	binheap_decrease(&it->heap_node, (struct binheap*)h);
+}
+
+static void b_stats(void* h, struct heap_stats* s)
+{
+	(void)binheap_stats((struct binheap*)h, s);
+}
+
+/* sbinheap */
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return sbinheap_entry(A, struct Item, sheap_node)->key <
+	       sbinheap_entry(B, struct Item, sheap_node)->key;
+}
+
+static void* s_create(int maxSize)
+{
+	struct sbinheap* h = malloc(sizeof(*h));
+	h->compare = sless;
+	h->max_size = maxSize;
+	h->buf = malloc(sizeof(*h->buf) * maxSize);
+	INIT_SBINHEAP(h);
+	return h;
+}
+
+static void s_destroy(void* h)
+{
+	free(((struct sbinheap*)h)->buf);
+	free(h);
+}
+
+static void s_add(void* h, struct Item* it)
+{
+	sbinheap_add(&it->sheap_node, (struct sbinheap*)h, struct Item, sheap_node);
+}
+
+static struct Item* s_top(void* h)
+{
+	struct sbinheap* heap = h;
+	return sbinheap_empty(heap) ? 0 : sbinheap_top_entry(heap, struct Item, sheap_node);
+}
+
+static void s_pop(void* h)
+{
+	(void)sbinheap_delete_root((struct sbinheap*)h, struct Item, sheap_node);
+}
+
+static void s_remove(void* h, struct Item* it)
+{
+	(void)sbinheap_delete(&it->sheap_node, (struct sbinheap*)h);
+}
+
+static void s_decrease(void* h, struct Item* it)
+{
+	sbinheap_decrease(it->sheap_node, (struct sbinheap*)h);
+}
+
+static void s_stats(void* h, struct heap_stats* s)
+{
+	(void)sbinheap_stats((struct sbinheap*)h, s);
+}
+
+/* pairheap */
+
+static int pless(const struct pairheap_node* A, const struct pairheap_node* B)
+{
+	return pairheap_entry(A, struct Item, pheap_node)->key <
+	       pairheap_entry(B, struct Item, pheap_node)->key;
+}
+
+static void* p_create(int maxSize)
+{
+	struct pairheap* h = malloc(sizeof(*h));
+	INIT_PAIRHEAP(h, pless);
+	return h;
+}
+
+static void p_destroy(void* h)
+{
+	free(h);
+}
+
+static void p_add(void* h, struct Item* it)
+{
+	pairheap_add(&it->pheap_node, (struct pairheap*)h, struct Item, pheap_node);
+}
+
+static struct Item* p_top(void* h)
+{
+	struct pairheap* heap = h;
+	return pairheap_empty(heap) ? 0 : pairheap_top_entry(heap, struct Item, pheap_node);
+}
+
+static void p_pop(void* h)
+{
+	(void)pairheap_delete_root((struct pairheap*)h, struct Item, pheap_node);
+}
+
+static void p_remove(void* h, struct Item* it)
+{
+	(void)pairheap_delete(&it->pheap_node, (struct pairheap*)h);
+}
+
+static void p_decrease(void* h, struct Item* it)
+{
+	pairheap_decrease(&it->pheap_node, (struct pairheap*)h);
+}
+
+/* pairheap and seqheap keep no operation counters */
+static void no_stats(void* h, struct heap_stats* s)
+{
+	static const struct heap_stats zero;
+	*s = zero;
+}
+
+/* seqheap: keys are stored in the heap, so there is no node */
+
+#define SEQHEAP_INS_SIZE 1024
+
+struct SeqHeap
+{
+	struct seqheap heap;
+	struct seqheap_entry ins[SEQHEAP_INS_SIZE];
+	struct seqheap_block* blocks;
+};
+
+static void* q_create(int maxSize)
+{
+	struct SeqHeap* h = malloc(sizeof(*h));
+	unsigned long nrBlocks = seqheap_nr_blocks(maxSize);
+
+	h->blocks = malloc(sizeof(*h->blocks) * nrBlocks);
+	(void)seqheap_init(&h->heap, h->ins, SEQHEAP_INS_SIZE, h->blocks, nrBlocks);
+	return h;
+}
+
+static void q_destroy(void* h)
+{
+	free(((struct SeqHeap*)h)->blocks);
+	free(h);
+}
+
+static void q_add(void* h, struct Item* it)
+{
+	(void)seqheap_add(&((struct SeqHeap*)h)->heap, it->key, it);
+}
+
+static struct Item* q_top(void* h)
+{
+	return seqheap_top_entry(&((struct SeqHeap*)h)->heap, struct Item);
+}
+
+static void q_pop(void* h)
+{
+	(void)seqheap_delete_root(&((struct SeqHeap*)h)->heap, struct Item);
+}
+
+static const struct HeapImpl binheapImpl =
+{
+	"binheap", b_create, b_destroy, b_add, b_top, b_pop, b_remove, b_decrease, b_stats
+};
+
+static const struct HeapImpl sbinheapImpl =
+{
+	"sbinheap", s_create, s_destroy, s_add, s_top, s_pop, s_remove, s_decrease, s_stats
+};
+
+static const struct HeapImpl pairheapImpl =
+{
+	"pairheap", p_create, p_destroy, p_add, p_top, p_pop, p_remove, p_decrease, no_stats
+};
+
+/* no remove or decrease: runs only workloads that need neither */
+static const struct HeapImpl seqheapImpl =
+{
+	"seqheap", q_create, q_destroy, q_add, q_top, q_pop, 0, 0, no_stats
+};
+
+/* The library's heaps, then the reference implementations. */
+static const struct HeapImpl* const heaps[] =
+{
+	&binheapImpl,
+	&sbinheapImpl,
+	&pairheapImpl,
+	&seqheapImpl,
+	&arrayHeapImpl,
+	&rbtreeImpl,
+	&binomialHeapImpl,
+};
+#define NUM_HEAPS ((int)(sizeof(heaps) / sizeof(heaps[0])))
+
+
+/* Workloads. Each times only its steady state. */
+
+struct Run
+{
+	const struct HeapImpl* impl;
+	int size;
+	int numOps;
+	unsigned int seed;
+
+	/* results */
+	long ops;
+	uint64_t nsec;
+	uint64_t check;
+	struct heap_stats stats;
+
+	/* hardware counters, if enabled; negative if unavailable */
+	struct Perf* perf;
+	double hw[PERF_NUM_EVENTS];
+};
+
+/* Bracket a workload's measured phase: CPU time and hardware counters. */
+static void phase_start(struct Run* r)
+{
+	if(r->perf)
+		perf_start(r->perf);
+	r->nsec = cpu_nsec();
+}
+
+static void phase_stop(struct Run* r)
+{
+	r->nsec = cpu_nsec() - r->nsec;
+	if(r->perf)
+		perf_stop(r->perf, r->hw);
+}
+
+/*
+ * Accumulate the operation counters of heap 'h' between stats_start() and
+ * stats_stop() into r->stats. All zero unless built with BINHEAP_STATS.
+ */
+static void stats_add(struct Run* r, void* h, int sign)
+{
+	struct heap_stats s;
+
+	r->impl->stats(h, &s);
+	r->stats.compares += sign * s.compares;
+	r->stats.swaps += sign * s.swaps;
+	r->stats.ref_updates += sign * s.ref_updates;
+	r->stats.levels += sign * s.levels;
+	r->stats.coalesces += sign * s.coalesces;
+	r->stats.path_steps += sign * s.path_steps;
+}
+
+static void stats_start(struct Run* r, void* h)
+{
+	stats_add(r, h, -1);
+}
+
+static void stats_stop(struct Run* r, void* h)
+{
+	stats_add(r, h, 1);
+}
+
+/* Classic hold model: pop the minimum, re-insert it later. */
+static void wl_hold(struct Run* r)
+{
+	const struct HeapImpl* impl = r->impl;
+	struct Item* items = calloc(r->size, sizeof(*items));
+	void* h = impl->create(r->size);
+	unsigned int seed = r->seed;
+	int i;
+
+	for(i = 0; i < r->size; ++i)
+	{
+		items[i].id = i;
+		items[i].key = KEY(rand_r(&seed) % 1000000, i);
+		impl->add(h, &items[i]);
+	}
+
+	stats_start(r, h);
+	phase_start(r);
+	for(i = 0; i < r->numOps; ++i)
+	{
+		struct Item* it = impl->top(h);
+
+		impl->pop(h);
+		r->check += VALUE(it->key);
+		it->key = KEY(VALUE(it->key) + rand_r(&seed) % 1000000, it->id);
+		impl->add(h, it);
+	}
+	phase_stop(r);
+	stats_stop(r, h);
+	r->ops = 2L * r->numOps;
+
+	impl->destroy(h);
+	free(items);
+}
+
+/*
+ * Uniprocessor EDF with 'size' sporadic tasks at about 90% utilization.
+ * A release heap orders tasks by next release and a ready heap orders jobs
+ * by deadline; the running job is the top of the ready heap. Each event
+ * (release or completion) counts as one operation. A job still pending at
+ * its task's next release is dropped as a deadline miss.
+ */
+static void wl_edf(struct Run* r)
+{
+	const struct HeapImpl* impl = r->impl;
+	const int n = r->size;
+	/* [0, n) are release entries, [n, 2n) the tasks' current jobs */
+	struct Item* items = calloc(2 * n, sizeof(*items));
+	uint64_t* period = malloc(sizeof(*period) * n);
+	uint64_t* wcet = malloc(sizeof(*wcet) * n);
+	void* release = impl->create(n);
+	void* ready = impl->create(n);
+	unsigned int seed = r->seed;
+	uint64_t now = 0;
+	long events = 0, misses = 0, done = 0;
+	int i;
+
+	for(i = 0; i < n; ++i)
+	{
+		/* periods scale with n so each task gets utilization 0.9/n */
+		period[i] = 100 * (uint64_t)n + rand_r(&seed) % (900 * (uint64_t)n);
+		wcet[i] = period[i] * 9 / (10 * n);
+
+		items[i].id = i;
+		items[i].key = KEY(rand_r(&seed) % period[i], i);
+		impl->add(release, &items[i]);
+
+		items[n + i].id = n + i;
+	}
+
+	stats_start(r, release);
+	stats_start(r, ready);
+	phase_start(r);
+	while(events < r->numOps)
+	{
+		struct Item* rel = impl->top(release);
+		struct Item* run = impl->top(ready);
+		uint64_t relTime = VALUE(rel->key);
+
+		if(!run || relTime < now + run->aux)
+		{
+			struct Item* job = &items[n + rel->id];
+
+			/* the running job progresses until the release */
+			if(run)
+				run->aux -= relTime - now;
+			now = relTime;
+
+			if(job->key)
+			{
+				impl->remove(ready, job);
+				++misses;
+			}
+			job->key = KEY(now + period[rel->id], job->id);
+			job->aux = wcet[rel->id];
+			impl->add(ready, job);
+
+			impl->pop(release);
+			rel->key = KEY(now + period[rel->id], rel->id);
+			impl->add(release, rel);
+		}
+		else
+		{
+			now += run->aux;
+			run->key = 0;
+			impl->pop(ready);
+			++done;
+		}
+		++events;
+	}
+	phase_stop(r);
+	stats_stop(r, ready);
+	stats_stop(r, release);
+	r->ops = events;
+	r->check = now + done + (misses << 32);
+
+	impl->destroy(ready);
+	impl->destroy(release);
+	free(wcet);
+	free(period);
+	free(items);
+}
+
+/* Timers, mostly cancelled and re-armed before they expire. */
+static void wl_timer(struct Run* r)
+{
+	const struct HeapImpl* impl = r->impl;
+	struct Item* items = calloc(r->size, sizeof(*items));
+	void* h = impl->create(r->size);
+	unsigned int seed = r->seed;
+	uint64_t now = 0;
+	int i;
+
+	for(i = 0; i < r->size; ++i)
+	{
+		items[i].id = i;
+		items[i].key = KEY(1 + rand_r(&seed) % 100000, i);
+		impl->add(h, &items[i]);
+	}
+
+	stats_start(r, h);
+	phase_start(r);
+	for(i = 0; i < r->numOps; ++i)
+	{
+		struct Item* it;
+
+		if(rand_r(&seed) % 10 < 7)
+		{
+			/* cancel and re-arm */
+			it = &items[rand_r(&seed) % r->size];
+			impl->remove(h, it);
+		}
+		else
+		{
+			/* expire */
+			it = impl->top(h);
+			impl->pop(h);
+			now = VALUE(it->key);
+			r->check += now;
+		}
+		it->key = KEY(now + 1 + rand_r(&seed) % 100000, it->id);
+		impl->add(h, it);
+	}
+	phase_stop(r);
+	stats_stop(r, h);
+	r->ops = 2L * r->numOps;
+
+	impl->destroy(h);
+	free(items);
+}
+
+/* Dijkstra with decrease-key over a random graph of out-degree 8. */
+static void wl_dijkstra(struct Run* r)
+{
+	enum { DEGREE = 8 };
+	const struct HeapImpl* impl = r->impl;
+	const int n = r->size;
+	struct Item* items = calloc(n, sizeof(*items));
+	int* to = malloc(sizeof(*to) * (size_t)n * DEGREE);
+	int* weight = malloc(sizeof(*weight) * (size_t)n * DEGREE);
+	void* h = impl->create(n);
+	unsigned int seed = r->seed;
+	const uint64_t inf = (UINT64_MAX >> ID_BITS) >> 1;
+	long ops = 0;
+	int i, e;
+
+	for(i = 0; i < n * DEGREE; ++i)
+	{
+		to[i] = rand_r(&seed) % n;
+		weight[i] = 1 + rand_r(&seed) % 100;
+	}
+	for(i = 0; i < n; ++i)
+	{
+		items[i].id = i;
+		items[i].key = KEY(i ? inf : 0, i);
+	}
+
+	stats_start(r, h);
+	phase_start(r);
+	for(i = 0; i < n; ++i)
+		impl->add(h, &items[i]);
+	ops += n;
+
+	for(;;)
+	{
+		struct Item* u = impl->top(h);
+		uint64_t d;
+
+		if(!u)
+			break;
+		impl->pop(h);
+		++ops;
+
+		d = VALUE(u->key);
+		if(d == inf)
+			continue;
+		r->check += d;
+
+		for(e = u->id * DEGREE; e < (u->id + 1) * DEGREE; ++e)
+		{
+			struct Item* v = &items[to[e]];
+
+			if(d + weight[e] < VALUE(v->key))
+			{
+				v->key = KEY(d + weight[e], v->id);
+				impl->decrease(h, v);
+				++ops;
+			}
+		}
+	}
+	phase_stop(r);
+	stats_stop(r, h);
+	r->ops = ops;
+
+	impl->destroy(h);
+	free(weight);
+	free(to);
+	free(items);
+}
+
+/* Keep the 'size' largest of a stream of numOps values in a min-heap. */
+static void wl_topk(struct Run* r)
+{
+	const struct HeapImpl* impl = r->impl;
+	struct Item* items = calloc(r->size, sizeof(*items));
+	void* h = impl->create(r->size);
+	unsigned int seed = r->seed;
+	long ops = 0;
+	int i;
+
+	stats_start(r, h);
+	phase_start(r);
+	for(i = 0; i < r->numOps; ++i)
+	{
+		uint64_t value = rand_r(&seed);
+
+		if(i < r->size)
+		{
+			items[i].id = i;
+			items[i].key = KEY(value, i);
+			impl->add(h, &items[i]);
+			++ops;
+		}
+		else
+		{
+			struct Item* it = impl->top(h);
+
+			++ops;
+			if(value > VALUE(it->key))
+			{
+				impl->pop(h);
+				it->key = KEY(value, it->id);
+				impl->add(h, it);
+				ops += 2;
+			}
+		}
+	}
+	phase_stop(r);
+	stats_stop(r, h);
+	r->ops = ops;
+
+	for(i = 0; i < r->size && i < r->numOps; ++i)
+		r->check += VALUE(items[i].key);
+
+	impl->destroy(h);
+	free(items);
+}
+
+struct Workload
+{
+	const char* name;
+	void (*run)(struct Run* r);
+
+	/* uses remove or decrease; heaps without them sit it out */
+	int updates;
+};
+
+static const struct Workload workloads[] =
+{
+	{"hold", wl_hold, 0},
+	{"edf", wl_edf, 1},
+	{"timer", wl_timer, 1},
+	{"dijkstra", wl_dijkstra, 1},
+	{"topk", wl_topk, 0},
+};
+#define NUM_WORKLOADS ((int)(sizeof(workloads) / sizeof(workloads[0])))
+
+
+/* Is 'name' in the comma-separated 'list'? A null list selects everything. */
+static int selected(const char* list, const char* name)
+{
+	size_t len = strlen(name);
+	const char* p = list;
+
+	if(!list)
+		return 1;
+
+	while((p = strstr(p, name)) != 0)
+	{
+		if((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+			return 1;
+		p += len;
+	}
+	return 0;
+}
+
+static int check_names(const char* list, const char* what, int count,
+                       const char* (*nameOf)(int))
+{
+	const char* p = list;
+
+	while(p && *p)
+	{
+		size_t len = strcspn(p, ",");
+		int i, found = 0;
+
+		for(i = 0; i < count && !found; ++i)
+			found = (strlen(nameOf(i)) == len && strncmp(nameOf(i), p, len) == 0);
+		if(!found)
+		{
+			fprintf(stderr, "unknown %s: %.*s\n", what, (int)len, p);
+			return 0;
+		}
+		p += len + (p[len] == ',');
+	}
+	return 1;
+}
+
+static const char* workload_name(int i)
+{
+	return workloads[i].name;
+}
+
+static const char* heap_name(int i)
+{
+	return heaps[i]->name;
+}
+
+/*
+ * One result. Heap counter columns (per op) appear in BINHEAP_STATS builds,
+ * hardware counter columns (per op; empty or null if unavailable) with -e.
+ */
+static void print_row(const struct Run* r, const char* workload, int json,
+                      int first)
+{
+	int i;
+
+	double ops = r->ops ? (double)r->ops : 1.0;
+
+	if(json)
+	{
+		printf("%s  {\"workload\": \"%s\", \"heap\": \"%s\", \"size\": %d, "
+			"\"seed\": %u, \"ops\": %ld, \"ns_per_op\": %.3f, \"check\": %llu",
+			first ? "" : ",\n", workload, r->impl->name, r->size, r->seed,
+			r->ops, r->nsec / ops, (unsigned long long)r->check);
+		if(HEAP_STATS_ENABLED)
+		{
+			printf(", \"compares\": %.3f, \"swaps\": %.3f, \"ref_updates\": %.3f, "
+				"\"levels\": %.3f, \"coalesces\": %.3f, \"path_steps\": %.3f",
+				r->stats.compares / ops, r->stats.swaps / ops,
+				r->stats.ref_updates / ops, r->stats.levels / ops,
+				r->stats.coalesces / ops, r->stats.path_steps / ops);
+		}
+		for(i = 0; r->perf && i < PERF_NUM_EVENTS; ++i)
+		{
+			if(r->hw[i] < 0)
+				printf(", \"%s\": null", perfEventNames[i]);
+			else
+				printf(", \"%s\": %.3f", perfEventNames[i], r->hw[i] / ops);
+		}
+		printf("}");
+	}
+	else
+	{
+		printf("%s,%s,%d,%u,%ld,%.3f,%llu", workload, r->impl->name, r->size,
+			r->seed, r->ops, r->nsec / ops, (unsigned long long)r->check);
+		if(HEAP_STATS_ENABLED)
+		{
+			printf(",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f",
+				r->stats.compares / ops, r->stats.swaps / ops,
+				r->stats.ref_updates / ops, r->stats.levels / ops,
+				r->stats.coalesces / ops, r->stats.path_steps / ops);
+		}
+		for(i = 0; r->perf && i < PERF_NUM_EVENTS; ++i)
+		{
+			if(r->hw[i] < 0)
+				printf(",");
+			else
+				printf(",%.3f", r->hw[i] / ops);
+		}
+		printf("\n");
+	}
+}
+
+int bench_suite(int numSeeds, int numOps, const struct SuiteOptions* opts,
+                unsigned int seed)
+{
+	struct Perf perf;
+	int w, z, s, h, first = 1, failed = 0;
+
+	if(!check_names(opts->workloads, "workload", NUM_WORKLOADS, workload_name) ||
+	   !check_names(opts->heaps, "heap", NUM_HEAPS, heap_name))
+		return 1;
+
+	for(z = 0; z < opts->numSizes; ++z)
+	{
+		if(opts->sizes[z] <= 0 || opts->sizes[z] > MAX_SIZE)
+		{
+			fprintf(stderr, "size %d out of range (1..%d)\n", opts->sizes[z], MAX_SIZE);
+			return 1;
+		}
+	}
+
+	if(opts->perf)
+		perf_open(&perf);
+
+	if(opts->json)
+	{
+		printf("[\n");
+	}
+	else
+	{
+		printf("workload,heap,size,seed,ops,ns_per_op,check");
+		if(HEAP_STATS_ENABLED)
+			printf(",compares,swaps,ref_updates,levels,coalesces,path_steps");
+		for(h = 0; opts->perf && h < PERF_NUM_EVENTS; ++h)
+			printf(",%s", perfEventNames[h]);
+		printf("\n");
+	}
+
+	for(w = 0; w < NUM_WORKLOADS; ++w)
+	{
+		if(!selected(opts->workloads, workloads[w].name))
+			continue;
+
+		for(z = 0; z < opts->numSizes; ++z)
+		{
+			int size = opts->sizes[z];
+
+			for(s = 0; s < numSeeds; ++s)
+			{
+				uint64_t refCheck = 0;
+				int haveRef = 0;
+
+				for(h = 0; h < NUM_HEAPS; ++h)
+				{
+					struct Run r;
+
+					if(!selected(opts->heaps, heaps[h]->name) ||
+					   (workloads[w].updates && !heaps[h]->remove))
+						continue;
+
+					memset(&r, 0, sizeof(r));
+					r.impl = heaps[h];
+					r.size = size;
+					r.numOps = numOps;
+					r.seed = seed + s;
+					r.perf = opts->perf ? &perf : 0;
+					workloads[w].run(&r);
+
+					print_row(&r, workloads[w].name, opts->json, first);
+					first = 0;
+					fflush(stdout);
+
+					if(!haveRef)
+					{
+						refCheck = r.check;
+						haveRef = 1;
+					}
+					else if(r.check != refCheck)
+					{
+						fprintf(stderr, "%s disagrees on %s (size %d, seed %u)!\n",
+							heaps[h]->name, workloads[w].name, size, r.seed);
+						failed = 1;
+					}
+				}
+			}
+		}
+	}
+
+	if(opts->json)
+		printf("%s]\n", first ? "" : "\n");
+	if(opts->perf)
+		perf_close(&perf);
+
+	return failed;
+}
@@ -0,0 +1,73 @@
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include <stdint.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+#include "pairheap.h"
+
+/*
+ * Element and heap interface shared by the benchmark suite (bench_suite.c)
+ * and the reference priority queues it compares against
+ * (bench_baseline.c).
+ */
+
+struct BinomialNode;
+
+struct Item
+{
+	uint64_t key;
+	int id;
+
+	/* workload-specific */
+	uint64_t aux;
+
+	/* an item is in at most one kind of heap per run */
+	union
+	{
+		struct binheap_node heap_node;
+		sbinheap_node_t sheap_node;
+
+		/* array heap: index in the array */
+		long pos;
+
+		struct pairheap_node pheap_node;
+
+		/* red-black tree */
+		struct
+		{
+			struct Item* parent;
+			struct Item* left;
+			struct Item* right;
+			int red;
+		} rb;
+
+		/* binomial heap: the node currently holding this item */
+		struct BinomialNode* binom;
+	};
+};
+
+/*
+ * A heap variant under test. top() returns 0 when empty. remove and
+ * decrease may be null if the heap cannot support them.
+ */
+struct HeapImpl
+{
+	const char* name;
+	void* (*create)(int maxSize);
+	void (*destroy)(void* h);
+	void (*add)(void* h, struct Item* it);
+	struct Item* (*top)(void* h);
+	void (*pop)(void* h);
+	void (*remove)(void* h, struct Item* it);
+	void (*decrease)(void* h, struct Item* it);
+	void (*stats)(void* h, struct heap_stats* s);
+};
+
+/* Reference implementations; no operation counters. */
+extern const struct HeapImpl arrayHeapImpl;
+extern const struct HeapImpl rbtreeImpl;
+extern const struct HeapImpl binomialHeapImpl;
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+#include "timerq.h"
+
+#include "bench.h"
+
+/*
+ * Idle timeouts of 'size' connections in an event loop. Each event is
+ * activity on a random connection, which pushes its timeout back, or (one
+ * in CLOSE_EVERY) a close, which cancels it and arms a new connection's.
+ * Simulated time advances between events so that roughly one connection
+ * in eight goes idle long enough to expire; expired connections are
+ * replaced by new ones.
+ *
+ * 'lazy' is timerq as is. 'eager' runs the same queue but sets its own
+ * timerfd to the earliest deadline after every change, the way a loop
+ * without timerq tracks the heap. Both count timerfd_settime() calls and
+ * must expire the same timers in the same order.
+ */
+
+#define TIMEOUT_NS	(30ull * 1000000000)
+#define CLOSE_EVERY	10
+
+struct Conn
+{
+	int id;
+	struct timerq_node timer;
+};
+
+struct Eager
+{
+	int fd;
+	timerq_time_t armed;
+	unsigned long reprograms;
+};
+
+/* Set the timerfd to the queue's earliest deadline, as after every change. */
+static void eager_sync(struct Eager* e, struct timerq* q)
+{
+	timerq_time_t next = timerq_next(q);
+
+#ifdef __linux__
+	struct itimerspec its = {{0, 0}, {0, 0}};
+
+	if(next != TIMERQ_DISARMED)
+	{
+		its.it_value.tv_sec = next / 1000000000;
+		its.it_value.tv_nsec = next % 1000000000;
+	}
+	(void)timerfd_settime(e->fd, TFD_TIMER_ABSTIME, &its, 0);
+#endif
+	e->armed = next;
+	++e->reprograms;
+}
+
+/*
+ * One trial. Returns the time in ns, the number of timerfd_settime() calls
+ * in 'syscalls', the number of expirations in 'expired' and a checksum of
+ * the expired connections in 'check'; 0 time means setup failed.
+ */
+static uint64_t run(int eager, int numOps, int size, unsigned int seed,
+                    unsigned long* syscalls, unsigned long* expired,
+                    uint64_t* check)
+{
+	struct Conn* conns = malloc(sizeof(*conns) * size);
+	struct sbinheap_node* buf = malloc(sizeof(*buf) * size);
+	struct timerq q;
+	struct Eager e = {-1, TIMERQ_DISARMED, 0};
+	/* far enough ahead that the fd never fires during the run */
+	timerq_time_t now = timerq_now() + 3600ull * 1000000000;
+	/* mean gap between events on one connection: TIMEOUT_NS / 2 */
+	uint64_t step = TIMEOUT_NS / size;
+	uint64_t start, nsec;
+	int i, nextId = 0;
+
+	if(timerq_init(&q, buf, size) < 0)
+	{
+		perror("timerq_init");
+		free(buf);
+		free(conns);
+		return 0;
+	}
+	if(eager)
+	{
+		/* the queue keeps no fd of its own; 'e' programs one instead */
+		e.fd = q.fd;
+		q.fd = -1;
+	}
+
+	for(i = 0; i < size; ++i)
+	{
+		conns[i].id = nextId++;
+		INIT_TIMERQ_NODE(&conns[i].timer);
+		timerq_arm(&q, &conns[i].timer, now + rand_r(&seed) % TIMEOUT_NS);
+	}
+	if(eager)
+		eager_sync(&e, &q);
+	q.reprograms = 0;
+	e.reprograms = 0;
+
+	*expired = 0;
+	*check = 0;
+	start = cpu_nsec();
+	for(i = 0; i < numOps; ++i)
+	{
+		struct Conn* c = &conns[rand_r(&seed) % size];
+
+		now += rand_r(&seed) % step;
+
+		if(rand_r(&seed) % CLOSE_EVERY == 0)
+		{
+			timerq_cancel(&q, &c->timer);
+			if(eager)
+				eager_sync(&e, &q);
+			c->id = nextId++;
+			timerq_arm(&q, &c->timer, now + TIMEOUT_NS);
+		}
+		else
+		{
+			timerq_rearm(&q, &c->timer, now + TIMEOUT_NS);
+		}
+		if(eager)
+			eager_sync(&e, &q);
+
+		/* the timerfd would have fired */
+		if(timerq_next(&q) <= now)
+		{
+			struct timerq_node* t = timerq_expire(&q, now);
+
+			if(eager)
+				eager_sync(&e, &q);
+			while(t)
+			{
+				struct timerq_node* next = t->next;
+				struct Conn* x = timerq_entry(t, struct Conn, timer);
+
+				*check = *check * 31 + x->id;
+				++*expired;
+				x->id = nextId++;
+				timerq_arm(&q, t, now + TIMEOUT_NS);
+				if(eager)
+					eager_sync(&e, &q);
+				t = next;
+			}
+		}
+	}
+	nsec = cpu_nsec() - start;
+
+	*syscalls = eager ? e.reprograms : q.reprograms;
+
+	if(eager)
+	{
+		q.fd = e.fd;
+	}
+	timerq_destroy(&q);
+	free(buf);
+	free(conns);
+
+	return nsec ? nsec : 1;
+}
+
+int bench_timerq(int numTrials, int numOps, int size, unsigned int seed)
+{
+	static const char* methods[] = {"lazy", "eager"};
+	uint64_t nsec[2] = {0, 0};
+	unsigned long syscalls[2] = {0, 0}, expired[2] = {0, 0};
+	int m, t;
+
+	if(numOps <= 0 || size <= 0)
+		return 0;
+
+	printf("%d events on %d connection timeouts, %d trials\n",
+		numOps, size, numTrials);
+
+	for(t = 0; t < numTrials; ++t)
+	{
+		uint64_t check[2];
+
+		for(m = 0; m < 2; ++m)
+		{
+			unsigned long s, x;
+			uint64_t ns = run(m, numOps, size, seed + t, &s, &x, &check[m]);
+
+			if(!ns)
+				return 1;
+			nsec[m] += ns;
+			syscalls[m] += s;
+			expired[m] += x;
+		}
+		if(check[0] != check[1])
+		{
+			printf("lazy and eager expired different timers!\n");
+			return 1;
+		}
+	}
+
+	printf("%-6s %12s %14s %14s\n", "method", "ns/event", "settime/event",
+		"expired/trial");
+	for(m = 0; m < 2; ++m)
+	{
+		printf("%-6s %12.1f %14.3f %14lu\n", methods[m],
+			(double)nsec[m] / numTrials / numOps,
+			(double)syscalls[m] / numTrials / numOps,
+			expired[m] / numTrials);
+	}
+	printf("\n");
+
+	return 0;
+}
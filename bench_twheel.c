@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "twheel.h"
+
+#include "bench.h"
+
+/*
+ * Timing wheel check: a pool of 'size' timers is armed 'numOps' times in
+ * total, with delays spread log-uniformly from one tick to beyond the
+ * reach of the top level, so timers cascade through every level and the
+ * overflow list. About a third are cancelled while pending. Time advances
+ * in steps of random size, and after each step every expired timer is
+ * drained. Each fired timer must be armed and not cancelled, due by now
+ * but not by the previous step, and fire in order of expiry; every timer
+ * that is not cancelled must fire.
+ */
+
+struct WTimer
+{
+	int armed;
+	struct twheel_node node;
+};
+
+/* Random delay of at most 'maxBits' bits, log-uniformly distributed. */
+static twheel_time_t delay(int maxBits, unsigned int* seed)
+{
+	int bits = rand_r(seed) % (maxBits + 1);
+	twheel_time_t r = ((twheel_time_t)rand_r(seed) << 31) ^ rand_r(seed);
+
+	return r & (((twheel_time_t)1 << bits) - 1);
+}
+
+struct WResult
+{
+	uint64_t nsec;
+	long fired;
+	long cancelled;
+	int ok;
+};
+
+/* Drain the expired timers after an advance from 'prev' to wheel->now. */
+static void drain(struct twheel* wheel, twheel_time_t prev, long* fired,
+                  int* ok)
+{
+	struct twheel_node* t;
+	twheel_time_t last = 0;
+
+	while((t = twheel_expire(wheel)) != 0)
+	{
+		struct WTimer* w = twheel_entry(t, struct WTimer, node);
+
+		if(!w->armed || t->expires > wheel->now || t->expires <= prev ||
+		   t->expires < last || twheel_is_pending(t))
+			*ok = 0;
+		last = t->expires;
+		w->armed = 0;
+		++*fired;
+	}
+}
+
+static void run(int numOps, int size, unsigned int seed, struct WResult* res)
+{
+	/* one level past the top, to reach the overflow list */
+	const int maxBits = TWHEEL_BITS * (TWHEEL_LEVELS + 2);
+	struct WTimer* timers = malloc(sizeof(*timers) * size);
+	struct twheel* wheel = malloc(sizeof(*wheel));
+	twheel_time_t horizon = 0;
+	uint64_t start;
+	int i, adds = 0;
+
+	INIT_TWHEEL(wheel, 0);
+	for(i = 0; i < size; ++i)
+	{
+		timers[i].armed = 0;
+		INIT_TWHEEL_NODE(&timers[i].node);
+	}
+
+	start = cpu_nsec();
+	while(adds < numOps)
+	{
+		struct WTimer* w = &timers[rand_r(&seed) % size];
+		twheel_time_t prev = wheel->now;
+
+		if(!w->armed)
+		{
+			twheel_time_t expires = wheel->now + 1 + delay(maxBits, &seed);
+
+			twheel_add(&w->node, wheel, expires);
+			w->armed = 1;
+			if(expires > horizon)
+				horizon = expires;
+			++adds;
+		}
+		else if(rand_r(&seed) % 3 == 0)
+		{
+			twheel_cancel(&w->node, wheel);
+			if(twheel_is_pending(&w->node))
+				res->ok = 0;
+			w->armed = 0;
+			++res->cancelled;
+		}
+
+		/* steps are short next to the delays, but span many slots */
+		twheel_advance(wheel, wheel->now + delay(maxBits / 2, &seed));
+		drain(wheel, prev, &res->fired, &res->ok);
+	}
+
+	/* everything still armed must fire by the last deadline */
+	if(horizon > wheel->now)
+	{
+		twheel_time_t prev = wheel->now;
+
+		twheel_advance(wheel, horizon);
+		drain(wheel, prev, &res->fired, &res->ok);
+	}
+	res->nsec += cpu_nsec() - start;
+
+	for(i = 0; i < size; ++i)
+		if(timers[i].armed)
+			res->ok = 0;
+
+	free(wheel);
+	free(timers);
+}
+
+int bench_twheel(int numTrials, int numOps, int size, unsigned int seed)
+{
+	struct WResult res = {0, 0, 0, 1};
+	int t;
+
+	if(numOps <= 0 || size <= 0)
+		return 0;
+
+	for(t = 0; t < numTrials; ++t)
+		run(numOps, size, seed + t, &res);
+
+	printf("%d timers armed from a pool of %d, %d trials\n",
+		numOps, size, numTrials);
+	printf("fired %ld, cancelled %ld, %.1f ns per timer\n\n",
+		res.fired / numTrials, res.cancelled / numTrials,
+		(double)res.nsec / numTrials / numOps);
+
+	if(!res.ok)
+	{
+		printf("twheel fired a timer early, late, out of order or after "
+			"cancel, or lost one!\n");
+		return 1;
+	}
+
+	return 0;
+}
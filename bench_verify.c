@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include "bench.h"
+
+/*
+ * Cost of an integrity check on a live heap, e.g. on a canary host: one
+ * verify pass over a valid heap of 'size' entries, then, after 'corrupt'
+ * keys were changed in place without a decrease/update, a verify that
+ * must report the broken order and a repair that must restore it.
+ */
+
+struct VData
+{
+	uint64_t key;
+	struct binheap_node heap_node;
+	sbinheap_node_t sheap_node;
+};
+
+static int less(const struct binheap_node* A, const struct binheap_node* B)
+{
+	return binheap_entry(A, struct VData, heap_node)->key <
+	       binheap_entry(B, struct VData, heap_node)->key;
+}
+
+static int sless(const struct sbinheap_node* A, const struct sbinheap_node* B)
+{
+	return sbinheap_entry(A, struct VData, sheap_node)->key <
+	       sbinheap_entry(B, struct VData, sheap_node)->key;
+}
+
+struct VResult
+{
+	uint64_t verifyNsec;
+	uint64_t repairNsec;
+	int ok;
+};
+
+static void run(int sbin, int corrupt, int size, unsigned int seed,
+                struct VResult* res)
+{
+	struct VData* items = malloc(sizeof(*items) * size);
+	struct binheap bheap;
+	struct sbinheap sheap;
+	uint64_t start, prev;
+	int i, r;
+
+	INIT_BINHEAP(&bheap, less);
+	sheap.compare = sless;
+	sheap.max_size = size;
+	sheap.buf = malloc(sizeof(*sheap.buf) * size);
+	INIT_SBINHEAP(&sheap);
+
+	for(i = 0; i < size; ++i)
+	{
+		items[i].key = (uint64_t)rand_r(&seed) + 1;
+		INIT_BINHEAP_NODE(&items[i].heap_node);
+		INIT_SBINHEAP_NODE(&items[i].sheap_node);
+		if(sbin)
+			sbinheap_add(&items[i].sheap_node, &sheap, struct VData, sheap_node);
+		else
+			binheap_add(&items[i].heap_node, &bheap, struct VData, heap_node);
+	}
+
+	start = cpu_nsec();
+	r = sbin ? sbinheap_verify(&sheap) : binheap_verify(&bheap);
+	res->verifyNsec += cpu_nsec() - start;
+	res->ok &= (r == (sbin ? SBINHEAP_VERIFY_OK : BINHEAP_VERIFY_OK));
+
+	/*
+	 * Keys changed in place. Zeroing the last element's key is sure to
+	 * break the order (all keys start above 0); the rest are halved.
+	 */
+	if(corrupt && size > 1)
+	{
+		struct VData* last = sbin
+			? sbinheap_entry(sheap.buf + sheap.size - 1, struct VData, sheap_node)
+			: binheap_entry(bheap.last, struct VData, heap_node);
+
+		last->key = 0;
+	}
+	for(i = 1; i < corrupt; ++i)
+		items[rand_r(&seed) % size].key /= 2;
+
+	start = cpu_nsec();
+	r = sbin ? sbinheap_repair(&sheap) : binheap_repair(&bheap);
+	res->repairNsec += cpu_nsec() - start;
+	if(corrupt && size > 1)
+		res->ok &= (r == (sbin ? SBINHEAP_VERIFY_ORDER : BINHEAP_VERIFY_ORDER));
+
+	r = sbin ? sbinheap_verify(&sheap) : binheap_verify(&bheap);
+	res->ok &= (r == (sbin ? SBINHEAP_VERIFY_OK : BINHEAP_VERIFY_OK));
+
+	/* and it still pops in order */
+	for(i = 0, prev = 0; i < size; ++i)
+	{
+		struct VData* d = sbin
+			? sbinheap_delete_root(&sheap, struct VData, sheap_node)
+			: binheap_delete_root(&bheap, struct VData, heap_node);
+
+		res->ok &= (d->key >= prev);
+		prev = d->key;
+	}
+
+	free(sheap.buf);
+	free(items);
+}
+
+int bench_verify(int numTrials, int corrupt, int size, unsigned int seed)
+{
+	int sbin, t;
+
+	if(size <= 0 || corrupt < 0)
+		return 0;
+
+	printf("heap of %d, %d keys corrupted, %d trials; ns per element\n",
+		size, corrupt, numTrials);
+	printf("%-9s %10s %10s\n", "heap", "verify", "repair");
+
+	for(sbin = 0; sbin < 2; ++sbin)
+	{
+		struct VResult res = {0, 0, 1};
+
+		for(t = 0; t < numTrials; ++t)
+			run(sbin, corrupt, size, seed + t, &res);
+
+		if(!res.ok)
+		{
+			printf("%s verify/repair gave a wrong result!\n",
+				sbin ? "sbinheap" : "binheap");
+			return 1;
+		}
+		printf("%-9s %10.2f %10.2f\n", sbin ? "sbinheap" : "binheap",
+			(double)res.verifyNsec / numTrials / size,
+			(double)res.repairNsec / numTrials / size);
+	}
+	printf("\n");
+
+	return 0;
+}
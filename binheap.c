@@ -16,6 +16,11 @@ int binheap_is_in_this_heap(const struct binheap_node *node,
 }
 
 
+/* Call the comparator 'cmp' of 'handle', counting the call in its stats. */
+#define __binheap_cmp(handle, cmp, a, b) \
+	(heap_stat_inc((handle), compares), (cmp)((a), (b)))
+
+
 /* Update the node reference pointers.  Same logic as Litmus binomial heap. */
 static void __update_ref(struct binheap_node *restrict parent,
 				struct binheap_node *restrict child)
@@ -28,9 +33,13 @@ static void __update_ref(struct binheap_node *restrict parent,
 
 
 /* Swaps data between two nodes. */
-static void __binheap_swap(struct binheap_node *restrict parent,
+static void __binheap_swap(struct binheap *handle,
+				struct binheap_node *restrict parent,
 				struct binheap_node *restrict child)
 {
+	heap_stat_inc(handle, swaps);
+	heap_stat_add(handle, ref_updates, 2);
+
 	__update_ref(parent, child);
 	swap(parent->data, child->data);
 }
@@ -43,6 +52,9 @@ static void __binheap_swap_safe(struct binheap *handle,
 				struct binheap_node *restrict a,
 				struct binheap_node *restrict b)
 {
+	heap_stat_inc(handle, coalesces);
+	heap_stat_add(handle, ref_updates, 2);
+
 	__update_ref(a, b);
 	swap(a->data, b->data);
 
@@ -132,6 +144,7 @@ static void __binheap_update_last(struct binheap *handle)
 	/* find a "bend" in the tree. */
 	while(temp->parent && (temp == temp->parent->left)) {
 		temp = temp->parent;
+		heap_stat_inc(handle, path_steps);
 	}
 
 	/* step over to sibling if we're not at root */
@@ -142,6 +155,7 @@ static void __binheap_update_last(struct binheap *handle)
 	/* now travel right as far as possible. */
 	while(temp->right != 0) {
 		temp = temp->right;
+		heap_stat_inc(handle, path_steps);
 	}
 
 	/* take one step to the left if we're not at the bottom-most level. */
@@ -164,6 +178,7 @@ static void __binheap_update_next(struct binheap *handle)
 	/* find a "bend" in the tree. */
 	while(temp->parent && (temp == temp->parent->right)) {
 		temp = temp->parent;
+		heap_stat_inc(handle, path_steps);
 	}
 
 	/* step over to sibling if we're not at root */
@@ -174,61 +189,108 @@ static void __binheap_update_next(struct binheap *handle)
 	/* now travel left as far as possible. */
 	while(temp->left != 0) {
 		temp = temp->left;
+		heap_stat_inc(handle, path_steps);
 	}
 
 	handle->next = temp;
 }
 
 
-static void __binheap_for_each(struct binheap_node *h,
-				binheap_for_each_t fn, void* args)
-{
-	/* Apply fn to all nodes. Beware of recursion. */
-
-	/* pre-order */
-	fn(h, args);
-
-	if(h->left)
-		__binheap_for_each(h->left, fn, args);
-	if(h->right)
-		__binheap_for_each(h->right, fn, args);
-}
-
 /* Apply fn to each node. */
 void binheap_for_each(struct binheap *heap, binheap_for_each_t fn, void* args)
 {
-	if (!binheap_empty(heap))
-		__binheap_for_each(heap->root, fn, args);
+	struct binheap_node *node;
+
+	binheap_for_each_node(node, heap) {
+		fn(node, args);
+	}
 }
 
 
-/* bubble node up towards root */
-static void __binheap_bubble_up(struct binheap *handle,
+/* bubble node up towards root. Returns the number of levels moved. */
+static int __binheap_bubble_up(struct binheap *handle,
 				struct binheap_node *node)
 {
 	const binheap_order_t cmp = handle->compare;
+	int levels = 0;
 
 	/* let BINHEAP_POISON data bubble to the top */
 
 	while((node->parent != 0) &&
 		  ((node->data == BINHEAP_POISON) ||
-		   cmp(node, node->parent))) {
-			  __binheap_swap(node->parent, node);
+		   __binheap_cmp(handle, cmp, node, node->parent))) {
+			  __binheap_swap(handle, node->parent, node);
 			  node = node->parent;
+			  ++levels;
+			  heap_stat_inc(handle, levels);
+	}
+
+	return levels;
+}
+
+
+/**
+ * Prefetch for a sift-down at 'node': walk handle->prefetch - 1 levels down
+ * (nodes brought in by earlier prefetches), then prefetch the data of that
+ * level and the children below it.
+ */
+static inline void __binheap_prefetch(const struct binheap *handle,
+				const struct binheap_node *node)
+{
+	const struct binheap_node *level[1 << (BINHEAP_PREFETCH_MAX - 1)];
+	int n = 1, d, i;
+
+	level[0] = node;
+	for(d = 1; d < handle->prefetch; ++d) {
+		int next = 0;
+
+		/* expand in place, back to front */
+		for(i = n - 1; i >= 0; --i) {
+			const struct binheap_node *p = level[i];
+
+			level[2*i] = p ? p->left : 0;
+			level[2*i + 1] = p ? p->right : 0;
+			next += (level[2*i] != 0);
+		}
+		if(!next) {
+			return;
+		}
+		n *= 2;
+	}
+
+	for(i = 0; i < n; ++i) {
+		if(!level[i]) {
+			continue;
+		}
+		if(d > 1) {
+			/* compared against, and its owner's ref is rewritten on a swap */
+			prefetch(level[i]->data);
+			__builtin_prefetch(level[i]->ref_ptr, 1);
+		}
+		if(level[i]->left) {
+			prefetch(level[i]->left);
+			if(level[i]->right) {
+				prefetch(level[i]->right);
+			}
+		}
 	}
 }
 
 
 /* bubble node down, swapping with min-child */
-static void __binheap_bubble_down(struct binheap *handle)
+static void __binheap_bubble_down(struct binheap *handle,
+				struct binheap_node *node)
 {
 	const binheap_order_t cmp = handle->compare;
-	struct binheap_node *node = handle->root;
 
 	while(node->left != 0) {
-		if(node->right && cmp(node->right, node->left)) {
-			if(cmp(node->right, node)) {
-				__binheap_swap(node, node->right);
+		if(handle->prefetch) {
+			__binheap_prefetch(handle, node);
+		}
+
+		if(node->right && __binheap_cmp(handle, cmp, node->right, node->left)) {
+			if(__binheap_cmp(handle, cmp, node->right, node)) {
+				__binheap_swap(handle, node, node->right);
 				node = node->right;
 			}
 			else {
@@ -236,19 +298,21 @@ static void __binheap_bubble_down(struct binheap *handle)
 			}
 		}
 		else {
-			if(cmp(node->left, node)) {
-				__binheap_swap(node, node->left);
+			if(__binheap_cmp(handle, cmp, node->left, node)) {
+				__binheap_swap(handle, node, node->left);
 				node = node->left;
 			}
 			else {
 				break;
 			}
 		}
+		heap_stat_inc(handle, levels);
 	}
 }
 
 
-void __binheap_add(struct binheap_node *new_node,
+/* Link a node into the next free position of the tree, without sifting. */
+static inline void __binheap_link(struct binheap_node *new_node,
 				struct binheap *handle,
 				void *data)
 {
@@ -265,8 +329,6 @@ void __binheap_add(struct binheap_node *new_node,
 			new_node->right = 0;
 
 			handle->last = new_node;
-
-			__binheap_bubble_up(handle, new_node);
 		}
 		else {
 			/* left occupied. insert right. */
@@ -278,7 +340,6 @@ void __binheap_add(struct binheap_node *new_node,
 			handle->last = new_node;
 
 			__binheap_update_next(handle);
-			__binheap_bubble_up(handle, new_node);
 		}
 	}
 	else {
@@ -295,6 +356,35 @@ void __binheap_add(struct binheap_node *new_node,
 }
 
 
+void __binheap_add(struct binheap_node *new_node,
+				struct binheap *handle,
+				void *data)
+{
+	__binheap_link(new_node, handle, data);
+	__binheap_bubble_up(handle, new_node);
+	__binheap_publish(handle);
+}
+
+
+void __binheap_append(struct binheap_node *new_node,
+				struct binheap *handle,
+				void *data)
+{
+	new_node->data = data;
+	new_node->parent = 0;
+	new_node->left = 0;
+	new_node->right = 0;
+
+	if(handle->batch_tail) {
+		handle->batch_tail->right = new_node;
+	}
+	else {
+		handle->batch_head = new_node;
+	}
+	handle->batch_tail = new_node;
+}
+
+
 /**
  * Removes the root node from the heap. The node is removed after coalescing
  * the binheap_node with its original data pointer at the root of the tree.
@@ -366,7 +456,7 @@ void* __binheap_delete_root(struct binheap *handle,
 		handle->root = to_move;
 
 		/* bubble down */
-		__binheap_bubble_down(handle);
+		__binheap_bubble_down(handle, handle->root);
 	}
 	else {
 		/* removing last node in tree */
@@ -378,6 +468,8 @@ void* __binheap_delete_root(struct binheap *handle,
 	/* mark as removed */
 	container->parent = BINHEAP_POISON;
 
+	__binheap_publish(handle);
+
 	return data;
 }
 
@@ -414,4 +506,421 @@ void __binheap_decrease(struct binheap_node *orig_node,
 	struct binheap_node *target = orig_node->ref;
 
 	__binheap_bubble_up(handle, target);
+	__binheap_publish(handle);
+}
+
+
+/* Number of nodes in the heap, from the path to 'last'. O(log n). */
+static size_t __binheap_size(const struct binheap *handle)
+{
+	const struct binheap_node *node = handle->last;
+	size_t bits = 0;
+	int depth = 0;
+
+	if(!node) {
+		return 0;
+	}
+
+	/* the path from the root spells out last's 1-based index */
+	while(node->parent) {
+		if(node == node->parent->right) {
+			bits |= (size_t)1 << depth;
+		}
+		node = node->parent;
+		++depth;
+	}
+
+	return ((size_t)1 << depth) | bits;
+}
+
+
+/* Leftmost leaf below 'node'; the first node of its post-order. */
+static struct binheap_node* __binheap_first_leaf(struct binheap_node *node)
+{
+	/* the tree is complete, so a node without a left child is a leaf */
+	while(node->left) {
+		node = node->left;
+	}
+	return node;
+}
+
+
+/* Successor of 'node' in post-order, or 0 after the root. */
+static struct binheap_node* __binheap_post_next(struct binheap_node *node)
+{
+	struct binheap_node *p = node->parent;
+
+	if(!p) {
+		return 0;
+	}
+	if((node == p->left) && p->right) {
+		return __binheap_first_leaf(p->right);
+	}
+	return p;
+}
+
+
+/* Height of 'node'; the leftmost path is always the longest. */
+static int __binheap_height(const struct binheap_node *node)
+{
+	int h = 0;
+
+	while(node->left) {
+		node = node->left;
+		++h;
+	}
+	return h;
+}
+
+
+void binheap_rebuild_start(struct binheap_rebuild *c, struct binheap *handle,
+				binheap_remap_t remap, void *args)
+{
+	size_t n = __binheap_size(handle);
+
+	c->heap = handle;
+	c->remap = remap;
+	c->args = args;
+	c->next = handle->root ? __binheap_first_leaf(handle->root) : 0;
+	c->sift = 0;
+	c->sift_left = 0;
+	c->have_best = 0;
+
+	/* one visit per node plus the sum of node heights, n - popcount(n) */
+	c->remaining = 2*n - __builtin_popcountl(n);
+}
+
+
+size_t binheap_rebuild_step(struct binheap_rebuild *c, size_t budget)
+{
+	const binheap_order_t cmp = c->heap->compare;
+
+	while(budget && c->remaining) {
+		struct binheap_node *node = c->sift;
+
+		if(!node) {
+			/* visit the next node */
+			node = c->next;
+			c->next = __binheap_post_next(node);
+
+			if(c->remap) {
+				c->remap(node->data, c->args);
+			}
+			if(!c->have_best || __binheap_cmp(c->heap, cmp, node, &c->best)) {
+				c->best.data = node->data;
+				c->have_best = 1;
+			}
+
+			c->sift = node;
+			c->sift_left = __binheap_height(node);
+			--c->remaining;
+			--budget;
+		}
+		else {
+			/* one level of sift-down */
+			struct binheap_node *child = node->left;
+
+			if(!child) {
+				/* reached a leaf of a shallower right subtree */
+				c->remaining -= c->sift_left;
+				c->sift = 0;
+				c->sift_left = 0;
+				continue;
+			}
+			if(node->right && __binheap_cmp(c->heap, cmp, node->right, child)) {
+				child = node->right;
+			}
+
+			--c->sift_left;
+			--c->remaining;
+			--budget;
+
+			if(__binheap_cmp(c->heap, cmp, child, node)) {
+				__binheap_swap(c->heap, node, child);
+				c->sift = child;
+				heap_stat_inc(c->heap, levels);
+			}
+			else {
+				/* stopped early; the skipped levels will not be needed */
+				c->remaining -= c->sift_left;
+				c->sift_left = 0;
+			}
+		}
+
+		if(!c->sift_left) {
+			c->sift = 0;
+		}
+	}
+
+	if(!c->remaining) {
+		__binheap_publish(c->heap);
+	}
+
+	return c->remaining;
+}
+
+
+void* binheap_rebuild_top(struct binheap_rebuild *c)
+{
+	struct binheap *handle = c->heap;
+
+	if(binheap_empty(handle)) {
+		return 0;
+	}
+	if(!c->remaining) {
+		return handle->root->data;
+	}
+
+	/* the unvisited nodes are a heap rooted at the root under old keys */
+	if(c->next) {
+		if(c->have_best &&
+				__binheap_cmp(handle, handle->compare, &c->best, handle->root)) {
+			return c->best.data;
+		}
+		return handle->root->data;
+	}
+
+	return c->best.data;
+}
+
+
+/* 1-based level-order position of 'node', from its path. O(log n). */
+static size_t __binheap_index(const struct binheap_node *node)
+{
+	size_t bits = 0;
+	int depth = 0;
+
+	while(node->parent) {
+		if(node == node->parent->right) {
+			bits |= (size_t)1 << depth;
+		}
+		node = node->parent;
+		++depth;
+	}
+
+	return ((size_t)1 << depth) | bits;
+}
+
+
+/* Previous node in level order; 'node' must not be the root. */
+static struct binheap_node* __binheap_level_prev(struct binheap_node *node)
+{
+	int up = 0;
+
+	/* find a "bend" in the tree. */
+	while(node->parent && (node == node->parent->left)) {
+		node = node->parent;
+		++up;
+	}
+
+	if(node->parent) {
+		node = node->parent->left;
+	}
+	else {
+		/* was the first of its level: go to the end of the one above */
+		--up;
+	}
+
+	while(up--) {
+		node = node->right;
+	}
+	return node;
+}
+
+
+/**
+ * Heapify the nodes from 'first' to the last and all of their ancestors,
+ * bottom-up, one contiguous level-order range per level. See
+ * __sbinheap_heapify_ancestors(); here the ranges are walked with
+ * __binheap_level_prev(), which is O(1) amortized along a sweep.
+ */
+static void __binheap_heapify_ancestors(struct binheap *handle,
+				struct binheap_node *first)
+{
+	struct binheap_node *lo_node = first;
+	struct binheap_node *hi_node = handle->last;
+	size_t lo = __binheap_index(first);
+	size_t hi = __binheap_size(handle);
+
+	/* leaves need no sift; the last internal node is the last's parent */
+	if(hi_node->parent) {
+		size_t i = hi / 2;
+		struct binheap_node *node = hi_node->parent;
+
+		for(; i >= lo; --i) {
+			__binheap_bubble_down(handle, node);
+			if(i == lo) {
+				break;
+			}
+			node = __binheap_level_prev(node);
+		}
+	}
+
+	while(lo > 1) {
+		/* parents of [lo, hi], excluding any already done */
+		size_t next_hi = hi / 2;
+		struct binheap_node *next_hi_node = hi_node->parent;
+		size_t i;
+		struct binheap_node *node;
+
+		if(next_hi >= lo) {
+			next_hi = lo - 1;
+			next_hi_node = __binheap_level_prev(lo_node);
+		}
+		lo = lo / 2;
+		lo_node = lo_node->parent;
+		hi = next_hi;
+		hi_node = next_hi_node;
+
+		for(i = hi, node = hi_node; ; --i) {
+			__binheap_bubble_down(handle, node);
+			if(i == lo) {
+				break;
+			}
+			node = __binheap_level_prev(node);
+		}
+	}
+}
+
+
+void binheap_add_batch(struct binheap *handle)
+{
+	struct binheap_node *node = handle->batch_head;
+	struct binheap_node *heapify_from = 0;
+	size_t size = __binheap_size(handle);
+	long depth = size ? ilog2(size) : -1;
+	long levels = 0;
+	size_t done = 0;
+
+	handle->batch_head = 0;
+	handle->batch_tail = 0;
+
+	for(; node; ++done) {
+		struct binheap_node *next = node->right;
+
+		__binheap_link(node, handle, node->data);
+
+		/* depth of the node just linked */
+		++size;
+		if((size & (size - 1)) == 0) {
+			++depth;
+		}
+
+		if(!heapify_from && ((done % BINHEAP_BATCH_MIN) == 0)) {
+			if(levels > (depth - BINHEAP_BATCH_SLACK) * BINHEAP_BATCH_MIN) {
+				heapify_from = node;
+			}
+			levels = 0;
+		}
+		if(!heapify_from) {
+			levels += __binheap_bubble_up(handle, node);
+		}
+
+		node = next;
+	}
+
+	if(heapify_from) {
+		__binheap_heapify_ancestors(handle, heapify_from);
+	}
+
+	__binheap_publish(handle);
+}
+
+
+int binheap_verify(struct binheap *handle)
+{
+	const binheap_order_t cmp = handle->compare;
+	struct binheap_node *node = handle->root;
+	/* level-order position of 'node', 1-based */
+	size_t idx = 1;
+	size_t count = 0, max_idx = 0, last_idx = 0, next_idx = 0;
+	int result = BINHEAP_VERIFY_OK;
+
+	if(!node) {
+		return (handle->next || handle->last) ?
+			BINHEAP_VERIFY_LINKS : BINHEAP_VERIFY_OK;
+	}
+	if(node->parent) {
+		return BINHEAP_VERIFY_LINKS;
+	}
+
+	/* pre-order on parent pointers: each child must point back to its
+	 * parent, so the walk climbs exactly the path it came down */
+	for(;;) {
+		struct binheap_node *l = node->left;
+		struct binheap_node *r = node->right;
+
+		if(!node->ref_ptr || (*(node->ref_ptr) != node)) {
+			return BINHEAP_VERIFY_LINKS;
+		}
+		if((!l && r) || (l && (l == r)) ||
+				(l && (l->parent != node)) || (r && (r->parent != node))) {
+			return BINHEAP_VERIFY_LINKS;
+		}
+		if((l && __binheap_cmp(handle, cmp, l, node)) ||
+				(r && __binheap_cmp(handle, cmp, r, node))) {
+			result = BINHEAP_VERIFY_ORDER;
+		}
+
+		++count;
+		if(idx > max_idx) {
+			max_idx = idx;
+		}
+		if(node == handle->last) {
+			last_idx = idx;
+		}
+		if(node == handle->next) {
+			next_idx = idx;
+		}
+
+		if(l) {
+			/* deeper than any tree that fits in memory */
+			if(unlikely(idx > ((size_t)-1) / 4)) {
+				return BINHEAP_VERIFY_LINKS;
+			}
+			node = l;
+			idx *= 2;
+			continue;
+		}
+
+		/* climb to the first ancestor with an unvisited right subtree */
+		while(node->parent &&
+				((node == node->parent->right) || !node->parent->right)) {
+			node = node->parent;
+			idx /= 2;
+		}
+		if(!node->parent) {
+			break;
+		}
+		node = node->parent->right;
+		++idx;
+	}
+
+	/* positions are distinct, so they fill 1..count iff the tree is
+	 * complete; 'next' takes the child at count + 1 */
+	if((max_idx != count) || (last_idx != count) ||
+			(next_idx != (count + 1) / 2)) {
+		return BINHEAP_VERIFY_LINKS;
+	}
+
+	return result;
+}
+
+
+int binheap_repair(struct binheap *handle)
+{
+	int result = binheap_verify(handle);
+
+	if(result == BINHEAP_VERIFY_ORDER) {
+		struct binheap_node *node;
+
+		/* sift down every node after its subtrees */
+		for(node = __binheap_first_leaf(handle->root); node;
+				node = __binheap_post_next(node)) {
+			__binheap_bubble_down(handle, node);
+		}
+		__binheap_publish(handle);
+	}
+
+	return result;
 }
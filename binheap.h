@@ -2,6 +2,8 @@
 #define BINARY_HEAP_H
 
 #include "defs.h"
+#include "heaptop.h"
+#include "heapstats.h"
 
 /**
  * Simple binary heap with add, arbitrary delete, delete_root, and top
@@ -68,8 +70,24 @@ struct binheap {
 
 	/* comparator function pointer */
 	binheap_order_t compare;
+
+	/* nodes queued by binheap_append(), chained through 'right' */
+	struct binheap_node *batch_head;
+	struct binheap_node *batch_tail;
+	/* if set, the root is published here after each mutation */
+	struct heaptop *pub;
+
+	/* levels ahead to prefetch during sift-down; 0 disables */
+	int prefetch;
+
+#ifdef BINHEAP_STATS
+	struct heap_stats stats;
+#endif
 };
 
+/* Largest useful prefetch distance; each level doubles the prefetches. */
+#define BINHEAP_PREFETCH_MAX 4
+
 
 /**
  * binheap_entry - get the struct for this heap node.
@@ -128,6 +146,18 @@ __binheap_delete((to_delete), (handle))
 #define binheap_add(new_node, handle, type, member) \
 __binheap_add((new_node), (handle), container_of((new_node), type, member))
 
+/**
+ * binheap_append - queue an element for the next binheap_add_batch(). The
+ * element is not in the heap's order (or visible to top) until then, and
+ * must not be deleted or decreased before.
+ * new_node: node to add.
+ * @handle:	 handle to the heap.
+ * @type:	the type of the struct the head is embedded in.
+ * @member:	 the name of the binheap_struct within the (type) struct.
+ */
+#define binheap_append(new_node, handle, type, member) \
+__binheap_append((new_node), (handle), container_of((new_node), type, member))
+
 /**
  * binheap_decrease - re-eval the position of a node (based upon its
  * original data pointer).
@@ -140,6 +170,33 @@ __binheap_add((new_node), (handle), container_of((new_node), type, member))
 __binheap_decrease((orig_node), (handle))
 
 
+/**
+ * Copy the heap's operation counters (see heapstats.h) into 'stats'.
+ * Returns 0, or -1 with 'stats' zeroed if built without BINHEAP_STATS.
+ * Serialize with the heap's writers; the counters are not atomic.
+ */
+static inline int binheap_stats(const struct binheap *handle,
+				struct heap_stats *stats)
+{
+#ifdef BINHEAP_STATS
+	*stats = handle->stats;
+	return 0;
+#else
+	static const struct heap_stats zero;
+	*stats = zero;
+	return -1;
+#endif
+}
+
+/* Zero the heap's operation counters. No-op without BINHEAP_STATS. */
+static inline void binheap_stats_reset(struct binheap *handle)
+{
+#ifdef BINHEAP_STATS
+	static const struct heap_stats zero;
+	handle->stats = zero;
+#endif
+}
+
 static inline void INIT_BINHEAP_NODE(struct binheap_node *n)
 {
 	static const struct binheap_node init_node = BINHEAP_NODE_INIT();
@@ -153,6 +210,30 @@ static inline void INIT_BINHEAP(struct binheap *handle,
 	handle->next = 0;
 	handle->last = 0;
 	handle->compare = compare;
+	handle->batch_head = 0;
+	handle->batch_tail = 0;
+	handle->pub = 0;
+	handle->prefetch = 0;
+	binheap_stats_reset(handle);
+}
+
+/**
+ * Prefetch 'distance' levels ahead while sifting down (0 disables; at most
+ * BINHEAP_PREFETCH_MAX). At each level, the nodes 'distance' levels below
+ * and the data of the nodes one level above those are prefetched. Finding
+ * them follows child pointers that earlier prefetches brought in. Pays off
+ * once the heap and its data exceed the last-level cache. Call after
+ * INIT_BINHEAP().
+ */
+static inline void binheap_set_prefetch(struct binheap *handle, int distance)
+{
+	if(distance < 0) {
+		distance = 0;
+	}
+	if(distance > BINHEAP_PREFETCH_MAX) {
+		distance = BINHEAP_PREFETCH_MAX;
+	}
+	handle->prefetch = distance;
 }
 
 /* Returns true if binheap is empty. */
@@ -161,6 +242,27 @@ static inline int binheap_empty(struct binheap *handle)
 	return(handle->root == 0);
 }
 
+/**
+ * Opt in to publishing the root into 'top' after every mutating operation,
+ * so that other threads can read it without the heap's lock (see heaptop.h).
+ * 'top' must already be initialized with INIT_HEAPTOP(). Pass 0 to opt out.
+ */
+static inline void binheap_publish_top(struct binheap *handle,
+				struct heaptop *top)
+{
+	handle->pub = top;
+	if(top) {
+		heaptop_publish(top, handle->root ? handle->root->data : 0);
+	}
+}
+
+static inline void __binheap_publish(struct binheap *handle)
+{
+	if(handle->pub) {
+		heaptop_publish(handle->pub, handle->root ? handle->root->data : 0);
+	}
+}
+
 /* Returns true if binheap node is in a heap. */
 static inline int binheap_is_in_heap(const struct binheap_node *node)
 {
@@ -175,11 +277,72 @@ typedef void (*binheap_for_each_t)(struct binheap_node *node, void* args);
 /* Visit every node in heap with function fn(args). Visit order undefined. */
 void binheap_for_each(struct binheap *heap, binheap_for_each_t fn, void* args);
 
+/* Successor of 'node' in pre-order, or 0. Uses parent pointers; no stack. */
+static inline struct binheap_node* __binheap_preorder_next(
+				const struct binheap_node *node)
+{
+	if(node->left) {
+		return node->left;
+	}
+
+	/* climb until we come up from a left child that has a right sibling */
+	while(node->parent) {
+		if((node == node->parent->left) && node->parent->right) {
+			return node->parent->right;
+		}
+		node = node->parent;
+	}
+	return 0;
+}
+
+/**
+ * binheap_for_each_node - iterate over the nodes of a heap, in pre-order.
+ * The heap must not be modified during the walk.
+ * @pos:	the struct binheap_node * to use as a loop cursor.
+ * @heap:	the heap.
+ */
+#define binheap_for_each_node(pos, heap) \
+for((pos) = (heap)->root; (pos); (pos) = __binheap_preorder_next(pos))
+
+/**
+ * binheap_for_each_entry - iterate over the elements of a heap, in
+ * pre-order. The heap must not be modified during the walk.
+ * @pos:	the type * to use as a loop cursor.
+ * @heap:	the heap.
+ * @type:	the type of the struct the nodes are embedded in.
+ * @member:	the name of the binheap_node within the (type) struct.
+ */
+#define binheap_for_each_entry(pos, heap, type, member) \
+for(struct binheap_node *__binheap_pos = (heap)->root; \
+	__binheap_pos && \
+		(((pos) = binheap_entry(__binheap_pos, type, member)), 1); \
+	__binheap_pos = __binheap_preorder_next(__binheap_pos))
+
 /* Add a node to a heap */
 void __binheap_add(struct binheap_node *new_node,
 				struct binheap *handle,
 				void *data);
 
+/* Queue a node for binheap_add_batch() */
+void __binheap_append(struct binheap_node *new_node,
+				struct binheap *handle,
+				void *data);
+
+/* Thresholds of binheap_add_batch(); see sbinheap_add_batch(). */
+#define BINHEAP_BATCH_MIN	16
+#define BINHEAP_BATCH_SLACK	2
+
+/**
+ * Insert every element queued with binheap_append(), in order. Each is
+ * linked in and sifted up while that is cheap, as it is for most keys. If
+ * a window of BINHEAP_BATCH_MIN elements climbs to within
+ * BINHEAP_BATCH_SLACK levels of the root on average (e.g., a run of keys
+ * in descending order), the rest are only linked in, and then merged by
+ * heapifying their ancestors level by level: O(k + log^2 n) instead of
+ * O(k log n) for k elements.
+ */
+void binheap_add_batch(struct binheap *handle);
+
 /**
  * Removes the root node from the heap. The node is removed after coalescing
  * the binheap_node with its original data pointer at the root of the tree.
@@ -202,4 +365,94 @@ void* __binheap_delete(struct binheap_node *node_to_delete,
  */
 void __binheap_decrease(struct binheap_node *orig_node,
 				struct binheap *handle);
+
+
+/* Results of binheap_verify() and binheap_repair(). */
+#define BINHEAP_VERIFY_OK	0
+/* an element orders before its parent (e.g., a key changed in place) */
+#define BINHEAP_VERIFY_ORDER	1
+/* broken parent/child links, shape, next/last or ref/ref_ptr; fatal */
+#define BINHEAP_VERIFY_LINKS	2
+
+/**
+ * Check every invariant of the heap in one O(n) pre-order walk on the
+ * parent pointers, without recursion or a stack: heap order, a complete
+ * tree with 'next' and 'last' in place, and that each node's ref_ptr leads
+ * back to it. Nodes queued by binheap_append() are not checked.
+ * Its comparisons count in the heap's stats.
+ * Returns BINHEAP_VERIFY_LINKS if anything but order is broken, else
+ * BINHEAP_VERIFY_ORDER if order is, else BINHEAP_VERIFY_OK.
+ */
+int binheap_verify(struct binheap *handle);
+
+/**
+ * Verify, then restore heap order in O(n) (Floyd's method) if only order
+ * was broken. Returns the result of the verification, so
+ * BINHEAP_VERIFY_ORDER means the heap was repaired. A heap with broken
+ * links is left as is.
+ */
+int binheap_repair(struct binheap *handle);
+
+
+/* Changes an element's key in place; see struct binheap_rebuild. */
+typedef void (*binheap_remap_t)(void *data, void *args);
+
+/**
+ * Incremental rebuild cursor, for re-ordering a whole heap (e.g., after a
+ * global priority remap) without an O(n) latency spike.
+ *
+ * Works as sbinheap_rebuild does (see sbinheap.h): a bottom-up heapify in
+ * steps of bounded work, applying 'remap' to each element as the cursor
+ * reaches it. Nodes are visited in post-order, so every node is sifted down
+ * after its subtrees, and the unvisited nodes always contain the root.
+ * binheap_rebuild_top() is exact at every step in O(1).
+ *
+ * The heap must not be modified by other operations until the rebuild is
+ * done.
+ */
+struct binheap_rebuild {
+	struct binheap *heap;
+
+	binheap_remap_t remap;
+	void *args;
+
+	/* next node to visit in post-order, or 0 once the root was visited */
+	struct binheap_node *next;
+
+	/* node part way through its sift, or 0 */
+	struct binheap_node *sift;
+	/* levels the current sift may still take */
+	int sift_left;
+
+	/* carries the data of the best visited element, if any */
+	struct binheap_node best;
+	int have_best;
+
+	/* upper bound on the units of work left */
+	size_t remaining;
+};
+
+/* Begin an incremental rebuild of 'handle'. 'remap' may be 0. */
+void binheap_rebuild_start(struct binheap_rebuild *c, struct binheap *handle,
+				binheap_remap_t remap, void *args);
+
+/**
+ * Do at most 'budget' units of rebuild work (one node visit or one level of
+ * a sift each). Returns an upper bound on the units still left; 0 means the
+ * rebuild is done and the heap is valid.
+ */
+size_t binheap_rebuild_step(struct binheap_rebuild *c, size_t budget);
+
+/* Data pointer of the minimum element at this point of the rebuild. */
+void* binheap_rebuild_top(struct binheap_rebuild *c);
+
+/**
+ * binheap_rebuild_top_entry - get the struct of the minimum element while
+ * a rebuild is in progress.
+ * @c:		the rebuild cursor.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	unused.
+ */
+#define binheap_rebuild_top_entry(c, type, member) \
+((type *)binheap_rebuild_top(c))
 #endif
@@ -0,0 +1,207 @@
+#include "cbinheap.h"
+
+#include <sched.h>
+
+/* spins before yielding the CPU to the lock holder */
+#define CBINHEAP_SPINS 128
+
+/* Pause briefly; yield to a (possibly preempted) peer every so often. */
+static inline void __backoff(int *spins)
+{
+	if(++(*spins) == CBINHEAP_SPINS) {
+		*spins = 0;
+		sched_yield();
+	}
+	else {
+		cpu_relax();
+	}
+}
+
+static inline void __lock(int *l)
+{
+	int spins = 0;
+
+	while(__atomic_exchange_n(l, 1, __ATOMIC_ACQUIRE)) {
+		while(__atomic_load_n(l, __ATOMIC_RELAXED)) {
+			__backoff(&spins);
+		}
+	}
+}
+
+static inline void __unlock(int *l)
+{
+	__atomic_store_n(l, 0, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Slot for the i'th entry (one-based): same level as i, with the bits below
+ * the level's leading bit reversed.
+ */
+static inline long __bitrev(long i)
+{
+	int level = ilog2(i);
+	unsigned long low = (unsigned long)i;
+	unsigned long rev = 1;
+	int k;
+
+	for(k = 0; k < level; ++k) {
+		rev = (rev << 1) | (low & 1);
+		low >>= 1;
+	}
+	return (long)rev;
+}
+
+
+/* Swaps the items (data and tag) of two locked slots. */
+static inline void __cbinheap_swap(struct cbinheap_node *restrict a,
+				struct cbinheap_node *restrict b)
+{
+	swap(a->data, b->data);
+	swap(a->tag, b->tag);
+}
+
+
+int __cbinheap_add(struct cbinheap *heap, void *data)
+{
+	struct cbinheap_node *buf = heap->buf;
+	const cbinheap_order_t cmp = heap->compare;
+	long i;
+	int tag, spins = 0;
+
+	__lock(&heap->lock);
+	if(unlikely(heap->size == heap->max_size)) {
+		__unlock(&heap->lock);
+		return -1;
+	}
+	i = __bitrev(++heap->size);
+	tag = heap->next_tag;
+	heap->next_tag = (tag == __INT_MAX__) ? CBINHEAP_AVAILABLE + 1 : tag + 1;
+	__lock(&buf[i].lock);
+	__unlock(&heap->lock);
+
+	buf[i].data = data;
+	buf[i].tag = tag;
+	__unlock(&buf[i].lock);
+
+	/* bubble up, following the item if a delete moves it */
+	while(i > 1) {
+		long p = i / 2;
+		long old = i;
+
+		__lock(&buf[p].lock);
+		__lock(&buf[i].lock);
+
+		if((buf[p].tag == CBINHEAP_AVAILABLE) && (buf[i].tag == tag)) {
+			if(cmp(&buf[i], &buf[p])) {
+				__cbinheap_swap(&buf[i], &buf[p]);
+				i = p;
+			}
+			else {
+				buf[i].tag = CBINHEAP_AVAILABLE;
+				i = 0;
+			}
+		}
+		else if(buf[p].tag == CBINHEAP_EMPTY) {
+			/* our item was taken by a delete */
+			i = 0;
+		}
+		else if(buf[i].tag != tag) {
+			/* a delete moved our item up */
+			i = p;
+		}
+		else {
+			/* parent is still in flight; let its insert move on */
+			__unlock(&buf[old].lock);
+			__unlock(&buf[p].lock);
+			__backoff(&spins);
+			continue;
+		}
+
+		__unlock(&buf[old].lock);
+		__unlock(&buf[p].lock);
+	}
+
+	if(i == 1) {
+		__lock(&buf[1].lock);
+		if(buf[1].tag == tag) {
+			buf[1].tag = CBINHEAP_AVAILABLE;
+		}
+		__unlock(&buf[1].lock);
+	}
+
+	return 0;
+}
+
+
+void* __cbinheap_delete_root(struct cbinheap *heap)
+{
+	struct cbinheap_node *buf = heap->buf;
+	const cbinheap_order_t cmp = heap->compare;
+	const long limit = heap->max_size;
+	void *data, *ret;
+	long bottom, i;
+
+	__lock(&heap->lock);
+	if(heap->size == 0) {
+		__unlock(&heap->lock);
+		return 0;
+	}
+	bottom = __bitrev(heap->size--);
+	__lock(&buf[bottom].lock);
+	__unlock(&heap->lock);
+
+	/* take the bottom item */
+	data = buf[bottom].data;
+	buf[bottom].tag = CBINHEAP_EMPTY;
+	__unlock(&buf[bottom].lock);
+
+	__lock(&buf[1].lock);
+	if(buf[1].tag == CBINHEAP_EMPTY) {
+		/* the bottom item was the root */
+		__unlock(&buf[1].lock);
+		return data;
+	}
+
+	/* replace the root with the bottom item and bubble it down */
+	ret = buf[1].data;
+	buf[1].data = data;
+	buf[1].tag = CBINHEAP_AVAILABLE;
+
+	i = 1;
+	while(2*i <= limit) {
+		long l = 2*i;
+		long r = l + 1;
+		long child;
+
+		__lock(&buf[l].lock);
+		__lock(&buf[r].lock);
+
+		if(buf[l].tag == CBINHEAP_EMPTY) {
+			__unlock(&buf[r].lock);
+			__unlock(&buf[l].lock);
+			break;
+		}
+		else if((buf[r].tag == CBINHEAP_EMPTY) || cmp(&buf[l], &buf[r])) {
+			__unlock(&buf[r].lock);
+			child = l;
+		}
+		else {
+			__unlock(&buf[l].lock);
+			child = r;
+		}
+
+		if(cmp(&buf[child], &buf[i])) {
+			__cbinheap_swap(&buf[child], &buf[i]);
+			__unlock(&buf[i].lock);
+			i = child;
+		}
+		else {
+			__unlock(&buf[child].lock);
+			break;
+		}
+	}
+	__unlock(&buf[i].lock);
+
+	return ret;
+}
@@ -0,0 +1,129 @@
+#ifndef CONCURRENT_BINARY_HEAP_H
+#define CONCURRENT_BINARY_HEAP_H
+
+#include "defs.h"
+
+/**
+ * Max-size array binary heap with fine-grained locking, after Hunt et al.,
+ * "An efficient algorithm for concurrent priority queue heaps" (1996).
+ *
+ * sbinheap must be protected by one external lock around each operation.
+ * Here each slot has its own lock, and a short-lived heap lock protects only
+ * the size counter. Inserts bubble up hand-over-hand from the bottom, while
+ * deletes proceed top-down, so operations on disjoint parts of the heap
+ * overlap. Consecutive inserts are placed at bit-reversed positions within
+ * the bottom level to spread them over different subtrees.
+ *
+ * An item that is still bubbling up is tagged with its insert's id; slots
+ * holding settled items are AVAILABLE. Locks are always taken parent before
+ * child, so the two directions of traffic cannot deadlock.
+ *
+ * Only add and delete_root are supported. Arbitrary deletion and decrease
+ * need stable references to moving items, which this scheme does not track.
+ */
+
+#define CBINHEAP_EMPTY		0
+#define CBINHEAP_AVAILABLE	1
+
+struct cbinheap_node {
+	/* per-slot lock */
+	int lock;
+
+	/* CBINHEAP_EMPTY, CBINHEAP_AVAILABLE, or id of an in-flight insert */
+	int tag;
+
+	/* pointer to user data */
+	void *data;
+};
+
+/**
+ * Signature of compator function.  Assumed 'less-than' (min-heap).
+ * Pass in 'greater-than' for max-heap.
+ */
+typedef int (*cbinheap_order_t)(const struct cbinheap_node *a,
+				const struct cbinheap_node *b);
+
+struct cbinheap {
+	/* comparator function pointer */
+	cbinheap_order_t compare;
+
+	/* protects size and next_tag */
+	int lock;
+
+	/* current size of the heap */
+	long size;
+
+	/* maximum size of the heap */
+	long max_size;
+
+	/* id of the next insert */
+	int next_tag;
+
+	/* one-based; slots 0 and max_size + 1 are never filled */
+	struct cbinheap_node *buf;
+};
+
+/* Number of cbinheap_nodes to allocate for a heap of 'size' entries. */
+#define CBINHEAP_BUF_SIZE(size) ((size) + 2)
+
+#define DECLARE_CBINHEAP(name, compare, size) \
+	struct cbinheap_node __cbinheap_buf_##name[CBINHEAP_BUF_SIZE(size)]; \
+	struct cbinheap name = {compare, 0, 0, size, CBINHEAP_AVAILABLE + 1, \
+		__cbinheap_buf_##name}
+
+/**
+ * cbinheap_entry - get the struct for this heap node.
+ * @ptr:	the heap node.
+ * @type:	the type of struct pointed to by cbinheap_node::data.
+ * @member:	unused.
+ */
+#define cbinheap_entry(ptr, type, member) \
+((type *)((ptr)->data))
+
+/**
+ * cbinheap_delete_root - remove the root element from the heap.
+ * @heap:	 the heap.
+ * @type:	 the type of the struct stored in the heap.
+ * Returns 0 if the heap is empty.
+ */
+#define cbinheap_delete_root(heap, type) \
+((type *)__cbinheap_delete_root(heap))
+
+/**
+ * cbinheap_add - insert an element to the heap.
+ * @data:	 pointer to the element.
+ * @heap:	 the heap.
+ * Returns 0, or -1 if the heap is full.
+ */
+#define cbinheap_add(data, heap) \
+__cbinheap_add((heap), (data))
+
+
+static inline void INIT_CBINHEAP(struct cbinheap *heap)
+{
+	struct cbinheap_node *step;
+
+	heap->lock = 0;
+	heap->size = 0;
+	heap->next_tag = CBINHEAP_AVAILABLE + 1;
+	for(step = heap->buf;
+		step < heap->buf + CBINHEAP_BUF_SIZE(heap->max_size); ++step) {
+		step->lock = 0;
+		step->tag = CBINHEAP_EMPTY;
+		step->data = 0;
+	}
+}
+
+/* Returns true if cbinheap is empty. Only a hint while others run. */
+static inline int cbinheap_empty(struct cbinheap *heap)
+{
+	return (__atomic_load_n(&heap->size, __ATOMIC_RELAXED) == 0);
+}
+
+/* Insert data into the heap. Returns 0, or -1 if the heap is full. */
+int __cbinheap_add(struct cbinheap *heap, void *data);
+
+/* Remove and return the root's data, or 0 if the heap is empty. */
+void* __cbinheap_delete_root(struct cbinheap *heap);
+
+#endif
@@ -0,0 +1,53 @@
+#include "cpuheap.h"
+
+/* Lowest priority (largest value) at the root. */
+static int __cpuheap_lower(const struct sbinheap_node *a,
+				const struct sbinheap_node *b)
+{
+	const struct cpuheap_entry *ea = a->data;
+	const struct cpuheap_entry *eb = b->data;
+
+	return (ea->prio > eb->prio);
+}
+
+
+static uint64_t __cpuheap_key(const void *data)
+{
+	return ((const struct cpuheap_entry*)data)->prio;
+}
+
+
+void cpuheap_init(struct cpuheap *h, struct cpuheap_entry *cpus,
+				struct sbinheap_node *buf, int nr_cpus)
+{
+	int i;
+
+	h->heap.compare = __cpuheap_lower;
+	h->heap.max_size = nr_cpus;
+	h->heap.buf = buf;
+	INIT_SBINHEAP(&h->heap);
+
+	h->cpus = cpus;
+	for(i = 0; i < nr_cpus; ++i) {
+		cpus[i].cpu = i;
+		cpus[i].prio = CPUHEAP_IDLE;
+		sbinheap_add(&cpus[i].hnode, &h->heap, struct cpuheap_entry, hnode);
+	}
+
+	INIT_HEAPTOP(&h->top, __cpuheap_key);
+	sbinheap_publish_top(&h->heap, &h->top);
+}
+
+
+void cpuheap_update(struct cpuheap *h, int cpu, uint64_t prio)
+{
+	struct cpuheap_entry *e = &h->cpus[cpu];
+
+	if(e->prio == prio) {
+		return;
+	}
+
+	e->prio = prio;
+	/* also publishes the new root */
+	sbinheap_update(e->hnode, &h->heap);
+}
@@ -0,0 +1,101 @@
+#ifndef CPU_HEAP_H
+#define CPU_HEAP_H
+
+#include "defs.h"
+#include "sbinheap.h"
+#include "heaptop.h"
+
+#include <stdint.h>
+
+/**
+ * Fixed-size heap of CPUs for global schedulers, in the style of the
+ * LITMUS^RT cpu heap.
+ *
+ * A global scheduler (e.g., G-EDF) must find the CPU running the
+ * lowest-priority job whenever a job is released, to decide whether and
+ * where to preempt. cpuheap keeps exactly one entry per CPU in an sbinheap
+ * ordered so that the root is that CPU, giving the answer in O(1). When a
+ * CPU's running priority changes, its entry is updated in place in
+ * O(log m).
+ *
+ * Priorities are unsigned 64-bit values where smaller means higher
+ * priority (e.g., absolute deadlines). An idle CPU has priority
+ * CPUHEAP_IDLE, lower than any job.
+ *
+ * Updates must be serialized by the caller (e.g., the scheduler lock). The
+ * root is also published through a heaptop, so preemption checks can read
+ * the lowest CPU and its priority without taking that lock.
+ */
+
+#define CPUHEAP_IDLE	UINT64_MAX
+
+struct cpuheap_entry {
+	int cpu;
+
+	/* priority of the job running on this CPU */
+	uint64_t prio;
+
+	sbinheap_node_t hnode;
+};
+
+struct cpuheap {
+	struct sbinheap heap;
+
+	/* one entry per CPU, indexed by CPU id */
+	struct cpuheap_entry *cpus;
+
+	/* lock-free copy of the root */
+	struct heaptop top;
+};
+
+/**
+ * Initialize a heap of nr_cpus CPUs, all idle. 'cpus' and 'buf' must each
+ * hold nr_cpus entries.
+ */
+void cpuheap_init(struct cpuheap *h, struct cpuheap_entry *cpus,
+				struct sbinheap_node *buf, int nr_cpus);
+
+/* Set the priority of the job running on 'cpu'. Caller serializes updates. */
+void cpuheap_update(struct cpuheap *h, int cpu, uint64_t prio);
+
+/* CPU running the lowest-priority job. Caller serializes with updates. */
+static inline int cpuheap_lowest(const struct cpuheap *h)
+{
+	return sbinheap_top_entry(&h->heap, struct cpuheap_entry, hnode)->cpu;
+}
+
+/* Priority of the job running on 'cpu'. Caller serializes with updates. */
+static inline uint64_t cpuheap_prio(const struct cpuheap *h, int cpu)
+{
+	return h->cpus[cpu].prio;
+}
+
+/**
+ * Lock-free read of the lowest running priority. A release check can use
+ * this to skip the scheduler lock when it would not preempt anyway.
+ */
+static inline uint64_t cpuheap_read_lowest_prio(const struct cpuheap *h)
+{
+	return heaptop_read_key(&h->top);
+}
+
+/**
+ * Lock-free, consistent read of the lowest-priority CPU and its priority.
+ * A heap with no CPUs reads as cpu -1 at CPUHEAP_IDLE.
+ */
+static inline void cpuheap_read_lowest(const struct cpuheap *h,
+				int *cpu, uint64_t *prio)
+{
+	void *root;
+
+	if(unlikely(!heaptop_read(&h->top, &root, prio))) {
+		*cpu = -1;
+		*prio = CPUHEAP_IDLE;
+		return;
+	}
+
+	/* entries are never freed, so the published pointer is safe to follow */
+	*cpu = ((const struct cpuheap_entry*)root)->cpu;
+}
+
+#endif
@@ -1,16 +1,43 @@
 #ifndef _SOME_DEFS_H
 #define _SOME_DEFS_H
 
+#include <stddef.h>
+
 #define likely(x) __builtin_expect((x), 1)
 #define unlikely(x) __builtin_expect((x), 0)
 
+#ifndef cpu_relax
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+#endif
+
+#ifndef ilog2
+/* floor(log2(n)) for n > 0, independent of the width of long */
+#define ilog2(n) \
+        ((long)(8*sizeof(unsigned long long) - 1 - \
+                __builtin_clzll((unsigned long long)(n))))
+#endif
+
+#ifndef prefetch
+#define prefetch(x) __builtin_prefetch(x)
+#endif
+
+#ifndef L1_CACHE_BYTES
+#define L1_CACHE_BYTES 64
+#endif
+
 #ifndef swap
 #define swap(a, b) \
         do { typeof(a) __tmp = (a); (a) = (b); (b) = __tmp; } while (0)
 #endif
 
 #ifndef container_of
+#ifndef offsetof
 #define offsetof(TYPE, MEMBER) ((size_t) &((TYPE *)0)->MEMBER)
+#endif
 #define container_of(ptr, type, member) ({                      \
         const typeof( ((type *)0)->member ) *__mptr = (ptr);    \
         (type *)( (char *)__mptr - offsetof(type,member) );})
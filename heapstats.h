@@ -0,0 +1,71 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include "defs.h"
+
+/**
+ * Opt-in operation counters for binheap and sbinheap.
+ *
+ * Building with -DBINHEAP_STATS (make STATS=1) gives every heap instance a
+ * struct heap_stats that counts the work its operations do, so that a
+ * change in timings can be traced to more comparisons, more swaps or longer
+ * pointer walks. Without the flag, heaps carry no counters and the counting
+ * macros expand to nothing.
+ *
+ * The flag changes the layout of struct binheap and struct sbinheap, so the
+ * library and all of its users must be built with the same setting.
+ *
+ * Counters are plain, non-atomic increments and have a single writer: the
+ * thread currently allowed to modify the heap. Operations that split one
+ * heap across threads (sbinheap_build_parallel()) count into per-thread
+ * copies and merge them with heap_stats_merge() after joining. Reading the
+ * counters while another thread operates on the heap gives torn values.
+ */
+
+struct heap_stats {
+	/* comparator calls */
+	unsigned long compares;
+
+	/* data swaps between two nodes (binheap) or slots (sbinheap) */
+	unsigned long swaps;
+
+	/* writes of an owner's reference to the node holding its data */
+	unsigned long ref_updates;
+
+	/* levels moved by sift-up and sift-down */
+	unsigned long levels;
+
+	/* binheap: node swaps to coalesce a node with its data on delete */
+	unsigned long coalesces;
+
+	/* binheap: nodes walked to find the new 'next' or 'last' node */
+	unsigned long path_steps;
+};
+
+/* Add the counters of 'from' to 'sum'. */
+static inline void __heap_stats_add(struct heap_stats *sum,
+				const struct heap_stats *from)
+{
+	sum->compares += from->compares;
+	sum->swaps += from->swaps;
+	sum->ref_updates += from->ref_updates;
+	sum->levels += from->levels;
+	sum->coalesces += from->coalesces;
+	sum->path_steps += from->path_steps;
+}
+
+#ifdef BINHEAP_STATS
+#define HEAP_STATS_ENABLED 1
+#define heap_stat_add(heap, field, n) ((void)((heap)->stats.field += (n)))
+/* Fold the counters of heap 'from' into those of 'heap'. */
+#define heap_stats_merge(heap, from) \
+	__heap_stats_add(&(heap)->stats, &(from)->stats)
+#else
+#define HEAP_STATS_ENABLED 0
+#define heap_stat_add(heap, field, n) ((void)0)
+#define heap_stats_merge(heap, from) ((void)0)
+#endif
+
+#define heap_stat_inc(heap, field) heap_stat_add(heap, field, 1)
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef HEAP_TOP_H
+#define HEAP_TOP_H
+
+#include "defs.h"
+
+#include <stdint.h>
+
+/**
+ * Lock-free published top of a heap.
+ *
+ * A heap's owner serializes its mutations, usually with a lock that readers
+ * would also have to take just to peek at the minimum. A binheap or sbinheap
+ * may instead opt in to publishing its root into a heaptop after every
+ * mutating operation (see binheap_publish_top() and sbinheap_publish_top()).
+ * The root's data pointer and a 64-bit key extracted from it by key_fn are
+ * written under a sequence counter, so any thread can read a consistent
+ * pair without the heap's lock.
+ *
+ * The published data pointer identifies the root; it does not keep it
+ * alive. A reader must not dereference it unless the caller otherwise
+ * guarantees the object outlives the read. The key is a copy and is always
+ * safe to use.
+ */
+
+#define HEAPTOP_EMPTY_KEY	UINT64_MAX
+
+/* Extracts the ordering key from an element's data pointer. */
+typedef uint64_t (*heaptop_key_t)(const void *data);
+
+struct heaptop {
+	/* odd while an update is underway */
+	unsigned int seq;
+
+	/* root's data pointer, or 0 if the heap is empty */
+	void *data;
+
+	/* key_fn(data), or HEAPTOP_EMPTY_KEY if the heap is empty */
+	uint64_t key;
+
+	heaptop_key_t key_fn;
+};
+
+static inline void INIT_HEAPTOP(struct heaptop *top, heaptop_key_t key_fn)
+{
+	top->seq = 0;
+	top->data = 0;
+	top->key = HEAPTOP_EMPTY_KEY;
+	top->key_fn = key_fn;
+}
+
+/* Publish a new root (0 if empty). Writers must be serialized. */
+static inline void heaptop_publish(struct heaptop *top, void *data)
+{
+	uint64_t key = data ? top->key_fn(data) : HEAPTOP_EMPTY_KEY;
+
+	/* most operations leave the root alone; spare readers a retry */
+	if((data == top->data) && (key == top->key)) {
+		return;
+	}
+
+	__atomic_store_n(&top->seq, top->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&top->data, data, __ATOMIC_RELAXED);
+	__atomic_store_n(&top->key, key, __ATOMIC_RELAXED);
+	__atomic_store_n(&top->seq, top->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Consistent, lock-free read of the published root. Returns 0 if the heap
+ * was empty, otherwise stores its data pointer and key and returns 1.
+ */
+static inline int heaptop_read(const struct heaptop *top,
+				void **data, uint64_t *key)
+{
+	unsigned int seq;
+	void *d;
+	uint64_t k;
+
+	do {
+		while((seq = __atomic_load_n(&top->seq, __ATOMIC_ACQUIRE)) & 1) {
+			cpu_relax();
+		}
+		d = __atomic_load_n(&top->data, __ATOMIC_RELAXED);
+		k = __atomic_load_n(&top->key, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&top->seq, __ATOMIC_RELAXED) != seq);
+
+	if(data) {
+		*data = d;
+	}
+	if(key) {
+		*key = k;
+	}
+
+	return (d != 0);
+}
+
+/**
+ * Lock-free read of the root's key alone; a single atomic load.
+ * HEAPTOP_EMPTY_KEY if the heap was empty.
+ */
+static inline uint64_t heaptop_read_key(const struct heaptop *top)
+{
+	return __atomic_load_n(&top->key, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "lazyheap.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Sort by order, then by node so that repeats of a node are adjacent. */
+static int __by_order(const void *a, const void *b)
+{
+	const struct lazyheap_dirty *x = a;
+	const struct lazyheap_dirty *y = b;
+
+	if(x->order != y->order) {
+		return (x->order > y->order) - (x->order < y->order);
+	}
+	return ((uintptr_t)x->node > (uintptr_t)y->node) -
+		((uintptr_t)x->node < (uintptr_t)y->node);
+}
+
+/* Sort the dirty buffer and drop repeated nodes. Returns the new count. */
+static size_t __sort_unique(struct lazyheap_dirty *dirty, size_t nr)
+{
+	size_t i, out = 0;
+
+	if(nr > 16) {
+		qsort(dirty, nr, sizeof(*dirty), __by_order);
+	}
+	else {
+		/* insertion sort; flushes are usually small */
+		for(i = 1; i < nr; ++i) {
+			struct lazyheap_dirty d = dirty[i];
+			size_t j = i;
+
+			while(j && (__by_order(&dirty[j - 1], &d) > 0)) {
+				dirty[j] = dirty[j - 1];
+				--j;
+			}
+			dirty[j] = d;
+		}
+	}
+
+	for(i = 0; i < nr; ++i) {
+		if(!out || (dirty[out - 1].node != dirty[i].node)) {
+			dirty[out++] = dirty[i];
+		}
+	}
+	return out;
+}
+
+/* Is a full O(n) heapify cheaper than sifting every dirty node? */
+static inline int __heapify_cheaper(size_t nr_dirty, size_t size)
+{
+	return size && (nr_dirty * (ilog2(size) + 1) > size);
+}
+
+
+void lazy_binheap_flush(struct lazy_binheap *q)
+{
+	size_t i, nr;
+
+	if(!q->nr_dirty && !q->overflow) {
+		return;
+	}
+
+	if(!q->overflow) {
+		/* shallowest first; a node's depth is its distance to the root */
+		for(i = 0; i < q->nr_dirty; ++i) {
+			const struct binheap_node *n =
+				((struct binheap_node*)q->dirty[i].node)->ref;
+			long depth = 0;
+
+			while(n->parent) {
+				n = n->parent;
+				++depth;
+			}
+			q->dirty[i].order = depth;
+		}
+		nr = __sort_unique(q->dirty, q->nr_dirty);
+	}
+
+	if(q->overflow || __heapify_cheaper(nr, q->size)) {
+		struct binheap_rebuild c;
+
+		binheap_rebuild_start(&c, &q->heap, 0, 0);
+		(void)binheap_rebuild_step(&c, (size_t)-1);
+	}
+	else {
+		for(i = 0; i < nr; ++i) {
+			__binheap_decrease(q->dirty[i].node, &q->heap);
+		}
+	}
+
+	q->nr_dirty = 0;
+	q->overflow = 0;
+	memset(q->filter, 0, sizeof(q->filter));
+}
+
+
+void lazy_sbinheap_flush(struct lazy_sbinheap *q)
+{
+	size_t i, nr;
+
+	if(!q->nr_dirty && !q->overflow) {
+		return;
+	}
+
+	if(!q->overflow) {
+		/* index order is depth order */
+		for(i = 0; i < q->nr_dirty; ++i) {
+			q->dirty[i].order = (*(sbinheap_node_t*)q->dirty[i].node)->idx;
+		}
+		nr = __sort_unique(q->dirty, q->nr_dirty);
+	}
+
+	if(q->overflow || __heapify_cheaper(nr, q->heap.size)) {
+		sbinheap_build(&q->heap);
+	}
+	else {
+		for(i = 0; i < nr; ++i) {
+			__sbinheap_decrease(*(sbinheap_node_t*)q->dirty[i].node, &q->heap);
+		}
+	}
+
+	q->nr_dirty = 0;
+	q->overflow = 0;
+	memset(q->filter, 0, sizeof(q->filter));
+}
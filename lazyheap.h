@@ -0,0 +1,200 @@
+#ifndef LAZY_HEAP_H
+#define LAZY_HEAP_H
+
+#include "defs.h"
+#include "binheap.h"
+#include "sbinheap.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Deferred decrease-key for binheap and sbinheap.
+ *
+ * Workloads like Dijkstra's algorithm often decrease the same keys several
+ * times before anyone looks at the top, and every __binheap_decrease()
+ * sifts right away, often along the same paths. Here a decrease only
+ * records the node in a caller-provided dirty buffer. The buffer is flushed
+ * by the next top/delete_root/delete: dirty nodes are sorted by depth and
+ * bubbled up shallowest first, or, if that would cost more than an O(n)
+ * heapify (k*log2(n) > n) or the buffer overflowed, the whole heap is
+ * re-heapified.
+ *
+ * Adds need no flush: a decreased node can only be too small for its
+ * ancestors, and bubbling up a new node never breaks the order anywhere
+ * else. Only decreases are supported, as with the underlying heaps.
+ *
+ * Use the lazy_* operations below rather than those of the embedded heap;
+ * plain top/delete_root/delete see a heap that may be out of order.
+ */
+
+/* Slots in the filter that drops repeated marks of recently marked nodes. */
+#define LAZYHEAP_FILTER	32
+
+struct lazyheap_dirty {
+	/* binheap: the node passed to decrease; sbinheap: the user's handle */
+	void *node;
+
+	/* depth or index at flush time; flush sorts on it */
+	long order;
+};
+
+struct lazy_binheap {
+	struct binheap heap;
+
+	/* binheap does not track its size; needed for the heapify threshold */
+	size_t size;
+
+	struct lazyheap_dirty *dirty;
+	size_t nr_dirty;
+	size_t max_dirty;
+
+	/* a decrease did not fit in 'dirty'; flush must re-heapify */
+	int overflow;
+
+	/* nodes marked since the last flush, hashed by address */
+	void *filter[LAZYHEAP_FILTER];
+};
+
+struct lazy_sbinheap {
+	struct sbinheap heap;
+
+	struct lazyheap_dirty *dirty;
+	size_t nr_dirty;
+	size_t max_dirty;
+	int overflow;
+	void *filter[LAZYHEAP_FILTER];
+};
+
+
+/**
+ * Record a dirty node. A direct-mapped filter catches most repeats of a
+ * node before they take buffer space; flush drops any that slip through.
+ */
+static inline void __lazyheap_mark(struct lazyheap_dirty *dirty, size_t *nr,
+				size_t max, int *overflow, void **filter, void *node)
+{
+	void **slot = &filter[((uintptr_t)node >> 4) % LAZYHEAP_FILTER];
+
+	if(*slot == node) {
+		return;
+	}
+	*slot = node;
+
+	if(*nr < max) {
+		dirty[(*nr)++].node = node;
+	}
+	else {
+		*overflow = 1;
+	}
+}
+
+/* Restore heap order after deferred decreases. */
+void lazy_binheap_flush(struct lazy_binheap *q);
+void lazy_sbinheap_flush(struct lazy_sbinheap *q);
+
+
+/**
+ * lazy_binheap_add - insert an element to the heap. Does not flush.
+ * @new_node:	node to add.
+ * @q:		the lazy heap.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	the name of the binheap_node within the (type) struct.
+ */
+#define lazy_binheap_add(new_node, q, type, member) \
+((q)->size++, binheap_add((new_node), &(q)->heap, type, member))
+
+/**
+ * lazy_binheap_decrease - mark a node whose value has decreased. The heap
+ * is fixed up at the next flush.
+ * @orig_node:	node the data pointer was added with.
+ * @q:		the lazy heap.
+ */
+#define lazy_binheap_decrease(orig_node, q) \
+__lazyheap_mark((q)->dirty, &(q)->nr_dirty, (q)->max_dirty, &(q)->overflow, \
+	(q)->filter, (orig_node))
+
+/* lazy_binheap_top_entry - flush, then get the struct at the top. */
+#define lazy_binheap_top_entry(q, type, member) \
+(lazy_binheap_flush(q), binheap_top_entry(&(q)->heap, type, member))
+
+/* lazy_binheap_delete_root - flush, then remove the root. */
+#define lazy_binheap_delete_root(q, type, member) \
+(lazy_binheap_flush(q), (q)->size--, \
+	binheap_delete_root(&(q)->heap, type, member))
+
+/* lazy_binheap_delete - flush, then remove an arbitrary element. */
+#define lazy_binheap_delete(to_delete, q) \
+(lazy_binheap_flush(q), (q)->size--, binheap_delete((to_delete), &(q)->heap))
+
+/**
+ * lazy_sbinheap_add - insert an element to the heap. Does not flush.
+ * @new_node:	the element's sbinheap_node_t handle.
+ * @q:		the lazy heap.
+ * @type:	the type of the struct the handle is embedded in.
+ * @member:	the name of the handle within the (type) struct.
+ */
+#define lazy_sbinheap_add(new_node, q, type, member) \
+sbinheap_add((new_node), &(q)->heap, type, member)
+
+/**
+ * lazy_sbinheap_decrease - mark a node whose value has decreased. The heap
+ * is fixed up at the next flush.
+ * @handle:	pointer to the element's sbinheap_node_t handle.
+ * @q:		the lazy heap.
+ */
+#define lazy_sbinheap_decrease(handle, q) \
+__lazyheap_mark((q)->dirty, &(q)->nr_dirty, (q)->max_dirty, &(q)->overflow, \
+	(q)->filter, (handle))
+
+/* lazy_sbinheap_top_entry - flush, then get the struct at the top. */
+#define lazy_sbinheap_top_entry(q, type, member) \
+(lazy_sbinheap_flush(q), sbinheap_top_entry(&(q)->heap, type, member))
+
+/* lazy_sbinheap_delete_root - flush, then remove the root. */
+#define lazy_sbinheap_delete_root(q, type, member) \
+(lazy_sbinheap_flush(q), sbinheap_delete_root(&(q)->heap, type, member))
+
+/* lazy_sbinheap_delete - flush, then remove an arbitrary element. */
+#define lazy_sbinheap_delete(to_delete, q) \
+(lazy_sbinheap_flush(q), sbinheap_delete((to_delete), &(q)->heap))
+
+
+/* 'dirty' holds max_dirty entries. */
+static inline void INIT_LAZY_BINHEAP(struct lazy_binheap *q,
+				binheap_order_t compare,
+				struct lazyheap_dirty *dirty, size_t max_dirty)
+{
+	INIT_BINHEAP(&q->heap, compare);
+	q->size = 0;
+	q->dirty = dirty;
+	q->nr_dirty = 0;
+	q->max_dirty = max_dirty;
+	q->overflow = 0;
+	memset(q->filter, 0, sizeof(q->filter));
+}
+
+/* Initialize after the heap has been set up, e.g. by DECLARE_SBINHEAP. */
+static inline void INIT_LAZY_SBINHEAP(struct lazy_sbinheap *q,
+				struct lazyheap_dirty *dirty, size_t max_dirty)
+{
+	INIT_SBINHEAP(&q->heap);
+	q->dirty = dirty;
+	q->nr_dirty = 0;
+	q->max_dirty = max_dirty;
+	q->overflow = 0;
+	memset(q->filter, 0, sizeof(q->filter));
+}
+
+/* Returns true if the heap is empty. */
+static inline int lazy_binheap_empty(struct lazy_binheap *q)
+{
+	return binheap_empty(&q->heap);
+}
+
+static inline int lazy_sbinheap_empty(struct lazy_sbinheap *q)
+{
+	return sbinheap_empty(&q->heap);
+}
+
+#endif
@@ -6,12 +6,15 @@
 #include <stdint.h>
 
 #include <unistd.h>
+#include <string.h>
 
 #include "time.h"
 
 #include "binheap.h"
 #include "sbinheap.h"
 
+#include "bench.h"
+
 const int RANGE = 10000;
 
 struct Data
@@ -36,7 +39,8 @@ void func(struct binheap_node* node, void* args)
 	printf("%d\n", d->val);
 }
 
-float test_binheap(int numTrials, int flip, int size, unsigned int seed)
+float test_binheap(int numTrials, int flip, int size, unsigned int seed,
+                   struct heap_stats* stats)
 {
 	if(size <= 0)
 		return 0;
@@ -91,6 +95,8 @@ float test_binheap(int numTrials, int flip, int size, unsigned int seed)
 		heapData[t] = elapsed;
 	}
 
+	(void)binheap_stats(&heap, stats);
+
 	float sum_h = 0;
 	for(t = 0; t < numTrials; ++t)
 	{
@@ -114,7 +120,8 @@ void sfunc(sbinheap_node_t node, void* args)
 	printf("%d\n", d->val);
 }
 
-float test_sbinheap(int numTrials, int flip, int size, unsigned int seed)
+float test_sbinheap(int numTrials, int flip, int size, unsigned int seed,
+                    struct heap_stats* stats)
 {
 	if(size <= 0)
 		return 0;
@@ -169,6 +176,8 @@ float test_sbinheap(int numTrials, int flip, int size, unsigned int seed)
 		heapData[t] = elapsed;
 	}
 
+	(void)sbinheap_stats(&heap, stats);
+
 	float sum_h = 0;
 	for(t = 0; t < numTrials; ++t)
 	{
@@ -178,6 +187,19 @@ float test_sbinheap(int numTrials, int flip, int size, unsigned int seed)
 }
 
 
+/* Operation counters per trial; only in BINHEAP_STATS builds. */
+void print_stats(const char* name, const struct heap_stats* s, int numTrials)
+{
+	if(!HEAP_STATS_ENABLED || numTrials <= 0)
+		return;
+
+	printf("%s counters per trial: compares %lu, swaps %lu, ref_updates %lu, "
+		"levels %lu, coalesces %lu, path_steps %lu\n\n", name,
+		s->compares / numTrials, s->swaps / numTrials,
+		s->ref_updates / numTrials, s->levels / numTrials,
+		s->coalesces / numTrials, s->path_steps / numTrials);
+}
+
 void usage(const char* msg)
 {
 	if(msg)
@@ -185,40 +207,258 @@ void usage(const char* msg)
 		fprintf(stderr, "Error: %s\n", msg);
 	}
 
-	fprintf(stderr, "usage: heaptest num_trials num_deletes heap_size\n");
+	fprintf(stderr,
+		"usage: heaptest [-m mode] [-p threads] [-c] [-s seed] [suite options]\n"
+		"                num_trials num_deletes heap_size\n"
+		"modes:\n"
+		"  suite       workloads over every heap variant (default); num_trials is\n"
+		"              the number of seeds and num_deletes the operations per run\n"
+		"  classic     binheap and sbinheap fill/flip/drain test\n"
+		"  twheel      timing wheel expiry and cancel check; num_deletes is\n"
+		"              the number of timers armed, heap_size the timer pool\n"
+		"  spill       spillheap checked against a reference heap; heap_size\n"
+		"              is the array size\n"
+		"  shared      process-shared heap recovery: 2*num_trials children are\n"
+		"              killed while holding the lock; num_deletes is the number\n"
+		"              of operations per lock hold\n"
+		"  snapshot    sbinheap_save/load round trip, corrupt file and a heap\n"
+		"              too small (num_deletes is ignored)\n"
+		"  cbinheap    concurrent heap stress test and thread scaling\n"
+		"  multiqueue  relaxed sharded queue rank error and thread scaling\n"
+		"  mpsc        producer insert latency, lock-free front-end vs. mutex\n"
+		"  cpuheap     global-EDF simulation; num_deletes is the number of jobs\n"
+		"              and heap_size the number of CPUs\n"
+		"  build       sbinheap bulk load: incremental vs. serial/parallel build\n"
+		"              (num_deletes is ignored)\n"
+		"  batch       batched insert: add vs. append + add_batch; num_deletes\n"
+		"              is the batch size\n"
+		"  timerq      connection idle timeouts: timerfd reprogrammed lazily vs.\n"
+		"              after every change; heap_size is the number of connections\n"
+		"  verify      verify and repair passes; num_deletes keys are changed in\n"
+		"              place before the repair\n"
+		"  heaptop     reader peeks at a published top vs. under the writer's lock\n"
+		"  rebuild     incremental rebuild after a priority remap; num_deletes is\n"
+		"              the work budget per step\n"
+		"  lazy        Dijkstra with eager vs. deferred decrease-key; num_deletes\n"
+		"              is the out-degree and heap_size the number of vertices\n"
+		"  iterate     for_each callbacks vs. for_each_entry macros; num_deletes\n"
+		"              is the number of walks\n"
+		"  prefetch    sift-down cost by prefetch distance, at 1024 entries and\n"
+		"              at heap_size\n"
+		"  latency     per-operation latency percentiles and maximum; with -c,\n"
+		"              the heap is flushed from the caches before each operation\n"
+		"              (costs O(heap_size) per operation; keep sizes small)\n"
+		"  contention  mixed operations from 1..threads threads: mutex, spinlock\n"
+		"              and per-thread heaps with merging; throughput and latency\n"
+		"In the multi-threaded modes, num_deletes is the total operation count.\n"
+		"suite options:\n"
+		"  -w list     workloads to run: hold,edf,timer,dijkstra,topk (default all)\n"
+		"  -H list     heaps to run: binheap,sbinheap,pairheap,seqheap and the\n"
+		"              baselines array,rbtree,binomial (default all); seqheap\n"
+		"              runs only hold and topk\n"
+		"  -z list     heap sizes to sweep (default heap_size)\n"
+		"  -f format   csv (default) or json\n"
+		"  -e          add hardware counters per operation (cycles, instructions,\n"
+		"              branch, L1D, LLC and dTLB misses), where perf events allow\n");
 
 	exit(-1);
 }
 
 int main(int argc, char** argv)
 {
+	const char* mode = "suite";
+	int numThreads = 1;
+	int opt;
+
+	struct SuiteOptions suite = {0, 0, 0, 0, 0, 0};
+	int sizes[32];
+	const char* sizeList = 0;
+	const char* seedArg = 0;
+	int cold = 0;
+
 	if(argc == 1)
 	{
 		usage(0);
 	}
-	else if(argc != 4)
+
+	while((opt = getopt(argc, argv, "m:p:cs:w:H:z:f:e")) != -1)
+	{
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg;
+				break;
+			case 'p':
+				numThreads = atoi(optarg);
+				break;
+			case 'c':
+				cold = 1;
+				break;
+			case 's':
+				seedArg = optarg;
+				break;
+			case 'w':
+				suite.workloads = optarg;
+				break;
+			case 'H':
+				suite.heaps = optarg;
+				break;
+			case 'z':
+				sizeList = optarg;
+				break;
+			case 'e':
+				suite.perf = 1;
+				break;
+			case 'f':
+				if(strcmp(optarg, "json") == 0)
+					suite.json = 1;
+				else if(strcmp(optarg, "csv") != 0)
+					usage("Unknown output format.");
+				break;
+			default:
+				usage("Invalid options.");
+		}
+	}
+
+	if(argc - optind != 3 || numThreads <= 0)
 	{
 		usage("Invalid options.");
 	}
 
-	int numTrials = atoi(argv[1]);
-	int flip = atoi(argv[2]);
-	int size = atoi(argv[3]);
+	int numTrials = atoi(argv[optind]);
+	int flip = atoi(argv[optind + 1]);
+	int size = atoi(argv[optind + 2]);
 	unsigned int seed;
 	float avgTrialTime;
+	struct heap_stats stats = {0};
 	struct timespec t;
 
-	clk_gettime(CLK_REALTIME, &t);
-	seed = (unsigned int)t.tv_nsec;
+	if(seedArg)
+	{
+		seed = (unsigned int)strtoul(seedArg, 0, 0);
+	}
+	else
+	{
+		clk_gettime(CLK_REALTIME, &t);
+		seed = (unsigned int)t.tv_nsec;
+	}
+
+	if(strcmp(mode, "suite") == 0)
+	{
+		/* keep stdout machine-readable; seeds are in every row */
+		suite.sizes = sizes;
+		if(sizeList)
+		{
+			char* end;
+
+			for(const char* p = sizeList; *p; p = end + (*end == ','))
+			{
+				if(suite.numSizes == (int)(sizeof(sizes) / sizeof(sizes[0])))
+					usage("Too many sizes.");
+				sizes[suite.numSizes++] = (int)strtol(p, &end, 10);
+				if(end == p || (*end != ',' && *end != '\0'))
+					usage("Invalid size list.");
+			}
+		}
+		else
+		{
+			sizes[suite.numSizes++] = size;
+		}
+		return bench_suite(numTrials, flip, &suite, seed) ? 1 : 0;
+	}
+
 	printf("seed: %u\n\n", seed);
 
+	if(strcmp(mode, "twheel") == 0)
+	{
+		return bench_twheel(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "spill") == 0)
+	{
+		return bench_spill(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "shared") == 0)
+	{
+		return bench_shared(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "snapshot") == 0)
+	{
+		return bench_snapshot(numTrials, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "cbinheap") == 0)
+	{
+		return bench_cbinheap(numTrials, flip, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "multiqueue") == 0)
+	{
+		return bench_multiqueue(numTrials, flip, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "mpsc") == 0)
+	{
+		return bench_mpsc(numTrials, flip, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "cpuheap") == 0)
+	{
+		return bench_cpuheap(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "build") == 0)
+	{
+		return bench_build(numTrials, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "batch") == 0)
+	{
+		return bench_batch(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "timerq") == 0)
+	{
+		return bench_timerq(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "verify") == 0)
+	{
+		return bench_verify(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "heaptop") == 0)
+	{
+		return bench_heaptop(numTrials, flip, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "rebuild") == 0)
+	{
+		return bench_rebuild(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "lazy") == 0)
+	{
+		return bench_lazy(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "iterate") == 0)
+	{
+		return bench_iter(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "prefetch") == 0)
+	{
+		return bench_prefetch(numTrials, flip, size, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "contention") == 0)
+	{
+		return bench_contend(numTrials, flip, size, numThreads, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "latency") == 0)
+	{
+		return bench_latency(numTrials, flip, size, cold, seed) ? 1 : 0;
+	}
+	else if(strcmp(mode, "classic") != 0)
+	{
+		usage("Unknown mode.");
+	}
+
 	printf("starting binheap test...\n"); fflush(0);
-	avgTrialTime = test_binheap(numTrials, flip, size, seed);
-	printf("binheap time (microseconds): %f\n\n", avgTrialTime); fflush(0);
+	avgTrialTime = test_binheap(numTrials, flip, size, seed, &stats);
+	printf("binheap time (microseconds): %f\n\n", avgTrialTime);
+	print_stats("binheap", &stats, numTrials); fflush(0);
 
 	printf("starting sbinheap test...\n"); fflush(0);
-	avgTrialTime = test_sbinheap(numTrials, flip, size, seed);
-	printf("sbinheap time (microseconds): %f\n\n", avgTrialTime); fflush(0);
+	avgTrialTime = test_sbinheap(numTrials, flip, size, seed, &stats);
+	printf("sbinheap time (microseconds): %f\n\n", avgTrialTime);
+	print_stats("sbinheap", &stats, numTrials); fflush(0);
 
 	return(0);
 }
@@ -0,0 +1,90 @@
+#include "mpscheap.h"
+
+struct mpsc_link* __mpsc_take_all(struct mpsc_link **head,
+				struct mpsc_link **tail)
+{
+	struct mpsc_link *list, *fifo = 0;
+
+	if(!__atomic_load_n(head, __ATOMIC_RELAXED)) {
+		return 0;
+	}
+
+	list = __atomic_exchange_n(head, 0, __ATOMIC_ACQUIRE);
+
+	/* the newest link ends up last */
+	if(tail) {
+		*tail = list;
+	}
+
+	/* reverse into push order */
+	while(list) {
+		struct mpsc_link *next = list->next;
+
+		list->next = fifo;
+		fifo = list;
+		list = next;
+	}
+
+	return fifo;
+}
+
+
+int mpsc_binheap_drain(struct mpsc_binheap *q)
+{
+	struct mpsc_link *link = __mpsc_take_all(&q->pending, 0);
+	int count = 0;
+
+	while(link) {
+		/* read 'next' first: once in the heap the link may be re-pushed */
+		struct mpsc_link *next = link->next;
+
+		__binheap_append(link->bnode, &q->heap, link->data);
+		link = next;
+		++count;
+	}
+
+	if(count) {
+		binheap_add_batch(&q->heap);
+	}
+
+	return count;
+}
+
+
+int mpsc_sbinheap_drain(struct mpsc_sbinheap *q)
+{
+	struct mpsc_link *fresh_tail = 0;
+	struct mpsc_link *fresh = __mpsc_take_all(&q->pending, &fresh_tail);
+	struct mpsc_link *link;
+	idx_t first = q->heap.size;
+	int count = 0;
+
+	/* older deferred links go first */
+	if(fresh) {
+		if(q->deferred) {
+			q->deferred_tail->next = fresh;
+		}
+		else {
+			q->deferred = fresh;
+		}
+		q->deferred_tail = fresh_tail;
+	}
+	link = q->deferred;
+
+	while(link && (q->heap.size < q->heap.max_size)) {
+		struct mpsc_link *next = link->next;
+
+		__sbinheap_append(&q->heap, link->data, link->snode);
+		link = next;
+		++count;
+	}
+
+	/* what is left is a suffix, so the tail still holds */
+	q->deferred = link;
+	if(!link) {
+		q->deferred_tail = 0;
+	}
+	sbinheap_add_batch(&q->heap, first);
+
+	return count;
+}
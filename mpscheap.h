@@ -0,0 +1,177 @@
+#ifndef MPSC_HEAP_H
+#define MPSC_HEAP_H
+
+#include "defs.h"
+#include "binheap.h"
+#include "sbinheap.h"
+
+/**
+ * Lock-free multi-producer, single-consumer insertion front-end for
+ * binheap and sbinheap.
+ *
+ * A heap owned by one consumer thread would otherwise need a lock that
+ * every producer takes for a full __binheap_add(). Here producers instead
+ * push a caller-owned mpsc_link onto a lock-free list in O(1). The owner
+ * drains the list at its next top/delete_root and inserts the drained batch
+ * into the heap with one binheap_add_batch()/sbinheap_add_batch(), in the
+ * order the links were pushed.
+ *
+ * Only the owner may touch 'heap' (and call drain, top, delete_root,
+ * delete or decrease). A link may be pushed again once its entry has left
+ * the heap.
+ */
+
+/* Producer-side link, embedded in the caller's struct next to its heap node. */
+struct mpsc_link {
+	struct mpsc_link *next;
+
+	/* data to insert */
+	void *data;
+
+	/* heap node (binheap) or node handle (sbinheap) to insert with */
+	union {
+		struct binheap_node *bnode;
+		sbinheap_node_t *snode;
+	};
+};
+
+struct mpsc_binheap {
+	struct binheap heap;
+
+	/* links pushed by producers, newest first */
+	struct mpsc_link *pending;
+};
+
+struct mpsc_sbinheap {
+	struct sbinheap heap;
+
+	/* links pushed by producers, newest first */
+	struct mpsc_link *pending;
+
+	/* drained links that did not fit in the heap, oldest first */
+	struct mpsc_link *deferred;
+	struct mpsc_link *deferred_tail;
+};
+
+
+/* Push a link. Lock-free and O(1); safe from any thread. */
+static inline void __mpsc_push(struct mpsc_link **head, struct mpsc_link *link)
+{
+	struct mpsc_link *old = __atomic_load_n(head, __ATOMIC_RELAXED);
+
+	do {
+		link->next = old;
+	} while(!__atomic_compare_exchange_n(head, &old, link, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * Take every pushed link, returned oldest first. Owner only. If 'tail' is
+ * not 0, it is set to the newest link.
+ */
+struct mpsc_link* __mpsc_take_all(struct mpsc_link **head,
+				struct mpsc_link **tail);
+
+
+/**
+ * mpsc_binheap_add - push an element for insertion (any thread).
+ * @link:	the element's mpsc_link.
+ * @new_node:	the element's binheap_node.
+ * @q:		the front-end.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	the name of the binheap_node within the (type) struct.
+ */
+#define mpsc_binheap_add(link, new_node, q, type, member) \
+__mpsc_binheap_push((link), (new_node), (q), \
+	container_of((new_node), type, member))
+
+/**
+ * mpsc_binheap_top_entry - drain, then get the struct at the top of the heap.
+ * Owner only.
+ */
+#define mpsc_binheap_top_entry(q, type, member) \
+(mpsc_binheap_drain(q), binheap_top_entry(&(q)->heap, type, member))
+
+/* mpsc_binheap_delete_root - drain, then remove the root. Owner only. */
+#define mpsc_binheap_delete_root(q, type, member) \
+(mpsc_binheap_drain(q), binheap_delete_root(&(q)->heap, type, member))
+
+/**
+ * mpsc_sbinheap_add - push an element for insertion (any thread).
+ * @link:	the element's mpsc_link.
+ * @new_node:	the element's sbinheap_node_t handle.
+ * @q:		the front-end.
+ * @type:	the type of the struct the handle is embedded in.
+ * @member:	the name of the handle within the (type) struct.
+ */
+#define mpsc_sbinheap_add(link, new_node, q, type, member) \
+__mpsc_sbinheap_push((link), (new_node), (q), \
+	container_of((new_node), type, member))
+
+/* mpsc_sbinheap_top_entry - drain, then get the struct at the top. Owner only. */
+#define mpsc_sbinheap_top_entry(q, type, member) \
+(mpsc_sbinheap_drain(q), sbinheap_top_entry(&(q)->heap, type, member))
+
+/* mpsc_sbinheap_delete_root - drain, then remove the root. Owner only. */
+#define mpsc_sbinheap_delete_root(q, type, member) \
+(mpsc_sbinheap_drain(q), sbinheap_delete_root(&(q)->heap, type, member))
+
+
+static inline void INIT_MPSC_BINHEAP(struct mpsc_binheap *q,
+				binheap_order_t compare)
+{
+	INIT_BINHEAP(&q->heap, compare);
+	q->pending = 0;
+}
+
+/* Initialize after the heap has been set up, e.g. by DECLARE_SBINHEAP. */
+static inline void INIT_MPSC_SBINHEAP(struct mpsc_sbinheap *q)
+{
+	INIT_SBINHEAP(&q->heap);
+	q->pending = 0;
+	q->deferred = 0;
+	q->deferred_tail = 0;
+}
+
+static inline void __mpsc_binheap_push(struct mpsc_link *link,
+				struct binheap_node *new_node,
+				struct mpsc_binheap *q, void *data)
+{
+	link->data = data;
+	link->bnode = new_node;
+	__mpsc_push(&q->pending, link);
+}
+
+static inline void __mpsc_sbinheap_push(struct mpsc_link *link,
+				sbinheap_node_t *new_node,
+				struct mpsc_sbinheap *q, void *data)
+{
+	link->data = data;
+	link->snode = new_node;
+	__mpsc_push(&q->pending, link);
+}
+
+/* Returns true if nothing is queued or pending. Owner only. */
+static inline int mpsc_binheap_empty(struct mpsc_binheap *q)
+{
+	return binheap_empty(&q->heap) &&
+		!__atomic_load_n(&q->pending, __ATOMIC_RELAXED);
+}
+
+static inline int mpsc_sbinheap_empty(struct mpsc_sbinheap *q)
+{
+	return sbinheap_empty(&q->heap) && !q->deferred &&
+		!__atomic_load_n(&q->pending, __ATOMIC_RELAXED);
+}
+
+/* Insert all pushed elements into the heap. Returns the number inserted. */
+int mpsc_binheap_drain(struct mpsc_binheap *q);
+
+/**
+ * Insert pushed elements into the heap while it has room. Elements that do
+ * not fit stay deferred, ahead of newer pushes, until a later drain.
+ * Returns the number inserted.
+ */
+int mpsc_sbinheap_drain(struct mpsc_sbinheap *q);
+
+#endif
@@ -0,0 +1,187 @@
+#include "multiqueue.h"
+
+/* Heap order: smallest key first. */
+static int __multiqueue_less(const struct sbinheap_node *a,
+				const struct sbinheap_node *b)
+{
+	const struct multiqueue_node *na = a->data;
+	const struct multiqueue_node *nb = b->data;
+
+	return (na->key < nb->key);
+}
+
+
+/* xorshift32 */
+static inline uint32_t __rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static inline struct multiqueue_shard* __pick(struct multiqueue *mq,
+				uint32_t *rng)
+{
+	return &mq->shards[__rand(rng) % mq->nr_shards];
+}
+
+static inline int __trylock(struct multiqueue_shard *s)
+{
+	return (__atomic_load_n(&s->lock, __ATOMIC_RELAXED) == 0) &&
+		!__atomic_exchange_n(&s->lock, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void __unlock(struct multiqueue_shard *s)
+{
+	__atomic_store_n(&s->lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t __top_key(const struct multiqueue_shard *s)
+{
+	return __atomic_load_n(&s->top_key, __ATOMIC_RELAXED);
+}
+
+static inline idx_t __nr(const struct multiqueue_shard *s)
+{
+	return __atomic_load_n(&s->nr, __ATOMIC_RELAXED);
+}
+
+/*
+ * Refresh the cached top key and size. Called with the shard locked.
+ * Emptiness is judged by the size alone: MULTIQUEUE_EMPTY_KEY is also a
+ * valid key.
+ */
+static inline void __publish(struct multiqueue_shard *s)
+{
+	uint64_t key = MULTIQUEUE_EMPTY_KEY;
+
+	if(!sbinheap_empty(&s->heap)) {
+		key = ((const struct multiqueue_node*)s->heap.buf->data)->key;
+	}
+	__atomic_store_n(&s->top_key, key, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->nr, s->heap.size, __ATOMIC_RELAXED);
+}
+
+
+void multiqueue_init(struct multiqueue *mq,
+				struct multiqueue_shard *shards, unsigned int nr_shards,
+				struct sbinheap_node *buf, idx_t shard_size)
+{
+	unsigned int i;
+
+	mq->nr_shards = nr_shards;
+	mq->shards = shards;
+
+	for(i = 0; i < nr_shards; ++i) {
+		struct multiqueue_shard *s = &shards[i];
+
+		s->lock = 0;
+		s->top_key = MULTIQUEUE_EMPTY_KEY;
+		s->nr = 0;
+		s->heap.compare = __multiqueue_less;
+		s->heap.size = 0;
+		s->heap.max_size = shard_size;
+		s->heap.buf = buf + (size_t)i * shard_size;
+		INIT_SBINHEAP(&s->heap);
+	}
+}
+
+
+int multiqueue_add(struct multiqueue_node *node, struct multiqueue *mq,
+				uint64_t key, uint32_t *rng)
+{
+	unsigned int tries = 0;
+
+	node->key = key;
+
+	/* lock contention and full shards both just mean: try another */
+	while(tries++ < 4 * mq->nr_shards) {
+		struct multiqueue_shard *s = __pick(mq, rng);
+
+		if(!__trylock(s)) {
+			--tries;
+			cpu_relax();
+			continue;
+		}
+
+		if(s->heap.size < s->heap.max_size) {
+			__sbinheap_add(&s->heap, node, &node->hnode);
+			if(key < s->top_key) {
+				__atomic_store_n(&s->top_key, key, __ATOMIC_RELAXED);
+			}
+			__atomic_store_n(&s->nr, s->heap.size, __ATOMIC_RELAXED);
+			__unlock(s);
+			return 0;
+		}
+		__unlock(s);
+	}
+
+	return -1;
+}
+
+
+struct multiqueue_node* multiqueue_delete_min(struct multiqueue *mq,
+				uint32_t *rng)
+{
+	unsigned int misses = 0;
+
+	for(;;) {
+		struct multiqueue_shard *a = __pick(mq, rng);
+		struct multiqueue_shard *b = __pick(mq, rng);
+		struct multiqueue_shard *s;
+		struct multiqueue_node *node;
+
+		if(!__nr(a)) {
+			s = b;
+		} else if(!__nr(b)) {
+			s = a;
+		} else {
+			s = (__top_key(b) < __top_key(a)) ? b : a;
+		}
+
+		if(!__nr(s)) {
+			/* sampled only empty shards; give up once all look empty */
+			if(++misses >= mq->nr_shards) {
+				if(multiqueue_empty(mq)) {
+					return 0;
+				}
+				misses = 0;
+			}
+			continue;
+		}
+
+		if(!__trylock(s)) {
+			cpu_relax();
+			continue;
+		}
+		if(sbinheap_empty(&s->heap)) {
+			/* emptied since we sampled it */
+			__unlock(s);
+			continue;
+		}
+
+		node = sbinheap_top_entry(&s->heap, struct multiqueue_node, hnode);
+		(void)sbinheap_delete_root(&s->heap, struct multiqueue_node, hnode);
+		__publish(s);
+		__unlock(s);
+
+		return node;
+	}
+}
+
+
+int multiqueue_empty(const struct multiqueue *mq)
+{
+	unsigned int i;
+
+	for(i = 0; i < mq->nr_shards; ++i) {
+		if(__nr(&mq->shards[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,95 @@
+#ifndef MULTIQUEUE_H
+#define MULTIQUEUE_H
+
+#include "defs.h"
+#include "sbinheap.h"
+
+#include <stdint.h>
+
+/**
+ * Relaxed concurrent priority queue built from sharded sbinheaps, after
+ * Rihani, Sanders and Dementiev, "MultiQueues: Simple Relaxed Concurrent
+ * Priority Queues" (2015).
+ *
+ * A strict global order needs a global lock. A MultiQueue instead keeps
+ * c*P independent sbinheaps (P threads, small c), each with its own
+ * lightweight lock. An insert goes to a random shard. A delete-min samples
+ * two shards, compares their cached top keys without locking, and pops the
+ * better one. The result is only approximately the minimum: the expected
+ * rank error is O(c*P), independent of the queue size.
+ *
+ * Entries are ordered by an unsigned 64-bit key (min-heap) held in a
+ * multiqueue_node embedded in the caller's struct. Shard buffers are
+ * provided by the caller; no dynamic memory is allocated.
+ */
+
+/* top_key of an empty shard; any key, this one included, may be queued */
+#define MULTIQUEUE_EMPTY_KEY	UINT64_MAX
+
+struct multiqueue_node {
+	uint64_t key;
+
+	/* handle while the node is in a shard */
+	sbinheap_node_t hnode;
+};
+
+struct multiqueue_shard {
+	int lock;
+
+	/* key of the shard's root; read without the lock */
+	uint64_t top_key;
+
+	/* entries in the shard; read without the lock */
+	idx_t nr;
+
+	struct sbinheap heap;
+} __attribute__((aligned(64)));
+
+struct multiqueue {
+	unsigned int nr_shards;
+	struct multiqueue_shard *shards;
+};
+
+/**
+ * multiqueue_entry - get the struct that contains this node.
+ * @ptr:	the multiqueue_node.
+ * @type:	the type of struct the node is embedded in.
+ * @member:	the name of the multiqueue_node within the (type) struct.
+ */
+#define multiqueue_entry(ptr, type, member) \
+container_of((ptr), type, member)
+
+
+static inline void INIT_MULTIQUEUE_NODE(struct multiqueue_node *n)
+{
+	n->key = 0;
+	INIT_SBINHEAP_NODE(&n->hnode);
+}
+
+/**
+ * Initialize a MultiQueue of nr_shards shards. 'buf' must hold
+ * nr_shards * shard_size sbinheap_nodes.
+ */
+void multiqueue_init(struct multiqueue *mq,
+				struct multiqueue_shard *shards, unsigned int nr_shards,
+				struct sbinheap_node *buf, idx_t shard_size);
+
+/**
+ * Insert a node with the given key into a random shard. 'rng' is the
+ * calling thread's private random state (any non-zero seed).
+ * Returns 0, or -1 if no shard with free space was found.
+ */
+int multiqueue_add(struct multiqueue_node *node, struct multiqueue *mq,
+				uint64_t key, uint32_t *rng);
+
+/**
+ * Remove an approximately minimal node: the better top of two randomly
+ * sampled shards. Returns 0 if every shard appears empty.
+ */
+struct multiqueue_node* multiqueue_delete_min(struct multiqueue *mq,
+				uint32_t *rng);
+
+/* Returns true if every shard appears empty. Only a hint while others run. */
+int multiqueue_empty(const struct multiqueue *mq);
+
+#endif
@@ -0,0 +1,176 @@
+#include "pairheap.h"
+
+/**
+ * Link two trees (either may be empty): the root that orders later becomes
+ * the first child of the other. Returns the new root, whose 'prev' and
+ * 'next' the caller must set.
+ */
+static struct pairheap_node* __pairheap_link(struct pairheap *heap,
+				struct pairheap_node *a,
+				struct pairheap_node *b)
+{
+	if(!a) {
+		return b;
+	}
+	if(!b) {
+		return a;
+	}
+
+	if(heap->compare(b, a)) {
+		swap(a, b);
+	}
+
+	b->prev = a;
+	b->next = a->child;
+	if(a->child) {
+		a->child->prev = b;
+	}
+	a->child = b;
+
+	return a;
+}
+
+
+static inline void __pairheap_set_root(struct pairheap *heap,
+				struct pairheap_node *root)
+{
+	heap->root = root;
+	if(root) {
+		root->prev = 0;
+		root->next = 0;
+	}
+}
+
+
+/**
+ * Combine a list of sibling trees into one: link them in pairs left to
+ * right, then link the pairs right to left. The pairs are kept on a stack
+ * threaded through 'next', so no recursion is needed.
+ */
+static struct pairheap_node* __pairheap_combine(struct pairheap *heap,
+				struct pairheap_node *first)
+{
+	struct pairheap_node *pairs = 0;
+	struct pairheap_node *result;
+
+	while(first) {
+		struct pairheap_node *a = first;
+		struct pairheap_node *b = a->next;
+		struct pairheap_node *m;
+
+		if(!b) {
+			a->next = pairs;
+			pairs = a;
+			break;
+		}
+
+		first = b->next;
+		m = __pairheap_link(heap, a, b);
+		m->next = pairs;
+		pairs = m;
+	}
+
+	if(!pairs) {
+		return 0;
+	}
+
+	/* the stack pops the rightmost pair first */
+	result = pairs;
+	pairs = pairs->next;
+	while(pairs) {
+		struct pairheap_node *next = pairs->next;
+
+		result = __pairheap_link(heap, pairs, result);
+		pairs = next;
+	}
+
+	return result;
+}
+
+
+/* Detach a node other than the root, with its subtree, from its parent. */
+static void __pairheap_cut(struct pairheap_node *node)
+{
+	struct pairheap_node *prev = node->prev;
+
+	if(prev->child == node) {
+		prev->child = node->next;
+	}
+	else {
+		prev->next = node->next;
+	}
+	if(node->next) {
+		node->next->prev = prev;
+	}
+
+	node->prev = 0;
+	node->next = 0;
+}
+
+
+void __pairheap_add(struct pairheap_node *new_node,
+				struct pairheap *heap,
+				void *data)
+{
+	new_node->data = data;
+	new_node->child = 0;
+	new_node->next = 0;
+	new_node->prev = 0;
+
+	__pairheap_set_root(heap, __pairheap_link(heap, heap->root, new_node));
+}
+
+
+void* __pairheap_delete_root(struct pairheap *heap)
+{
+	struct pairheap_node *root = heap->root;
+
+	__pairheap_set_root(heap, __pairheap_combine(heap, root->child));
+
+	/* mark as removed */
+	root->child = 0;
+	root->prev = PAIRHEAP_POISON;
+
+	return root->data;
+}
+
+
+void* __pairheap_delete(struct pairheap_node *node,
+				struct pairheap *heap)
+{
+	struct pairheap_node *rest;
+
+	if(node == heap->root) {
+		return __pairheap_delete_root(heap);
+	}
+
+	__pairheap_cut(node);
+	rest = __pairheap_combine(heap, node->child);
+	__pairheap_set_root(heap, __pairheap_link(heap, heap->root, rest));
+
+	/* mark as removed */
+	node->child = 0;
+	node->prev = PAIRHEAP_POISON;
+
+	return node->data;
+}
+
+
+void __pairheap_decrease(struct pairheap_node *node,
+				struct pairheap *heap)
+{
+	if(node == heap->root) {
+		return;
+	}
+
+	/* the subtree stays ordered; only its link to the parent may not be */
+	__pairheap_cut(node);
+	__pairheap_set_root(heap, __pairheap_link(heap, heap->root, node));
+}
+
+
+void pairheap_meld(struct pairheap *dst, struct pairheap *src)
+{
+	__pairheap_set_root(dst, __pairheap_link(dst, dst->root, src->root));
+	src->root = 0;
+}
@@ -0,0 +1,159 @@
+#ifndef PAIRING_HEAP_H
+#define PAIRING_HEAP_H
+
+#include "defs.h"
+
+/**
+ * Pairing heap with add, arbitrary delete, delete_root, decrease, top and
+ * meld operations.
+ *
+ * The API follows binheap: the caller embeds a pairheap_node in its struct
+ * and the heap never allocates memory. Insert and meld are O(1), delete_root
+ * is O(log n) amortized, and decrease-key is o(log n) amortized (O(1) in
+ * practice), which suits schedulers that merge queues and adjust
+ * priorities often. Unlike binheap, data never moves between nodes, so a
+ * node always holds the data it was added with.
+ *
+ * delete_root combines the root's children with the standard two-pass
+ * pairing (left to right in pairs, then right to left), iteratively, so
+ * deep heaps do not use stack.
+ */
+
+struct pairheap_node {
+	void	*data;
+
+	/* first child */
+	struct pairheap_node *child;
+
+	/* next sibling */
+	struct pairheap_node *next;
+
+	/* previous sibling, or the parent of a first child; 0 for the root */
+	struct pairheap_node *prev;
+};
+
+typedef struct pairheap_node pairheap_node_t;
+
+/* Initialized heap nodes not in a heap have prev set to PAIRHEAP_POISON. */
+#define PAIRHEAP_POISON	((void*)(0xdeadbeef))
+
+#define PAIRHEAP_NODE_INIT() {0, 0, 0, PAIRHEAP_POISON}
+
+#define PAIRHEAP_NODE(name) \
+struct pairheap_node name = PAIRHEAP_NODE_INIT()
+
+/**
+ * Signature of compator function.  Assumed 'less-than' (min-heap).
+ * Pass in 'greater-than' for max-heap.
+ */
+typedef int (*pairheap_order_t)(const struct pairheap_node *a,
+				const struct pairheap_node *b);
+
+struct pairheap {
+	struct pairheap_node *root;
+
+	/* comparator function pointer */
+	pairheap_order_t compare;
+};
+
+
+/**
+ * pairheap_entry - get the struct for this heap node.
+ * @ptr:	the heap node.
+ * @type:	the type of struct pointed to by pairheap_node::data.
+ * @member:	unused.
+ */
+#define pairheap_entry(ptr, type, member) \
+((type *)((ptr)->data))
+
+/**
+ * pairheap_top_entry - get the struct for the node at the top of the heap.
+ * @ptr:	the heap.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	the name of the pairheap_node within the (type) struct.
+ */
+#define pairheap_top_entry(ptr, type, member) \
+pairheap_entry((ptr)->root, type, member)
+
+/**
+ * pairheap_delete_root - remove the root element from the heap.
+ * @heap:	the heap.
+ * @type (ignored):   the type of the struct the node is embedded in.
+ * @member (ignored): the name of the pairheap_node within the (type) struct.
+ * Ignored fields remain for API compatibility with binheap_delete_root().
+ */
+#define pairheap_delete_root(heap, type, member) \
+__pairheap_delete_root(heap)
+
+/**
+ * pairheap_delete - remove an arbitrary element from the heap.
+ * @to_delete:	pointer to node to be removed.
+ * @heap:	the heap.
+ */
+#define pairheap_delete(to_delete, heap) \
+__pairheap_delete((to_delete), (heap))
+
+/**
+ * pairheap_add - insert an element to the heap
+ * new_node: node to add.
+ * @heap:	the heap.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	the name of the pairheap_node within the (type) struct.
+ */
+#define pairheap_add(new_node, heap, type, member) \
+__pairheap_add((new_node), (heap), container_of((new_node), type, member))
+
+/**
+ * pairheap_decrease - re-eval the position of a node whose value has
+ * decreased.
+ * @orig_node:	node that was added with the data whose value has changed.
+ * @heap:	the heap.
+ */
+#define pairheap_decrease(orig_node, heap) \
+__pairheap_decrease((orig_node), (heap))
+
+
+static inline void INIT_PAIRHEAP_NODE(struct pairheap_node *n)
+{
+	static const struct pairheap_node init_node = PAIRHEAP_NODE_INIT();
+	*n = init_node;
+}
+
+static inline void INIT_PAIRHEAP(struct pairheap *heap,
+				pairheap_order_t compare)
+{
+	heap->root = 0;
+	heap->compare = compare;
+}
+
+/* Returns true if pairheap is empty. */
+static inline int pairheap_empty(struct pairheap *heap)
+{
+	return(heap->root == 0);
+}
+
+/* Returns true if pairheap node is in a heap. */
+static inline int pairheap_is_in_heap(const struct pairheap_node *node)
+{
+	return (node->prev != PAIRHEAP_POISON);
+}
+
+void __pairheap_add(struct pairheap_node *new_node,
+				struct pairheap *heap,
+				void *data);
+
+void* __pairheap_delete_root(struct pairheap *heap);
+
+void* __pairheap_delete(struct pairheap_node *node,
+				struct pairheap *heap);
+
+void __pairheap_decrease(struct pairheap_node *node,
+				struct pairheap *heap);
+
+/**
+ * Move every element of 'src' into 'dst' in O(1). Both heaps must use the
+ * same ordering; 'src' is left empty.
+ */
+void pairheap_meld(struct pairheap *dst, struct pairheap *src);
+
+#endif
@@ -1,9 +1,17 @@
 #include "sbinheap.h"
 
+/* Call the comparator 'cmp' of 'heap', counting the call in its stats. */
+#define __sbinheap_cmp(heap, cmp, a, b) \
+	(heap_stat_inc((heap), compares), (cmp)((a), (b)))
+
 /* Swaps data between two nodes and track references */
-static inline void __sbinheap_swap(struct sbinheap_node *restrict a,
+static inline void __sbinheap_swap(struct sbinheap *heap,
+				struct sbinheap_node *restrict a,
 				struct sbinheap_node *restrict b)
 {
+	heap_stat_inc(heap, swaps);
+	heap_stat_add(heap, ref_updates, 2);
+
 	*(a->ref_ptr) = b;
 	*(b->ref_ptr) = a;
 	swap(a->ref_ptr, b->ref_ptr);
@@ -45,58 +53,97 @@ static inline struct sbinheap_node* last(const struct sbinheap *h)
 }
 
 
-static void __sbinheap_for_each(struct sbinheap *heap,
-				struct sbinheap_node *n,
-				sbinheap_for_each_t fn, void* args)
-{
-	/* Apply fn to all nodes. Beware of recursion. */
-
-	/* pre-order */
-	fn(n, args);
-
-	if(left(n, heap->size))
-		__sbinheap_for_each(heap, left(n, heap->size), fn, args);
-	if(right(n, heap->size))
-		__sbinheap_for_each(heap, right(n, heap->size), fn, args);
-}
-
-
 /* Apply fn to each node. */
 void sbinheap_for_each(struct sbinheap *heap,
 				sbinheap_for_each_t fn, void* args)
 {
-	if (!sbinheap_empty(heap))
-		__sbinheap_for_each(heap, heap->buf, fn, args);
+	struct sbinheap_node *node;
+
+	sbinheap_for_each_node(node, heap) {
+		fn(node, args);
+	}
 }
 
 
-/* bubble node up towards root */
-static void __sbinheap_bubble_up(struct sbinheap *heap,
+/* bubble node up towards root. Returns the number of levels moved. */
+static int __sbinheap_bubble_up(struct sbinheap *heap,
 				struct sbinheap_node *node)
 {
 	const struct sbinheap_node* root = heap->buf;
 	const sbinheap_order_t cmp = heap->compare;
+	int levels = 0;
 
 	/* let SBINHEAP_POISON data bubble to the top */
 	while((node != root) &&
-		  ((node->data == SBINHEAP_POISON) || cmp(node, parent(node)))) {
-		__sbinheap_swap(parent(node), node);
+		  ((node->data == SBINHEAP_POISON) ||
+		   __sbinheap_cmp(heap, cmp, node, parent(node)))) {
+		__sbinheap_swap(heap, parent(node), node);
 		node = parent(node);
+		++levels;
+		heap_stat_inc(heap, levels);
+	}
+
+	return levels;
+}
+
+
+/**
+ * Prefetch for a sift-down at 'node': the slots heap->prefetch levels below
+ * it, which are contiguous, and the data of the level above those, whose
+ * slots were prefetched one step earlier.
+ */
+static inline void __sbinheap_prefetch(const struct sbinheap *heap,
+				const struct sbinheap_node *node)
+{
+	const int d = heap->prefetch;
+	const idx_t limit = heap->size;
+	idx_t first, end, i;
+
+	first = ((node->idx + 1) << d) - 1;
+	if(first < limit) {
+		const char *p = (const char*)(heap->buf + first);
+		const char *last;
+
+		end = first + ((idx_t)1 << d);
+		if(end > limit) {
+			end = limit;
+		}
+		last = (const char*)(heap->buf + end) - 1;
+		for(; p <= last; p += L1_CACHE_BYTES) {
+			prefetch(p);
+		}
+		prefetch(last);
+	}
+
+	first = ((node->idx + 1) << (d - 1)) - 1;
+	end = first + ((idx_t)1 << (d - 1));
+	if(end > limit) {
+		end = limit;
+	}
+	for(i = first; (d > 1) && (i < end); ++i) {
+		/* compared against, and its handle is rewritten on a swap */
+		prefetch(heap->buf[i].data);
+		__builtin_prefetch(heap->buf[i].ref_ptr, 1);
 	}
 }
 
 
 /* bubble node down, swapping with min-child */
-static void __sbinheap_bubble_down(struct sbinheap *heap)
+static void __sbinheap_bubble_down(struct sbinheap *heap,
+				struct sbinheap_node *node)
 {
 	const sbinheap_order_t cmp = heap->compare;
 	const idx_t limit = heap->size;
-	struct sbinheap_node *node = heap->buf;
 
 	while(left(node, limit) != 0) {
-		if(right(node, limit) && cmp(right(node, limit), left(node, limit))) {
-			if(cmp(right(node, limit), node)) {
-				__sbinheap_swap(node, right(node, limit));
+		if(heap->prefetch) {
+			__sbinheap_prefetch(heap, node);
+		}
+
+		if(right(node, limit) &&
+				__sbinheap_cmp(heap, cmp, right(node, limit), left(node, limit))) {
+			if(__sbinheap_cmp(heap, cmp, right(node, limit), node)) {
+				__sbinheap_swap(heap, node, right(node, limit));
 				node = right(node, limit);
 			}
 			else {
@@ -104,14 +151,15 @@ static void __sbinheap_bubble_down(struct sbinheap *heap)
 			}
 		}
 		else {
-			if(cmp(left(node, limit), node)) {
-				__sbinheap_swap(node, left(node, limit));
+			if(__sbinheap_cmp(heap, cmp, left(node, limit), node)) {
+				__sbinheap_swap(heap, node, left(node, limit));
 				node = left(node, limit);
 			}
 			else {
 				break;
 			}
 		}
+		heap_stat_inc(heap, levels);
 	}
 }
 
@@ -147,21 +195,25 @@ void* __sbinheap_delete_root(struct sbinheap *heap)
 		/* move last node up to root */
 		heap->buf->ref_ptr = l->ref_ptr;
 		*(heap->buf->ref_ptr) = heap->buf;
+		heap_stat_add(heap, ref_updates, 2);
 		heap->buf->data = l->data;
 
 		/* free the node and shrink the heap */
 		l->idx = SBINHEAP_BADIDX;
 		heap->size--;
 
-		__sbinheap_bubble_down(heap);
+		__sbinheap_bubble_down(heap, heap->buf);
 	}
 	else {
 		/* free the node and shrink the heap */
 		*(l->ref_ptr) = SBINHEAP_NODE_INIT();
+		heap_stat_inc(heap, ref_updates);
 		l->idx = SBINHEAP_BADIDX;
 		heap->size--;
 	}
 
+	__sbinheap_publish(heap);
+
 	return data;
 }
 
@@ -191,4 +243,318 @@ void __sbinheap_decrease(struct sbinheap_node *node,
 				struct sbinheap *heap)
 {
 	__sbinheap_bubble_up(heap, node);
+	__sbinheap_publish(heap);
+}
+
+
+/**
+ * Re-eval the position of a node whose value has changed in either
+ * direction.
+ */
+void __sbinheap_update(struct sbinheap_node *node,
+				struct sbinheap *heap)
+{
+	if((node != heap->buf) &&
+			__sbinheap_cmp(heap, heap->compare, node, parent(node))) {
+		__sbinheap_bubble_up(heap, node);
+	}
+	else {
+		__sbinheap_bubble_down(heap, node);
+	}
+	__sbinheap_publish(heap);
+}
+
+
+/**
+ * Heapify the subtree rooted at 'root' one level at a time, deepest first.
+ * Level k of the subtree is the contiguous index range starting at
+ * (root+1)*2^k - 1 of width 2^k, so each level is a linear sweep.
+ */
+void __sbinheap_heapify_subtree(struct sbinheap *heap, idx_t root)
+{
+	const idx_t limit = heap->size;
+	/* nodes with index >= first_leaf have no children */
+	const idx_t first_leaf = limit / 2;
+	idx_t width = 1;
+	idx_t start = root;
+	int levels = 0;
+
+	if(root >= first_leaf) {
+		return;
+	}
+
+	/* find the deepest level of the subtree that has an internal node */
+	while(2*start + 1 < first_leaf) {
+		start = 2*start + 1;
+		width *= 2;
+		++levels;
+	}
+
+	for(; levels >= 0; --levels) {
+		idx_t end = start + width;
+		idx_t i;
+
+		if(end > first_leaf) {
+			end = first_leaf;
+		}
+		for(i = end - 1; i >= start; --i) {
+			__sbinheap_bubble_down(heap, heap->buf + i);
+		}
+
+		start = (start - 1) / 2;
+		width /= 2;
+	}
+}
+
+
+void __sbinheap_heapify_top(struct sbinheap *heap, idx_t end)
+{
+	idx_t i;
+
+	for(i = end - 1; i >= 0; --i) {
+		__sbinheap_bubble_down(heap, heap->buf + i);
+	}
+}
+
+
+void sbinheap_build(struct sbinheap *heap)
+{
+	/* nodes [size/2, size) are leaves */
+	__sbinheap_heapify_top(heap, heap->size/2);
+	__sbinheap_publish(heap);
+}
+
+
+/**
+ * Heapify the nodes [first, size) and all of their ancestors, bottom-up.
+ * The ancestors at each level form a contiguous index range, so this is
+ * Floyd's method restricted to one range per level: O(k + log^2 n) for k
+ * new nodes, and a linear sweep at every level.
+ */
+static void __sbinheap_heapify_ancestors(struct sbinheap *heap, idx_t first)
+{
+	/* nodes with index >= first_leaf have no children */
+	const idx_t first_leaf = heap->size / 2;
+	idx_t lo = first;
+	idx_t hi = heap->size - 1;
+
+	for(;;) {
+		idx_t i = (hi < first_leaf) ? hi : first_leaf - 1;
+		idx_t next_hi;
+
+		for(; i >= lo; --i) {
+			__sbinheap_bubble_down(heap, heap->buf + i);
+		}
+
+		if(lo == 0) {
+			break;
+		}
+
+		/* parents of [lo, hi], excluding any already done */
+		next_hi = (hi - 1) / 2;
+		if(next_hi >= lo) {
+			next_hi = lo - 1;
+		}
+		lo = (lo - 1) / 2;
+		hi = next_hi;
+	}
+}
+
+
+void sbinheap_add_batch(struct sbinheap *heap, idx_t first)
+{
+	/* depth of the last node; a key that reaches the root climbs about this far */
+	const long depth = (heap->size > 1) ? ilog2(heap->size) : 0;
+	long levels = 0;
+	idx_t i;
+
+	/*
+	 * Sift-up moves most new keys a few levels and then beats any
+	 * heapify. Only if a whole window of new keys climbs to near the
+	 * root (e.g., a run in descending order) is the rest of the batch
+	 * merged by heapifying its ancestors.
+	 */
+	for(i = first; i < heap->size; ++i) {
+		if(((i - first) % SBINHEAP_BATCH_MIN) == 0) {
+			if((levels > (depth - SBINHEAP_BATCH_SLACK) * SBINHEAP_BATCH_MIN) &&
+			   (heap->size - i >= SBINHEAP_BATCH_MIN)) {
+				__sbinheap_heapify_ancestors(heap, i);
+				break;
+			}
+			levels = 0;
+		}
+		if(i + SBINHEAP_BATCH_MIN < heap->size) {
+			/* a large batch has evicted the new keys since they were appended */
+			prefetch(heap->buf[i + SBINHEAP_BATCH_MIN].data);
+		}
+		levels += __sbinheap_bubble_up(heap, heap->buf + i);
+	}
+
+	__sbinheap_publish(heap);
+}
+
+
+/* Height of node 'i' in a complete tree of 'size' nodes. */
+static idx_t __sbinheap_height(idx_t i, idx_t size)
+{
+	idx_t h = 0;
+
+	while(2*i + 1 < size) {
+		i = 2*i + 1;
+		++h;
+	}
+	return h;
+}
+
+
+void sbinheap_rebuild_start(struct sbinheap_rebuild *c, struct sbinheap *heap,
+				sbinheap_remap_t remap, void *args)
+{
+	size_t n = heap->size;
+
+	c->heap = heap;
+	c->remap = remap;
+	c->args = args;
+	c->next = heap->size;
+	c->sift = 0;
+	c->sift_left = 0;
+	c->have_best = 0;
+
+	/* one visit per node plus the sum of node heights, n - popcount(n) */
+	c->remaining = 2*n - __builtin_popcountl(n);
+}
+
+
+size_t sbinheap_rebuild_step(struct sbinheap_rebuild *c, size_t budget)
+{
+	struct sbinheap *heap = c->heap;
+	const sbinheap_order_t cmp = heap->compare;
+	const idx_t limit = heap->size;
+
+	while(budget && c->remaining) {
+		struct sbinheap_node *node = c->sift;
+
+		if(!node) {
+			/* visit the next node */
+			idx_t i = --c->next;
+
+			node = heap->buf + i;
+			if(c->remap) {
+				c->remap(node->data, c->args);
+			}
+			if(!c->have_best || __sbinheap_cmp(heap, cmp, node, &c->best)) {
+				c->best.data = node->data;
+				c->have_best = 1;
+			}
+
+			c->sift = node;
+			c->sift_left = __sbinheap_height(i, limit);
+			--c->remaining;
+			--budget;
+		}
+		else {
+			/* one level of sift-down */
+			struct sbinheap_node *child = left(node, limit);
+			struct sbinheap_node *r = right(node, limit);
+
+			if(!child) {
+				/* reached a leaf of a shallower right subtree */
+				c->remaining -= c->sift_left;
+				c->sift = 0;
+				c->sift_left = 0;
+				continue;
+			}
+			if(r && __sbinheap_cmp(heap, cmp, r, child)) {
+				child = r;
+			}
+
+			--c->sift_left;
+			--c->remaining;
+			--budget;
+
+			if(__sbinheap_cmp(heap, cmp, child, node)) {
+				__sbinheap_swap(heap, node, child);
+				c->sift = child;
+				heap_stat_inc(heap, levels);
+			}
+			else {
+				/* stopped early; the skipped levels will not be needed */
+				c->remaining -= c->sift_left;
+				c->sift_left = 0;
+			}
+		}
+
+		if(!c->sift_left) {
+			c->sift = 0;
+		}
+	}
+
+	if(!c->remaining) {
+		__sbinheap_publish(heap);
+	}
+
+	return c->remaining;
+}
+
+
+void* sbinheap_rebuild_top(struct sbinheap_rebuild *c)
+{
+	struct sbinheap *heap = c->heap;
+
+	if(sbinheap_empty(heap)) {
+		return 0;
+	}
+	if(!c->remaining) {
+		return heap->buf->data;
+	}
+
+	/* the unvisited nodes are a heap rooted at 0 under their old keys */
+	if(c->next > 0) {
+		if(c->have_best &&
+				__sbinheap_cmp(heap, heap->compare, &c->best, heap->buf)) {
+			return c->best.data;
+		}
+		return heap->buf->data;
+	}
+
+	return c->best.data;
+}
+
+
+int sbinheap_verify(struct sbinheap *heap)
+{
+	const sbinheap_order_t cmp = heap->compare;
+	struct sbinheap_node *buf = heap->buf;
+	int result = SBINHEAP_VERIFY_OK;
+	idx_t i;
+
+	if((heap->size < 0) || (heap->size > heap->max_size)) {
+		return SBINHEAP_VERIFY_LINKS;
+	}
+
+	/* parents are read at half the rate of nodes, so both stream */
+	for(i = 0; i < heap->size; ++i) {
+		struct sbinheap_node *n = buf + i;
+
+		if((n->idx != i) || !n->ref_ptr || (*(n->ref_ptr) != n)) {
+			return SBINHEAP_VERIFY_LINKS;
+		}
+		if((i > 0) && __sbinheap_cmp(heap, cmp, n, buf + (i - 1) / 2)) {
+			result = SBINHEAP_VERIFY_ORDER;
+		}
+	}
+
+	return result;
+}
+
+
+int sbinheap_repair(struct sbinheap *heap)
+{
+	int result = sbinheap_verify(heap);
+
+	if(result == SBINHEAP_VERIFY_ORDER) {
+		sbinheap_build(heap);
+	}
+
+	return result;
 }
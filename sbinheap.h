@@ -2,6 +2,8 @@
 #define STATIC_BINARY_HEAP_H
 
 #include "defs.h"
+#include "heaptop.h"
+#include "heapstats.h"
 
 #include <stdlib.h>
 
@@ -70,8 +72,21 @@ struct sbinheap {
 
 	/* pointer to the allocated heap */
 	struct sbinheap_node* buf;
+
+	/* if set, the root is published here after each mutation */
+	struct heaptop *pub;
+
+	/* levels ahead to prefetch during sift-down; 0 disables */
+	int prefetch;
+
+#ifdef BINHEAP_STATS
+	struct heap_stats stats;
+#endif
 };
 
+/* Largest useful prefetch distance; each level doubles the prefetches. */
+#define SBINHEAP_PREFETCH_MAX 4
+
 #define DECLARE_SBINHEAP(name, compare, size) \
 	struct sbinheap_node __sbinheap_buf_##name[size]; \
 	struct sbinheap name = {compare, 0, size, __sbinheap_buf_##name}
@@ -129,6 +144,20 @@ __sbinheap_delete(*(to_delete), (heap))
 #define sbinheap_add(new_node, heap, type, member) \
 __sbinheap_add((heap), container_of((new_node), type, member), (new_node))
 
+/**
+ * sbinheap_append - place an element at the end of the heap without
+ * restoring the heap property. Use to bulk load a heap, then call
+ * sbinheap_build() (or sbinheap_build_parallel()) before any other
+ * operation. To add a batch to a non-empty heap, call sbinheap_add_batch()
+ * instead.
+ * new_node: node to add.
+ * @heap:	 heap to the heap.
+ * @type:	the type of the struct the head is embedded in.
+ * @member:	 the name of the binheap_struct within the (type) struct.
+ */
+#define sbinheap_append(new_node, heap, type, member) \
+__sbinheap_append((heap), container_of((new_node), type, member), (new_node))
+
 /**
  * binheap_decrease - re-eval the position of a node (based upon its
  * original data pointer).
@@ -140,16 +169,77 @@ __sbinheap_add((heap), container_of((new_node), type, member), (new_node))
 #define sbinheap_decrease(orig_node, heap) \
 __sbinheap_decrease((orig_node), (heap))
 
+/**
+ * sbinheap_update - re-eval the position of a node whose value has
+ * increased or decreased.
+ * @heap: heap to the heap.
+ * @orig_node: node that was associated with the data pointer
+ *			 (whose value has changed) when said pointer was
+ *			 added to the heap.
+ */
+#define sbinheap_update(orig_node, heap) \
+__sbinheap_update((orig_node), (heap))
+
+
+/**
+ * Copy the heap's operation counters (see heapstats.h) into 'stats'.
+ * Returns 0, or -1 with 'stats' zeroed if built without BINHEAP_STATS.
+ * Serialize with the heap's writers; the counters are not atomic.
+ */
+static inline int sbinheap_stats(const struct sbinheap *heap,
+				struct heap_stats *stats)
+{
+#ifdef BINHEAP_STATS
+	*stats = heap->stats;
+	return 0;
+#else
+	static const struct heap_stats zero;
+	*stats = zero;
+	return -1;
+#endif
+}
+
+/* Zero the heap's operation counters. No-op without BINHEAP_STATS. */
+static inline void sbinheap_stats_reset(struct sbinheap *heap)
+{
+#ifdef BINHEAP_STATS
+	static const struct heap_stats zero;
+	heap->stats = zero;
+#endif
+}
 
 static inline void INIT_SBINHEAP(struct sbinheap *heap)
 {
 	static const struct sbinheap_node init_node = __SBINHEAP_NODE_INIT;
 	struct sbinheap_node* step;
+	heap->size = 0;
+	heap->pub = 0;
+	heap->prefetch = 0;
+	sbinheap_stats_reset(heap);
 	for(step = heap->buf; step < heap->buf + heap->max_size; ++step) {
 		*step = init_node;
 	}
 }
 
+/**
+ * Prefetch 'distance' levels ahead while sifting down (0 disables; at most
+ * SBINHEAP_PREFETCH_MAX). At each level, the node slots 'distance' levels
+ * below and the user data of the nodes one level above those are
+ * prefetched, so that both are in cache when the sift reaches them. Pays
+ * off once the heap and its data exceed the last-level cache. Call after
+ * INIT_SBINHEAP().
+ */
+static inline void sbinheap_set_prefetch(struct sbinheap *heap, int distance)
+{
+	if(distance < 0) {
+		distance = 0;
+	}
+	if(distance > SBINHEAP_PREFETCH_MAX) {
+		distance = SBINHEAP_PREFETCH_MAX;
+	}
+	heap->prefetch = distance;
+}
+
 /* Returns true if sbinheap is empty. */
 static inline int sbinheap_empty(struct sbinheap *heap)
 {
@@ -162,6 +252,27 @@ static inline idx_t sbinheap_max_size(struct sbinheap *heap)
 	return heap->max_size;
 }
 
+/**
+ * Opt in to publishing the root into 'top' after every mutating operation,
+ * so that other threads can read it without the heap's lock (see heaptop.h).
+ * 'top' must already be initialized with INIT_HEAPTOP(). Pass 0 to opt out.
+ */
+static inline void sbinheap_publish_top(struct sbinheap *heap,
+				struct heaptop *top)
+{
+	heap->pub = top;
+	if(top) {
+		heaptop_publish(top, heap->size ? heap->buf->data : 0);
+	}
+}
+
+static inline void __sbinheap_publish(struct sbinheap *heap)
+{
+	if(heap->pub) {
+		heaptop_publish(heap->pub, heap->size ? heap->buf->data : 0);
+	}
+}
+
 /* Returns true if sbinheap node is in a heap. */
 static inline int sbinheap_is_in_heap(const struct sbinheap_node *node)
 {
@@ -180,6 +291,29 @@ typedef void (*sbinheap_for_each_t)(sbinheap_node_t node, void* args);
 void sbinheap_for_each(struct sbinheap *heap,
 				sbinheap_for_each_t fn, void* args);
 
+/**
+ * sbinheap_for_each_node - iterate over the nodes of a heap, in array
+ * order. The heap must not be modified during the walk.
+ * @pos:	the struct sbinheap_node * to use as a loop cursor.
+ * @heap:	the heap.
+ */
+#define sbinheap_for_each_node(pos, heap) \
+for((pos) = (heap)->buf; (pos) < (heap)->buf + (heap)->size; ++(pos))
+
+/**
+ * sbinheap_for_each_entry - iterate over the elements of a heap, in array
+ * order. The heap must not be modified during the walk.
+ * @pos:	the type * to use as a loop cursor.
+ * @heap:	the heap.
+ * @type:	the type of the struct the handles are embedded in.
+ * @member:	unused.
+ */
+#define sbinheap_for_each_entry(pos, heap, type, member) \
+for(struct sbinheap_node *__sbinheap_pos = (heap)->buf; \
+	(__sbinheap_pos < (heap)->buf + (heap)->size) && \
+		(((pos) = sbinheap_entry(__sbinheap_pos, type, member)), 1); \
+	++__sbinheap_pos)
+
 /* Insert an allocated node into a heap */
 void __sbinheap_insert(struct sbinheap_node *new_node, struct sbinheap *heap);
 
@@ -196,14 +330,162 @@ static inline void __sbinheap_add(struct sbinheap* heap,
 		n->data = data;
 		n->ref_ptr = ret;
 		*ret = n;
+		heap_stat_inc(heap, ref_updates);
 
 		__sbinheap_insert(n, heap);
+		__sbinheap_publish(heap);
+	}
+	else {
+		*ret = 0;
+	}
+}
+
+/* Allocates and initializes a node at the end of the heap. Does not sift. */
+static inline void __sbinheap_append(struct sbinheap* heap,
+				void* data, struct sbinheap_node** ret)
+{
+	if (heap->size < heap->max_size) {
+		idx_t idx = (heap->size)++;
+		struct sbinheap_node *n = heap->buf + idx;
+
+		n->idx = idx;
+		n->data = data;
+		n->ref_ptr = ret;
+		*ret = n;
 	}
 	else {
 		*ret = 0;
 	}
 }
 
+/**
+ * Restore the heap property over all nodes in O(n) (Floyd's method).
+ * Typically called once after a bulk load with sbinheap_append().
+ */
+void sbinheap_build(struct sbinheap *heap);
+
+/*
+ * sbinheap_add_batch() heapifies once a window of SBINHEAP_BATCH_MIN new
+ * keys climbs to within SBINHEAP_BATCH_SLACK levels of the root on
+ * average, if at least a window of keys remains.
+ */
+#define SBINHEAP_BATCH_MIN	16
+#define SBINHEAP_BATCH_SLACK	2
+
+/**
+ * Insert every element appended with sbinheap_append() since the heap's
+ * size was 'first'. The heap [0, first) must be valid. New elements are
+ * sifted up in order while that is cheap, as it is for most keys. If they
+ * keep climbing to the root (e.g., a run of keys in descending order), the
+ * rest of the batch is merged by heapifying only the new nodes' ancestors,
+ * level by level: O(k + log^2 n) for k elements instead of O(k log n).
+ */
+void sbinheap_add_batch(struct sbinheap *heap, idx_t first);
+
+/**
+ * Restore the heap property within the subtree rooted at index 'root',
+ * bottom-up. Subtrees that do not overlap may be heapified concurrently.
+ */
+void __sbinheap_heapify_subtree(struct sbinheap *heap, idx_t root);
+
+/**
+ * Sift down nodes [0, end) in reverse order. If every subtree rooted at
+ * index 'end' or beyond is already a heap, the whole heap is afterwards.
+ */
+void __sbinheap_heapify_top(struct sbinheap *heap, idx_t end);
+
+/* Results of sbinheap_verify() and sbinheap_repair(). */
+#define SBINHEAP_VERIFY_OK	0
+/* an element orders before its parent (e.g., a key changed in place) */
+#define SBINHEAP_VERIFY_ORDER	1
+/* bad size, node index or ref_ptr; fatal */
+#define SBINHEAP_VERIFY_LINKS	2
+
+/**
+ * Check every invariant of the heap in one sequential O(n) pass over the
+ * array: heap order, each node's index, and that each node's ref_ptr (the
+ * caller's handle) points back to it. Its comparisons count in the
+ * heap's stats.
+ * Returns SBINHEAP_VERIFY_LINKS if anything but order is broken, else
+ * SBINHEAP_VERIFY_ORDER if order is, else SBINHEAP_VERIFY_OK.
+ */
+int sbinheap_verify(struct sbinheap *heap);
+
+/**
+ * Verify, then restore heap order with sbinheap_build() if only order was
+ * broken. Returns the result of the verification, so SBINHEAP_VERIFY_ORDER
+ * means the heap was repaired. A heap with broken links is left as is.
+ */
+int sbinheap_repair(struct sbinheap *heap);
+
+
+/* Changes an element's key in place; see struct sbinheap_rebuild. */
+typedef void (*sbinheap_remap_t)(void *data, void *args);
+
+/**
+ * Incremental rebuild cursor, for re-ordering a whole heap (e.g., after a
+ * global priority remap) without an O(n) latency spike.
+ *
+ * The rebuild is Floyd's bottom-up heapify split into steps of bounded
+ * work. The cursor visits nodes from the last to the root, applying
+ * 'remap' to each element just before sifting it down among the already
+ * visited nodes below it. One unit of work is one node visit or one level
+ * of a sift; the whole rebuild takes at most 2n units.
+ *
+ * Because keys change only as the cursor reaches them, the unvisited nodes
+ * still form a valid heap under their old keys and sbinheap_rebuild_top()
+ * stays exact (for the keys as they are at that moment) at every step, in
+ * O(1). If keys were instead changed before the rebuild (remap == 0), the
+ * top is only meaningful once the rebuild is done.
+ *
+ * The heap must not be modified by other operations until the rebuild is
+ * done.
+ */
+struct sbinheap_rebuild {
+	struct sbinheap *heap;
+
+	sbinheap_remap_t remap;
+	void *args;
+
+	/* nodes [0, next) have not been visited */
+	idx_t next;
+
+	/* node part way through its sift, or 0 */
+	struct sbinheap_node *sift;
+	/* levels the current sift may still take */
+	idx_t sift_left;
+
+	/* carries the data of the best visited element, if any */
+	struct sbinheap_node best;
+	int have_best;
+
+	/* upper bound on the units of work left */
+	size_t remaining;
+};
+
+/* Begin an incremental rebuild of 'heap'. 'remap' may be 0. */
+void sbinheap_rebuild_start(struct sbinheap_rebuild *c, struct sbinheap *heap,
+				sbinheap_remap_t remap, void *args);
+
+/**
+ * Do at most 'budget' units of rebuild work. Returns an upper bound on the
+ * units still left; 0 means the rebuild is done and the heap is valid.
+ */
+size_t sbinheap_rebuild_step(struct sbinheap_rebuild *c, size_t budget);
+
+/* Data pointer of the minimum element at this point of the rebuild. */
+void* sbinheap_rebuild_top(struct sbinheap_rebuild *c);
+
+/**
+ * sbinheap_rebuild_top_entry - get the struct of the minimum element while
+ * a rebuild is in progress.
+ * @c:		the rebuild cursor.
+ * @type:	the type of the struct the handle is embedded in.
+ * @member:	unused.
+ */
+#define sbinheap_rebuild_top_entry(c, type, member) \
+((type *)sbinheap_rebuild_top(c))
+
 /**
  * Removes the root node from the heap. The node is removed after coalescing
  * the binheap_node with its original data pointer at the root of the tree.
@@ -226,4 +508,10 @@ void* __sbinheap_delete(struct sbinheap_node *node,
 void __sbinheap_decrease(struct sbinheap_node *node,
 				struct sbinheap *heap);
 
+/**
+ * Bubble a node whose value has changed up or down, as needed.
+ */
+void __sbinheap_update(struct sbinheap_node *node,
+				struct sbinheap *heap);
+
 #endif
@@ -0,0 +1,248 @@
+#include "sbinheap_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+static uint64_t __fnv1a(uint64_t h, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	while(len--) {
+		h ^= *p++;
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/* Checksum of the header fields that precede 'checksum'. */
+static uint64_t __hdr_sum(const struct sbinheap_snapshot_hdr *hdr)
+{
+	return __fnv1a(FNV_OFFSET, hdr,
+			offsetof(struct sbinheap_snapshot_hdr, checksum));
+}
+
+/* fsync the directory holding 'path', so a rename into it is durable. */
+static int __fsync_dir(const char *path)
+{
+	char dir[4096];
+	const char *slash = strrchr(path, '/');
+	size_t len;
+	int fd, err = 0;
+
+	if(!slash) {
+		strcpy(dir, ".");
+	}
+	else {
+		len = (slash == path) ? 1 : (size_t)(slash - path);
+		if(len >= sizeof(dir)) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		memcpy(dir, path, len);
+		dir[len] = '\0';
+	}
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if(fd < 0) {
+		return -1;
+	}
+	if(fsync(fd)) {
+		err = errno;
+	}
+	close(fd);
+	if(err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+
+int sbinheap_save(const struct sbinheap *heap, const char *path,
+				size_t rec_size, sbinheap_save_t fn, void *args)
+{
+	struct sbinheap_snapshot_hdr hdr;
+	char rec[SBINHEAP_SNAPSHOT_MAX_REC];
+	char tmp_path[4096];
+	FILE *f;
+	idx_t i;
+	int fd, err = 0;
+
+	if(rec_size == 0 || rec_size > SBINHEAP_SNAPSHOT_MAX_REC) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* a unique name next to 'path', so concurrent saves do not collide */
+	if(snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >=
+			(int)sizeof(tmp_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fd = mkstemp(tmp_path);
+	if(fd < 0) {
+		return -1;
+	}
+	f = fdopen(fd, "wb");
+	if(!f) {
+		err = errno;
+		close(fd);
+		unlink(tmp_path);
+		errno = err;
+		return -1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SBINHEAP_SNAPSHOT_MAGIC, sizeof(SBINHEAP_SNAPSHOT_MAGIC));
+	hdr.version = SBINHEAP_SNAPSHOT_VERSION;
+	hdr.rec_size = (uint32_t)rec_size;
+	hdr.nr_nodes = (uint64_t)heap->size;
+	hdr.checksum = __hdr_sum(&hdr);
+
+	/* placeholder header; rewritten once the checksum is known */
+	if(fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+		err = errno;
+	}
+
+	for(i = 0; !err && i < heap->size; ++i) {
+		memset(rec, 0, rec_size);
+		if(fn(heap->buf + i, rec, args)) {
+			err = ECANCELED;
+		}
+		else if(fwrite(rec, rec_size, 1, f) != 1) {
+			err = errno;
+		}
+		else {
+			hdr.checksum = __fnv1a(hdr.checksum, rec, rec_size);
+		}
+	}
+
+	if(!err && (fseek(f, 0, SEEK_SET) ||
+			fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+			fflush(f) || fsync(fileno(f)))) {
+		err = errno;
+	}
+	if(fclose(f) && !err) {
+		err = errno;
+	}
+	if(!err && rename(tmp_path, path)) {
+		err = errno;
+	}
+
+	if(err) {
+		unlink(tmp_path);
+		errno = err;
+		return -1;
+	}
+
+	/* the new name only survives a crash once the directory is synced */
+	return __fsync_dir(path);
+}
+
+
+int sbinheap_load(struct sbinheap *heap, const char *path,
+				sbinheap_load_t fn, void *args)
+{
+	const struct sbinheap_snapshot_hdr *hdr;
+	const char *recs;
+	struct stat st;
+	void *map;
+	uint64_t sum;
+	idx_t i, n;
+	int fd, err = 0;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return -1;
+	}
+	if(fstat(fd, &st)) {
+		err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	if((size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EBADMSG;
+		return -1;
+	}
+
+	map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err = errno;
+	close(fd);
+	if(map == MAP_FAILED) {
+		errno = err;
+		return -1;
+	}
+	err = 0;
+
+	hdr = map;
+	recs = (const char*)map + sizeof(*hdr);
+	n = (idx_t)hdr->nr_nodes;
+
+	if(memcmp(hdr->magic, SBINHEAP_SNAPSHOT_MAGIC,
+			sizeof(SBINHEAP_SNAPSHOT_MAGIC)) ||
+	   hdr->version != SBINHEAP_SNAPSHOT_VERSION ||
+	   hdr->rec_size == 0 ||
+	   hdr->nr_nodes > ((uint64_t)st.st_size - sizeof(*hdr)) / hdr->rec_size ||
+	   (uint64_t)st.st_size !=
+			sizeof(*hdr) + hdr->nr_nodes * hdr->rec_size) {
+		err = EBADMSG;
+	}
+	else if(n > heap->max_size || heap->size != 0) {
+		err = ENOSPC;
+	}
+
+	if(!err) {
+		madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+		sum = __fnv1a(__hdr_sum(hdr), recs,
+				(size_t)(hdr->nr_nodes * hdr->rec_size));
+		if(sum != hdr->checksum) {
+			err = EBADMSG;
+		}
+	}
+
+	/* array is already heap-ordered: just rebind, no comparisons */
+	for(i = 0; !err && i < n; ++i) {
+		struct sbinheap_node *node = heap->buf + i;
+		void *data;
+		sbinheap_node_t *ref;
+
+		if(fn(recs + i * hdr->rec_size, &data, &ref, args)) {
+			err = ECANCELED;
+			break;
+		}
+
+		node->idx = i;
+		node->data = data;
+		node->ref_ptr = ref;
+		*ref = node;
+		heap->size = i + 1;
+	}
+
+	if(err) {
+		/* undo any partial restore */
+		for(i = 0; i < heap->size; ++i) {
+			*(heap->buf[i].ref_ptr) = SBINHEAP_NODE_INIT();
+			heap->buf[i].idx = SBINHEAP_BADIDX;
+		}
+		heap->size = 0;
+	}
+	__sbinheap_publish(heap);
+
+	munmap(map, (size_t)st.st_size);
+
+	if(err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
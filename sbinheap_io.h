@@ -0,0 +1,72 @@
+#ifndef STATIC_BINARY_HEAP_IO_H
+#define STATIC_BINARY_HEAP_IO_H
+
+#include "sbinheap.h"
+
+#include <stdint.h>
+
+/**
+ * Snapshot and restore of sbinheap state.
+ *
+ * Rebuilding a large heap by re-adding every item costs O(n log n)
+ * comparisons. sbinheap_save() instead writes the heap array, in heap
+ * order, to a versioned and checksummed file: one fixed-size record per
+ * node, filled in by a caller callback (typically an item id and its key).
+ * sbinheap_load() maps the file, verifies it, and asks a second callback to
+ * resolve each record back to a data pointer and the owner's
+ * sbinheap_node_t. Since the array is already heap-ordered, the restore is
+ * O(n) and performs no comparisons.
+ *
+ * These helpers use POSIX file I/O and are intended for user-land only.
+ */
+
+#define SBINHEAP_SNAPSHOT_MAGIC		"SBHSNAP"
+#define SBINHEAP_SNAPSHOT_VERSION	1
+
+/* Largest record supported by sbinheap_save(). */
+#define SBINHEAP_SNAPSHOT_MAX_REC	256
+
+/* On-disk header. Records follow immediately. */
+struct sbinheap_snapshot_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t rec_size;
+	uint64_t nr_nodes;
+
+	/* FNV-1a over the header fields above and all records */
+	uint64_t checksum;
+};
+
+/**
+ * Fill 'rec' (rec_size bytes) with what is needed to find the node's data
+ * again after a restart. Return 0, or non-zero to abort the save.
+ */
+typedef int (*sbinheap_save_t)(const struct sbinheap_node *node,
+				void *rec, void *args);
+
+/**
+ * Resolve a record to the data pointer and the owner's handle that the
+ * node had when it was saved. Return 0, or non-zero to abort the load.
+ */
+typedef int (*sbinheap_load_t)(const void *rec, void **data,
+				sbinheap_node_t **ref, void *args);
+
+/**
+ * Write the heap to 'path'. The file is written to a unique temporary name
+ * in the same directory and renamed into place, so an existing snapshot is
+ * replaced atomically, even by concurrent saves. The file and the directory
+ * are synced before returning; the file is created with mode 0600.
+ * Returns 0, or -1 with errno set.
+ */
+int sbinheap_save(const struct sbinheap *heap, const char *path,
+				size_t rec_size, sbinheap_save_t fn, void *args);
+
+/**
+ * Load the snapshot at 'path' into 'heap', rebinding each owner's handle.
+ * The heap must be empty and large enough to hold the snapshot. Returns 0,
+ * or -1 with errno set (EBADMSG for a corrupt file) and the heap left empty.
+ */
+int sbinheap_load(struct sbinheap *heap, const char *path,
+				sbinheap_load_t fn, void *args);
+
+#endif
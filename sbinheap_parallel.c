@@ -0,0 +1,114 @@
+#include "sbinheap_parallel.h"
+
+#include <pthread.h>
+
+struct __build_work {
+	struct sbinheap *heap;
+
+	/* subtree roots are [first, first + count) */
+	idx_t first;
+	idx_t count;
+
+	/* next subtree to claim, relative to 'first' */
+	idx_t next;
+};
+
+/* Per-thread state of a build. */
+struct __build_thread {
+	pthread_t thread;
+	struct __build_work *w;
+
+	/*
+	 * Private copy of the heap header: the subtrees share the array, but
+	 * each thread counts its operations (BINHEAP_STATS) in its own copy.
+	 */
+	struct sbinheap heap;
+};
+
+static void* __build_worker(void *arg)
+{
+	struct __build_thread *t = arg;
+	struct __build_work *w = t->w;
+	idx_t i;
+
+	while((i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED)) < w->count) {
+		__sbinheap_heapify_subtree(&t->heap, w->first + i);
+	}
+
+	return 0;
+}
+
+static void __build_thread_init(struct __build_thread *t,
+				struct __build_work *w)
+{
+	t->w = w;
+	t->heap = *w->heap;
+	t->heap.pub = 0;
+	sbinheap_stats_reset(&t->heap);
+}
+
+
+int sbinheap_build_parallel(struct sbinheap *heap, int nr_threads)
+{
+	struct __build_work w;
+	struct __build_thread threads[SBINHEAP_PARALLEL_MAX];
+	int started = 0;
+	int depth = 0;
+	idx_t i;
+
+	/* no more threads than the array, or than the heap keeps busy */
+	if(nr_threads > SBINHEAP_PARALLEL_MAX) {
+		nr_threads = SBINHEAP_PARALLEL_MAX;
+	}
+	if(nr_threads > heap->size / SBINHEAP_PARALLEL_MIN) {
+		nr_threads = heap->size / SBINHEAP_PARALLEL_MIN;
+	}
+
+	if(nr_threads <= 1) {
+		sbinheap_build(heap);
+		return 1;
+	}
+
+	/*
+	 * Split at the shallowest depth giving at least eight subtrees per
+	 * thread, for balance: subtrees on the left may be one level deeper.
+	 * Every subtree root must be internal, or there is nothing to split.
+	 */
+	while(((idx_t)1 << depth) < 8 * (idx_t)nr_threads) {
+		++depth;
+	}
+	while((depth > 0) && ((((idx_t)1 << depth) - 1) >= heap->size / 2)) {
+		--depth;
+	}
+
+	w.heap = heap;
+	w.first = ((idx_t)1 << depth) - 1;
+	w.count = ((idx_t)1 << depth);
+	w.next = 0;
+	if(w.first + w.count > heap->size) {
+		w.count = heap->size - w.first;
+	}
+
+	/* threads[0] is the caller */
+	for(i = 0; i < nr_threads; ++i) {
+		__build_thread_init(&threads[i], &w);
+	}
+	for(i = 1; i < nr_threads; ++i) {
+		if(pthread_create(&threads[started + 1].thread, 0, __build_worker,
+				&threads[started + 1]) == 0) {
+			++started;
+		}
+	}
+	(void)__build_worker(&threads[0]);
+	heap_stats_merge(heap, &threads[0].heap);
+	for(i = 1; i <= started; ++i) {
+		pthread_join(threads[i].thread, 0);
+		heap_stats_merge(heap, &threads[i].heap);
+	}
+
+	/* subtrees are heaps; sift the nodes above them */
+	__sbinheap_heapify_top(heap, w.first);
+	__sbinheap_publish(heap);
+
+	return started + 1;
+}
@@ -0,0 +1,40 @@
+#ifndef STATIC_BINARY_HEAP_PARALLEL_H
+#define STATIC_BINARY_HEAP_PARALLEL_H
+
+#include "defs.h"
+#include "sbinheap.h"
+
+/**
+ * Parallel bulk build of an sbinheap.
+ *
+ * Loading n elements one __sbinheap_add() at a time costs O(n log n) on a
+ * single core. Instead, append all elements with sbinheap_append() and then
+ * call sbinheap_build_parallel(). It splits the tree at a depth with
+ * several subtrees per thread, heapifies those disjoint subtrees on a pool
+ * of pthreads, and then fixes up the few levels above them serially. Total
+ * work is the same O(n) as sbinheap_build().
+ *
+ * Comparators must be safe to call concurrently, and every node's ref_ptr
+ * must refer to a distinct handle; the handles of different subtrees are
+ * written from different threads.
+ *
+ * Kept apart from sbinheap.c so that the core heap does not depend on
+ * pthreads.
+ */
+
+/* Each thread gets at least this many nodes; smaller heaps build serially. */
+#define SBINHEAP_PARALLEL_MIN	(1 << 16)
+
+/* Most threads a build uses, including the caller. */
+#define SBINHEAP_PARALLEL_MAX	64
+
+/**
+ * Restore the heap property over all nodes using up to nr_threads threads,
+ * including the caller, capped at SBINHEAP_PARALLEL_MAX and at one thread
+ * per SBINHEAP_PARALLEL_MIN nodes. Threads that cannot be created are not fatal; their
+ * share of the work is picked up by the others. Returns the number of
+ * threads that took part.
+ */
+int sbinheap_build_parallel(struct sbinheap *heap, int nr_threads);
+
+#endif
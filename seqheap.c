@@ -0,0 +1,367 @@
+#include <errno.h>
+
+#include "seqheap.h"
+
+static struct seqheap_block* __seqheap_get_block(struct seqheap *heap)
+{
+	struct seqheap_block *blk = heap->free_blocks;
+
+	/* cannot fail: seqheap_add() keeps size within capacity */
+	heap->free_blocks = blk->next;
+	blk->next = 0;
+	return blk;
+}
+
+static inline void __seqheap_put_block(struct seqheap *heap,
+				struct seqheap_block *blk)
+{
+	blk->next = heap->free_blocks;
+	heap->free_blocks = blk;
+}
+
+
+static inline const struct seqheap_entry* __seqheap_run_first(
+				const struct seqheap_run *run)
+{
+	return &run->head->e[run->first];
+}
+
+static void __seqheap_run_append(struct seqheap *heap,
+				struct seqheap_run *run,
+				const struct seqheap_entry *e)
+{
+	if(!run->tail || run->end == SEQHEAP_BLOCK_ENTRIES) {
+		struct seqheap_block *blk = __seqheap_get_block(heap);
+
+		if(run->tail) {
+			run->tail->next = blk;
+		}
+		else {
+			run->head = blk;
+			run->first = 0;
+		}
+		run->tail = blk;
+		run->end = 0;
+	}
+
+	run->tail->e[run->end++] = *e;
+	++run->size;
+}
+
+/* Consume the first entry of a run, releasing blocks as they empty. */
+static void __seqheap_run_advance(struct seqheap *heap,
+				struct seqheap_run *run)
+{
+	--run->size;
+	if(++run->first == SEQHEAP_BLOCK_ENTRIES || !run->size) {
+		struct seqheap_block *blk = run->head;
+
+		run->head = blk->next;
+		run->first = 0;
+		__seqheap_put_block(heap, blk);
+
+		if(!run->size) {
+			run->tail = 0;
+			run->end = 0;
+		}
+	}
+}
+
+
+/* Sift down in a heap of run heads. */
+static void __seqheap_heads_down(struct seqheap_head *h, int n, int i)
+{
+	struct seqheap_head tmp = h[i];
+
+	for(;;) {
+		int child = 2*i + 1;
+
+		if(child >= n) {
+			break;
+		}
+		if(child + 1 < n && h[child + 1].key < h[child].key) {
+			++child;
+		}
+		if(tmp.key <= h[child].key) {
+			break;
+		}
+		h[i] = h[child];
+		i = child;
+	}
+	h[i] = tmp;
+}
+
+static void __seqheap_heads_build(struct seqheap_head *h, int n)
+{
+	int i;
+
+	for(i = n/2 - 1; i >= 0; --i) {
+		__seqheap_heads_down(h, n, i);
+	}
+}
+
+/* Rebuild the heap over all runs' first entries. */
+static void __seqheap_index_runs(struct seqheap *heap)
+{
+	int level, i, n = 0;
+
+	for(level = 0; level < SEQHEAP_MAX_LEVELS; ++level) {
+		for(i = 0; i < SEQHEAP_ARITY && heap->nr_runs[level]; ++i) {
+			struct seqheap_run *run = &heap->runs[level][i];
+
+			if(run->size) {
+				heap->heads[n].key = __seqheap_run_first(run)->key;
+				heap->heads[n].run = run;
+				heap->heads[n].level = level;
+				++n;
+			}
+		}
+	}
+
+	heap->nr_heads = n;
+	__seqheap_heads_build(heap->heads, n);
+}
+
+
+static void __seqheap_ins_up(struct seqheap_entry *h, int i)
+{
+	struct seqheap_entry tmp = h[i];
+
+	while(i > 0) {
+		int parent = (i - 1) / 2;
+
+		if(h[parent].key <= tmp.key) {
+			break;
+		}
+		h[i] = h[parent];
+		i = parent;
+	}
+	h[i] = tmp;
+}
+
+static void __seqheap_ins_down(struct seqheap_entry *h, int n, int i)
+{
+	struct seqheap_entry tmp = h[i];
+
+	for(;;) {
+		int child = 2*i + 1;
+
+		if(child >= n) {
+			break;
+		}
+		if(child + 1 < n && h[child + 1].key < h[child].key) {
+			++child;
+		}
+		if(tmp.key <= h[child].key) {
+			break;
+		}
+		h[i] = h[child];
+		i = child;
+	}
+	h[i] = tmp;
+}
+
+static inline void __seqheap_ins_pop(struct seqheap *heap)
+{
+	if(--heap->ins_size) {
+		heap->ins[0] = heap->ins[heap->ins_size];
+		__seqheap_ins_down(heap->ins, heap->ins_size, 0);
+	}
+}
+
+
+/* Most entries a run at 'level' is expected to hold: m * k^level. */
+static unsigned long __seqheap_level_cap(struct seqheap *heap, int level)
+{
+	unsigned long cap = heap->ins_max;
+
+	while(level--) {
+		cap *= SEQHEAP_ARITY;
+	}
+	return cap;
+}
+
+/* k-way merge every run of a level into 'out'. The level is left empty. */
+static void __seqheap_merge_level(struct seqheap *heap, int level,
+				struct seqheap_run *out)
+{
+	struct seqheap_head m[SEQHEAP_ARITY];
+	int i, n = 0;
+
+	for(i = 0; i < SEQHEAP_ARITY; ++i) {
+		struct seqheap_run *run = &heap->runs[level][i];
+
+		if(run->size) {
+			m[n].key = __seqheap_run_first(run)->key;
+			m[n].run = run;
+			m[n].level = level;
+			++n;
+		}
+	}
+	__seqheap_heads_build(m, n);
+
+	out->head = out->tail = 0;
+	out->first = out->end = 0;
+	out->size = 0;
+
+	while(n) {
+		struct seqheap_run *run = m[0].run;
+
+		__seqheap_run_append(heap, out, __seqheap_run_first(run));
+		__seqheap_run_advance(heap, run);
+
+		if(run->size) {
+			m[0].key = __seqheap_run_first(run)->key;
+		}
+		else {
+			m[0] = m[--n];
+		}
+		__seqheap_heads_down(m, n, 0);
+	}
+
+	heap->nr_runs[level] = 0;
+}
+
+/**
+ * Store a run at 'level'. A full level is first merged into one run, which
+ * stays at 'level' if it is no larger than the level's runs are expected
+ * to be, and moves up otherwise. Levels are thus bounded by log_k(n/m),
+ * not by the number of entries ever added.
+ */
+static void __seqheap_push_run(struct seqheap *heap,
+				const struct seqheap_run *run, int level)
+{
+	int i;
+
+	if(heap->nr_runs[level] == SEQHEAP_ARITY) {
+		struct seqheap_run merged;
+
+		__seqheap_merge_level(heap, level, &merged);
+
+		if(level + 1 < SEQHEAP_MAX_LEVELS &&
+		   merged.size > __seqheap_level_cap(heap, level)) {
+			__seqheap_push_run(heap, &merged, level + 1);
+		}
+		else {
+			heap->runs[level][0] = merged;
+			heap->nr_runs[level] = 1;
+		}
+	}
+
+	for(i = 0; heap->runs[level][i].size; ++i) {
+		/* find a free slot */
+	}
+	heap->runs[level][i] = *run;
+	++heap->nr_runs[level];
+}
+
+/* Sort the full insertion heap into a new run. */
+static void __seqheap_spill(struct seqheap *heap)
+{
+	struct seqheap_run run = {0, 0, 0, 0, 0};
+
+	while(heap->ins_size) {
+		__seqheap_run_append(heap, &run, &heap->ins[0]);
+		__seqheap_ins_pop(heap);
+	}
+
+	if(run.size) {
+		__seqheap_push_run(heap, &run, 0);
+		__seqheap_index_runs(heap);
+	}
+}
+
+
+int seqheap_init(struct seqheap *heap,
+				struct seqheap_entry *ins, int ins_max,
+				struct seqheap_block *blocks, unsigned long nr_blocks)
+{
+	static const struct seqheap_run empty_run;
+	unsigned long i;
+	int level, j;
+
+	/* an empty insertion heap could never spill a run */
+	if(ins_max < 1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	heap->ins = ins;
+	heap->ins_size = 0;
+	heap->ins_max = ins_max;
+
+	for(level = 0; level < SEQHEAP_MAX_LEVELS; ++level) {
+		for(j = 0; j < SEQHEAP_ARITY; ++j) {
+			heap->runs[level][j] = empty_run;
+		}
+		heap->nr_runs[level] = 0;
+	}
+	heap->nr_heads = 0;
+
+	heap->free_blocks = 0;
+	for(i = nr_blocks; i > 0; --i) {
+		__seqheap_put_block(heap, &blocks[i - 1]);
+	}
+
+	heap->size = 0;
+	heap->capacity = (nr_blocks > SEQHEAP_BLOCK_SLACK) ?
+		(nr_blocks - SEQHEAP_BLOCK_SLACK) * SEQHEAP_BLOCK_ENTRIES : 0;
+
+	return 0;
+}
+
+
+int seqheap_add(struct seqheap *heap, uint64_t key, void *data)
+{
+	struct seqheap_entry *e;
+
+	if(unlikely(heap->size == heap->capacity)) {
+		return -1;
+	}
+
+	if(unlikely(heap->ins_size == heap->ins_max)) {
+		__seqheap_spill(heap);
+	}
+
+	e = &heap->ins[heap->ins_size];
+	e->key = key;
+	e->data = data;
+	__seqheap_ins_up(heap->ins, heap->ins_size++);
+	++heap->size;
+
+	return 0;
+}
+
+
+void* __seqheap_delete_root(struct seqheap *heap)
+{
+	struct seqheap_run *run;
+	void *data;
+
+	if(!heap->size) {
+		return 0;
+	}
+	--heap->size;
+
+	if(!heap->nr_heads ||
+	   (heap->ins_size && heap->ins[0].key <= heap->heads[0].key)) {
+		data = heap->ins[0].data;
+		__seqheap_ins_pop(heap);
+		return data;
+	}
+
+	run = heap->heads[0].run;
+	data = __seqheap_run_first(run)->data;
+	__seqheap_run_advance(heap, run);
+
+	if(run->size) {
+		heap->heads[0].key = __seqheap_run_first(run)->key;
+	}
+	else {
+		--heap->nr_runs[heap->heads[0].level];
+		heap->heads[0] = heap->heads[--heap->nr_heads];
+	}
+	__seqheap_heads_down(heap->heads, heap->nr_heads, 0);
+
+	return data;
+}
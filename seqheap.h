@@ -0,0 +1,185 @@
+#ifndef SEQUENCE_HEAP_H
+#define SEQUENCE_HEAP_H
+
+#include <stdint.h>
+
+#include "defs.h"
+
+/**
+ * Sequence heap (Sanders) for queues far larger than the cache.
+ *
+ * At tens of millions of entries, every binheap or sbinheap operation walks
+ * a path of cache misses. A sequence heap instead keeps new entries in a
+ * small insertion heap that stays in cache. When it fills up, it is sorted
+ * into a run. Runs are grouped in levels of up to SEQHEAP_ARITY runs; a
+ * full level is k-way merged into a single run one level up. The minimum is
+ * the better of the insertion heap's root and a small heap over the first
+ * entries of all runs. Memory is thus touched sequentially, and each entry
+ * is moved O(log_k(n/m)) times in streams rather than sifted through a
+ * large array.
+ *
+ * Entries are stored by value as a key and a data pointer, so comparisons
+ * never dereference the caller's data. Smaller keys come first. Only add,
+ * top and delete_root are supported: an entry cannot be deleted or have
+ * its key changed once added.
+ *
+ * Like sbinheap, memory is provided by the caller: an array for the
+ * insertion heap, and a pool of blocks that hold the runs. Use
+ * seqheap_nr_blocks() to size the pool for a given capacity. No dynamic
+ * memory is allocated.
+ */
+
+/* Runs per level, i.e., the merge fan-in. */
+#ifndef SEQHEAP_ARITY
+#define SEQHEAP_ARITY		16
+#endif
+
+#define SEQHEAP_MAX_LEVELS	8
+#define SEQHEAP_MAX_RUNS	(SEQHEAP_ARITY * SEQHEAP_MAX_LEVELS)
+
+/* A block is one 4KB page. */
+#define SEQHEAP_BLOCK_ENTRIES	255
+
+/* Blocks beyond those holding entries: partly used blocks at run ends. */
+#define SEQHEAP_BLOCK_SLACK	(2 * (SEQHEAP_MAX_RUNS + SEQHEAP_MAX_LEVELS + 1))
+
+struct seqheap_entry {
+	uint64_t key;
+	void *data;
+};
+
+struct seqheap_block {
+	struct seqheap_block *next;
+	unsigned long __pad;
+	struct seqheap_entry e[SEQHEAP_BLOCK_ENTRIES];
+};
+
+/* A sorted run: a list of blocks, consumed from the front. */
+struct seqheap_run {
+	struct seqheap_block *head;
+	struct seqheap_block *tail;
+
+	/* next entry to consume in 'head' */
+	int first;
+
+	/* entries written to 'tail' */
+	int end;
+
+	/* entries left; 0 if the slot is free */
+	unsigned long size;
+};
+
+/* Key of the first entry of a run, for the heap over all runs. */
+struct seqheap_head {
+	uint64_t key;
+	struct seqheap_run *run;
+
+	/* level the run is stored at */
+	int level;
+};
+
+struct seqheap {
+	/* insertion heap (min-heap array) */
+	struct seqheap_entry *ins;
+	int ins_size;
+	int ins_max;
+
+	/* run slots per level, and the number of non-empty runs in each */
+	struct seqheap_run runs[SEQHEAP_MAX_LEVELS][SEQHEAP_ARITY];
+	int nr_runs[SEQHEAP_MAX_LEVELS];
+
+	/* min-heap over the first entries of all non-empty runs */
+	struct seqheap_head heads[SEQHEAP_MAX_RUNS];
+	int nr_heads;
+
+	/* unused blocks */
+	struct seqheap_block *free_blocks;
+
+	unsigned long size;
+	unsigned long capacity;
+};
+
+
+/**
+ * seqheap_top_entry - get the struct of the entry at the top of the heap.
+ * @heap:	the heap.
+ * @type:	the type of struct passed as 'data' to seqheap_add().
+ */
+#define seqheap_top_entry(heap, type) \
+((type *)seqheap_top(heap))
+
+/**
+ * seqheap_delete_root - remove the root entry from the heap.
+ * @heap:	the heap.
+ * @type:	the type of struct passed as 'data' to seqheap_add().
+ */
+#define seqheap_delete_root(heap, type) \
+((type *)__seqheap_delete_root(heap))
+
+
+/* Number of blocks needed to hold 'capacity' entries. */
+static inline unsigned long seqheap_nr_blocks(unsigned long capacity)
+{
+	return (capacity + SEQHEAP_BLOCK_ENTRIES - 1) / SEQHEAP_BLOCK_ENTRIES +
+		SEQHEAP_BLOCK_SLACK;
+}
+
+/**
+ * Initialize an empty heap. 'ins' holds the insertion heap and should fit
+ * in the L1 or L2 cache (e.g., 256 to 4096 entries). The heap holds as many
+ * entries as 'nr_blocks' blocks allow (see seqheap_nr_blocks()).
+ * Returns 0, or -1 with errno set to EINVAL if 'ins_max' is less than 1.
+ */
+int seqheap_init(struct seqheap *heap,
+				struct seqheap_entry *ins, int ins_max,
+				struct seqheap_block *blocks, unsigned long nr_blocks);
+
+/* Returns true if seqheap is empty. */
+static inline int seqheap_empty(struct seqheap *heap)
+{
+	return(heap->size == 0);
+}
+
+static inline unsigned long seqheap_size(struct seqheap *heap)
+{
+	return heap->size;
+}
+
+static inline unsigned long seqheap_capacity(struct seqheap *heap)
+{
+	return heap->capacity;
+}
+
+/* Returns the data of the top entry, or 0 if empty. */
+static inline void* seqheap_top(struct seqheap *heap)
+{
+	if(heap->nr_heads &&
+	   (!heap->ins_size || heap->heads[0].key < heap->ins[0].key)) {
+		const struct seqheap_run *run = heap->heads[0].run;
+
+		return run->head->e[run->first].data;
+	}
+	return heap->ins_size ? heap->ins[0].data : 0;
+}
+
+/* Returns the key of the top entry. The heap must not be empty. */
+static inline uint64_t seqheap_top_key(struct seqheap *heap)
+{
+	if(heap->nr_heads &&
+	   (!heap->ins_size || heap->heads[0].key < heap->ins[0].key)) {
+		return heap->heads[0].key;
+	}
+	return heap->ins[0].key;
+}
+
+/**
+ * Add an entry. Returns 0, or -1 if the heap is at capacity. When the
+ * insertion heap is full, it is first sorted into a run, which may merge
+ * full levels.
+ */
+int seqheap_add(struct seqheap *heap, uint64_t key, void *data);
+
+/* Remove the top entry and return its data, or 0 if empty. */
+void* __seqheap_delete_root(struct seqheap *heap);
+
+#endif
@@ -0,0 +1,282 @@
+#include "shbinheap.h"
+
+#include <errno.h>
+
+static inline shbinheap_node_t* __handle(const struct shbinheap *heap,
+				shbinheap_idx_t idx)
+{
+	return shbinheap_ptr(heap, heap->sh->buf[idx].ref);
+}
+
+/* Point the owner's handle at slot idx. */
+static inline void __bind(const struct shbinheap *heap, shbinheap_idx_t idx)
+{
+	*__handle(heap, idx) = idx;
+}
+
+static inline int __less(const struct shbinheap *heap,
+				shbinheap_idx_t a, shbinheap_idx_t b)
+{
+	const struct shbinheap_node *buf = heap->sh->buf;
+
+	return heap->compare(shbinheap_ptr(heap, buf[a].data),
+				shbinheap_ptr(heap, buf[b].data));
+}
+
+
+/* Apply the pending journal records (if any) and mark the journal idle. */
+static void __shbinheap_replay(struct shbinheap_shared *sh)
+{
+	struct shbinheap_journal *j = &sh->journal;
+	int i, nr = __atomic_load_n(&j->nr, __ATOMIC_ACQUIRE);
+
+	for(i = 0; i < nr; ++i) {
+		sh->buf[j->idx[i]] = j->slot[i];
+	}
+	if(nr) {
+		sh->size = j->size;
+	}
+
+	__atomic_store_n(&j->nr, 0, __ATOMIC_RELEASE);
+}
+
+/* Make the filled-in records durable, then apply them. */
+static inline void __shbinheap_commit(struct shbinheap_shared *sh, int nr)
+{
+	__atomic_store_n(&sh->journal.nr, nr, __ATOMIC_RELEASE);
+	__shbinheap_replay(sh);
+}
+
+
+/* Swaps two slots and track references */
+static void __shbinheap_swap(struct shbinheap *heap,
+				shbinheap_idx_t a, shbinheap_idx_t b)
+{
+	struct shbinheap_shared *sh = heap->sh;
+	struct shbinheap_journal *j = &sh->journal;
+
+	j->size = sh->size;
+	j->idx[0] = a;
+	j->slot[0] = sh->buf[b];
+	j->idx[1] = b;
+	j->slot[1] = sh->buf[a];
+	__shbinheap_commit(sh, 2);
+
+	__bind(heap, a);
+	__bind(heap, b);
+}
+
+
+static void __shbinheap_bubble_up(struct shbinheap *heap,
+				shbinheap_idx_t idx)
+{
+	while(idx > 0) {
+		shbinheap_idx_t p = (idx - 1) / 2;
+
+		if(!__less(heap, idx, p)) {
+			break;
+		}
+		__shbinheap_swap(heap, p, idx);
+		idx = p;
+	}
+}
+
+
+static void __shbinheap_bubble_down(struct shbinheap *heap,
+				shbinheap_idx_t idx)
+{
+	const shbinheap_idx_t limit = heap->sh->size;
+
+	while(2*idx + 1 < limit) {
+		shbinheap_idx_t child = 2*idx + 1;
+
+		if((child + 1 < limit) && __less(heap, child + 1, child)) {
+			++child;
+		}
+		if(!__less(heap, child, idx)) {
+			break;
+		}
+		__shbinheap_swap(heap, idx, child);
+		idx = child;
+	}
+}
+
+
+/**
+ * Recover from a lock owner that died mid-operation: finish its pending
+ * slot write, restore heap order, and rebind every handle.
+ */
+static void __shbinheap_repair(struct shbinheap *heap)
+{
+	shbinheap_idx_t i;
+
+	__shbinheap_replay(heap->sh);
+
+	for(i = 0; i < heap->sh->size; ++i) {
+		__bind(heap, i);
+	}
+	for(i = heap->sh->size / 2 - 1; i >= 0; --i) {
+		__shbinheap_bubble_down(heap, i);
+	}
+}
+
+
+int shbinheap_create(struct shbinheap *heap, void *base, void *mem,
+				shbinheap_idx_t max_size, shbinheap_order_t compare)
+{
+	struct shbinheap_shared *sh = mem;
+	pthread_mutexattr_t attr;
+	int ret;
+
+	sh->size = 0;
+	sh->max_size = max_size;
+	sh->journal.nr = 0;
+
+	ret = pthread_mutexattr_init(&attr);
+	if(ret) {
+		return ret;
+	}
+	ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if(!ret) {
+		ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	}
+	if(!ret) {
+		ret = pthread_mutex_init(&sh->lock, &attr);
+	}
+	pthread_mutexattr_destroy(&attr);
+
+	if(!ret) {
+		shbinheap_attach(heap, base,
+			(shbinheap_off_t)((char*)mem - (char*)base), compare);
+	}
+
+	return ret;
+}
+
+
+void shbinheap_attach(struct shbinheap *heap, void *base,
+				shbinheap_off_t off, shbinheap_order_t compare)
+{
+	heap->base = base;
+	heap->sh = (struct shbinheap_shared*)((char*)base + off);
+	heap->compare = compare;
+}
+
+
+void shbinheap_destroy(struct shbinheap *heap)
+{
+	pthread_mutex_destroy(&heap->sh->lock);
+}
+
+
+int shbinheap_lock(struct shbinheap *heap)
+{
+	int ret = pthread_mutex_lock(&heap->sh->lock);
+
+	if(unlikely(ret == EOWNERDEAD)) {
+		__shbinheap_repair(heap);
+		pthread_mutex_consistent(&heap->sh->lock);
+	}
+
+	return ret;
+}
+
+
+void shbinheap_unlock(struct shbinheap *heap)
+{
+	pthread_mutex_unlock(&heap->sh->lock);
+}
+
+
+int __shbinheap_add(struct shbinheap *heap, void *data,
+				shbinheap_node_t *ret)
+{
+	struct shbinheap_shared *sh = heap->sh;
+	struct shbinheap_journal *j = &sh->journal;
+	shbinheap_idx_t idx = sh->size;
+
+	if(unlikely(idx >= sh->max_size)) {
+		*ret = SHBINHEAP_BADIDX;
+		return -1;
+	}
+
+	j->size = idx + 1;
+	j->idx[0] = idx;
+	j->slot[0].ref = shbinheap_off(heap, ret);
+	j->slot[0].data = shbinheap_off(heap, data);
+	__shbinheap_commit(sh, 1);
+
+	*ret = idx;
+	__shbinheap_bubble_up(heap, idx);
+
+	return 0;
+}
+
+
+void* __shbinheap_delete_root(struct shbinheap *heap)
+{
+	/* calling delete on empty heap is a bug */
+	return __shbinheap_delete(0, heap);
+}
+
+
+void* __shbinheap_delete(shbinheap_node_t node, struct shbinheap *heap)
+{
+	struct shbinheap_shared *sh = heap->sh;
+	struct shbinheap_journal *j = &sh->journal;
+	shbinheap_idx_t last = sh->size - 1;
+	void *data = shbinheap_ptr(heap, sh->buf[node].data);
+
+	/* reset owner's reference */
+	*__handle(heap, node) = SHBINHEAP_BADIDX;
+
+	if(node != last) {
+		/* move the last node into the hole and restore order */
+		j->size = last;
+		j->idx[0] = node;
+		j->slot[0] = sh->buf[last];
+		__shbinheap_commit(sh, 1);
+
+		__bind(heap, node);
+		if((node > 0) && __less(heap, node, (node - 1) / 2)) {
+			__shbinheap_bubble_up(heap, node);
+		}
+		else {
+			__shbinheap_bubble_down(heap, node);
+		}
+	}
+	else {
+		__atomic_store_n(&sh->size, last, __ATOMIC_RELEASE);
+	}
+
+	return data;
+}
+
+
+void __shbinheap_decrease(shbinheap_node_t node, struct shbinheap *heap)
+{
+	__shbinheap_bubble_up(heap, node);
+}
+
+
+int shbinheap_verify(struct shbinheap *heap)
+{
+	const struct shbinheap_shared *sh = heap->sh;
+	int result = SHBINHEAP_VERIFY_OK;
+	shbinheap_idx_t i;
+
+	if((sh->size < 0) || (sh->size > sh->max_size) || sh->journal.nr) {
+		return SHBINHEAP_VERIFY_LINKS;
+	}
+
+	for(i = 0; i < sh->size; ++i) {
+		if(*__handle(heap, i) != i) {
+			return SHBINHEAP_VERIFY_LINKS;
+		}
+		if((i > 0) && __less(heap, i, (i - 1) / 2)) {
+			result = SHBINHEAP_VERIFY_ORDER;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,229 @@
+#ifndef SHARED_BINARY_HEAP_H
+#define SHARED_BINARY_HEAP_H
+
+#include "defs.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Process-shared variant of sbinheap.
+ *
+ * sbinheap stores raw pointers (sbinheap::buf, sbinheap_node::ref_ptr and
+ * sbinheap_node::data), so it cannot live in a shared memory segment that
+ * is mapped at different addresses in different processes. shbinheap keeps
+ * the same array layout, but every reference is an offset relative to the
+ * base of the segment, and each caller-owned handle stores a slot index
+ * instead of a slot pointer. The heap, its handles and the data they refer
+ * to must all live in the same segment.
+ *
+ * The shared state carries a robust, process-shared mutex. All operations
+ * must be performed while holding it (see shbinheap_lock()). Slot writes
+ * go through a small redo journal, so if a process dies while holding the
+ * lock, the next locker replays the interrupted write, re-heapifies, and
+ * rebinds every handle before it proceeds.
+ *
+ * Comparators are process-local (function addresses differ between
+ * processes) and receive the resolved data pointers.
+ */
+
+typedef int64_t shbinheap_off_t;
+typedef int64_t shbinheap_idx_t;
+
+/* Handle held by the caller (in the shared segment): a slot index. */
+typedef shbinheap_idx_t shbinheap_node_t;
+
+#define SHBINHEAP_BADIDX (-1)
+
+#define SHBINHEAP_NODE_INIT() SHBINHEAP_BADIDX
+#define SHBINHEAP_NODE(name) \
+	shbinheap_node_t name = SHBINHEAP_NODE_INIT()
+/* Use to initialize shbinheap_node_t */
+#define INIT_SHBINHEAP_NODE(n) \
+	(*(n) = SHBINHEAP_BADIDX)
+
+
+/* Internal node data structure. The slot index is implied by position. */
+struct shbinheap_node {
+	/* offset of the caller's shbinheap_node_t handle */
+	shbinheap_off_t ref;
+
+	/* offset of user data */
+	shbinheap_off_t data;
+};
+
+/* Pending slot writes. Replayed if the lock owner dies. */
+struct shbinheap_journal {
+	/* number of valid records; 0 when idle */
+	int nr;
+
+	/* heap size after the records are applied */
+	shbinheap_idx_t size;
+
+	shbinheap_idx_t idx[2];
+	struct shbinheap_node slot[2];
+};
+
+/* State that lives in the shared segment. */
+struct shbinheap_shared {
+	pthread_mutex_t lock;
+
+	/* current size of the heap */
+	shbinheap_idx_t size;
+
+	/* maximum size of the heap */
+	shbinheap_idx_t max_size;
+
+	struct shbinheap_journal journal;
+
+	struct shbinheap_node buf[];
+};
+
+/**
+ * Signature of comparator function, called with the resolved data
+ * pointers. Assumed 'less-than' (min-heap).
+ */
+typedef int (*shbinheap_order_t)(const void *a, const void *b);
+
+/* Per-process view of a shared heap. */
+struct shbinheap {
+	/* where this process mapped the segment */
+	char *base;
+
+	struct shbinheap_shared *sh;
+
+	shbinheap_order_t compare;
+};
+
+
+/* Translate between pointers and offsets within the segment. */
+static inline shbinheap_off_t shbinheap_off(const struct shbinheap *heap,
+				const void *ptr)
+{
+	return (shbinheap_off_t)((const char*)ptr - heap->base);
+}
+
+static inline void* shbinheap_ptr(const struct shbinheap *heap,
+				shbinheap_off_t off)
+{
+	return heap->base + off;
+}
+
+/**
+ * shbinheap_top_entry - get the struct for the node at the top of the heap.
+ * @heap:	the heap.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	unused.
+ */
+#define shbinheap_top_entry(heap, type, member) \
+((type *)shbinheap_ptr((heap), (heap)->sh->buf[0].data))
+
+/**
+ * shbinheap_delete_root - remove the root element from the heap.
+ * @heap:	 the heap.
+ * @type (ignored):   the type of the struct the node is embedded in.
+ * @member (ignored): the name of the handle within the (type) struct.
+ */
+#define shbinheap_delete_root(heap, type, member) \
+__shbinheap_delete_root(heap)
+
+/**
+ * shbinheap_delete - remove an arbitrary element from the heap.
+ * @to_delete:  pointer to the handle of the element to remove.
+ * @heap:	 the heap.
+ */
+#define shbinheap_delete(to_delete, heap) \
+__shbinheap_delete(*(to_delete), (heap))
+
+/**
+ * shbinheap_add - insert an element to the heap
+ * new_node: handle to add.
+ * @heap:	 the heap.
+ * @type:	the type of the struct the handle is embedded in.
+ * @member:	 the name of the handle within the (type) struct.
+ */
+#define shbinheap_add(new_node, heap, type, member) \
+__shbinheap_add((heap), container_of((new_node), type, member), (new_node))
+
+/**
+ * shbinheap_decrease - re-eval the position of a node whose value has
+ * decreased.
+ * @orig_node: pointer to the handle of the element.
+ * @heap: the heap.
+ */
+#define shbinheap_decrease(orig_node, heap) \
+__shbinheap_decrease(*(orig_node), (heap))
+
+
+/* Bytes of shared memory needed for a heap of max_size entries. */
+static inline size_t shbinheap_shared_size(shbinheap_idx_t max_size)
+{
+	return sizeof(struct shbinheap_shared) +
+		(size_t)max_size * sizeof(struct shbinheap_node);
+}
+
+/* Returns true if shbinheap is empty. */
+static inline int shbinheap_empty(const struct shbinheap *heap)
+{
+	return (heap->sh->size == 0);
+}
+
+/* Returns true if the handle refers to a heap slot. */
+static inline int shbinheap_is_in_heap(shbinheap_node_t node)
+{
+	return (node != SHBINHEAP_BADIDX);
+}
+
+/**
+ * Initialize a heap in shared memory at 'mem', which must lie within the
+ * segment mapped at 'base', and attach to it. Returns 0 or an errno value.
+ */
+int shbinheap_create(struct shbinheap *heap, void *base, void *mem,
+				shbinheap_idx_t max_size, shbinheap_order_t compare);
+
+/* Attach to a heap created by another process at offset 'off'. */
+void shbinheap_attach(struct shbinheap *heap, void *base,
+				shbinheap_off_t off, shbinheap_order_t compare);
+
+/* Destroy the shared lock. No process may use the heap afterwards. */
+void shbinheap_destroy(struct shbinheap *heap);
+
+/**
+ * Acquire the heap lock. Returns 0 on success. Returns EOWNERDEAD, with
+ * the lock held, if the previous owner died; the heap has then been
+ * repaired, but the dead owner's last operation may or may not have taken
+ * effect. Any other value is an error and the lock is not held.
+ */
+int shbinheap_lock(struct shbinheap *heap);
+
+void shbinheap_unlock(struct shbinheap *heap);
+
+/* Results of shbinheap_verify(); as for sbinheap_verify(). */
+#define SHBINHEAP_VERIFY_OK	0
+/* an element orders before its parent */
+#define SHBINHEAP_VERIFY_ORDER	1
+/* bad size, pending journal records, or a handle not bound to its slot */
+#define SHBINHEAP_VERIFY_LINKS	2
+
+/**
+ * Check heap order, the size, an idle journal, and that every slot's
+ * handle holds that slot's index, in one pass. Call with the lock held.
+ * Returns SHBINHEAP_VERIFY_LINKS if anything but order is broken, else
+ * SHBINHEAP_VERIFY_ORDER if order is, else SHBINHEAP_VERIFY_OK.
+ */
+int shbinheap_verify(struct shbinheap *heap);
+
+/* Adds data to the heap. Returns 0, or -1 (and sets *ret to BADIDX) if full. */
+int __shbinheap_add(struct shbinheap *heap, void *data,
+				shbinheap_node_t *ret);
+
+/* Removes the root node from the heap. */
+void* __shbinheap_delete_root(struct shbinheap *heap);
+
+/* Delete an arbitrary node. */
+void* __shbinheap_delete(shbinheap_node_t node, struct shbinheap *heap);
+
+/* Bubble up a node whose value has decreased. */
+void __shbinheap_decrease(shbinheap_node_t node, struct shbinheap *heap);
+
+#endif
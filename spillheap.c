@@ -0,0 +1,121 @@
+#include "spillheap.h"
+
+static inline struct spillheap_node* __node_of(const struct spillheap *heap,
+				void *data)
+{
+	return (struct spillheap_node*)((char*)data + heap->node_offset);
+}
+
+static inline void* __data_of(const struct spillheap *heap,
+				struct spillheap_node *node)
+{
+	return (char*)node - heap->node_offset;
+}
+
+
+/* Returns true if the spill heap's root precedes the array's root. */
+static int __spillheap_spill_first(struct spillheap *heap)
+{
+	struct sbinheap_node tmp;
+
+	if(binheap_empty(&heap->spill)) {
+		return 0;
+	}
+	if(sbinheap_empty(&heap->array)) {
+		return 1;
+	}
+
+	/* comparators only look at 'data', so borrow the sbinheap order */
+	tmp.idx = SBINHEAP_BADIDX;
+	tmp.ref_ptr = 0;
+	tmp.data = heap->spill.root->data;
+
+	return heap->array.compare(&tmp, heap->array.buf);
+}
+
+
+/* Migrate spilled entries back into free array slots. */
+static void __spillheap_refill(struct spillheap *heap)
+{
+	while(!binheap_empty(&heap->spill) &&
+		  (heap->array.size < heap->array.max_size)) {
+		void *data = heap->spill.root->data;
+		struct spillheap_node *node = __node_of(heap, data);
+
+		(void)__binheap_delete_root(&heap->spill, &node->bnode);
+		__sbinheap_add(&heap->array, data, &node->snode);
+	}
+}
+
+
+void* __spillheap_top(struct spillheap *heap)
+{
+	if(__spillheap_spill_first(heap)) {
+		return heap->spill.root->data;
+	}
+	if(!sbinheap_empty(&heap->array)) {
+		return heap->array.buf->data;
+	}
+	return 0;
+}
+
+
+void __spillheap_add(struct spillheap_node *new_node,
+				struct spillheap *heap)
+{
+	void *data = __data_of(heap, new_node);
+
+	if(likely(heap->array.size < heap->array.max_size)) {
+		__sbinheap_add(&heap->array, data, &new_node->snode);
+	}
+	else {
+		__binheap_add(&new_node->bnode, &heap->spill, data);
+	}
+}
+
+
+void* __spillheap_delete_root(struct spillheap *heap)
+{
+	void *data;
+
+	if(__spillheap_spill_first(heap)) {
+		data = heap->spill.root->data;
+		(void)__binheap_delete_root(&heap->spill,
+				&__node_of(heap, data)->bnode);
+	}
+	else {
+		data = __sbinheap_delete_root(&heap->array);
+		__spillheap_refill(heap);
+	}
+
+	return data;
+}
+
+
+void* __spillheap_delete(struct spillheap_node *node,
+				struct spillheap *heap)
+{
+	void *data;
+
+	if(spillheap_is_spilled(node)) {
+		data = __binheap_delete(&node->bnode, &heap->spill);
+	}
+	else {
+		data = __sbinheap_delete(node->snode, &heap->array);
+		__spillheap_refill(heap);
+	}
+
+	return data;
+}
+
+
+void __spillheap_decrease(struct spillheap_node *node,
+				struct spillheap *heap)
+{
+	if(spillheap_is_spilled(node)) {
+		__binheap_decrease(&node->bnode, &heap->spill);
+	}
+	else {
+		__sbinheap_decrease(node->snode, &heap->array);
+	}
+}
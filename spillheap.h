@@ -0,0 +1,160 @@
+#ifndef SPILL_BINARY_HEAP_H
+#define SPILL_BINARY_HEAP_H
+
+#include "defs.h"
+#include "binheap.h"
+#include "sbinheap.h"
+
+/**
+ * Hybrid heap: a fixed-size sbinheap that spills into a binheap.
+ *
+ * Entries live in the contiguous sbinheap array while it has room. Once the
+ * array is full, further entries go to a binheap through a binheap_node
+ * embedded next to the sbinheap node. The top of the hybrid is the better of
+ * the two roots. When a slot in the array frees up, the best spilled entry
+ * migrates back into the array. Arrays can thus be sized for the common
+ * case instead of the rare burst, without allocating memory.
+ *
+ * Both comparators are supplied by the caller. They must order nodes by
+ * their 'data' pointer only (i.e., through sbinheap_entry()/binheap_entry()),
+ * since the roots of the two heaps are compared against each other.
+ */
+
+struct spillheap_node {
+	/* handle while the entry lives in the array */
+	sbinheap_node_t snode;
+
+	/* node used while the entry is spilled */
+	struct binheap_node bnode;
+};
+
+struct spillheap {
+	struct sbinheap array;
+	struct binheap spill;
+
+	/* offset of spillheap_node within the caller's struct */
+	size_t node_offset;
+};
+
+/**
+ * DECLARE_SPILLHEAP - declare a spillheap with an array of 'size' entries,
+ * for elements of type 'type' that embed their spillheap_node as 'member'.
+ * The heap is ready for use; INIT_SPILLHEAP() is not needed.
+ */
+#define DECLARE_SPILLHEAP(name, scompare, bcompare, size, type, member) \
+	struct sbinheap_node __spillheap_buf_##name[size]; \
+	struct spillheap name = { \
+		.array = {.compare = (scompare), .size = 0, .max_size = (size), \
+			.buf = __spillheap_buf_##name}, \
+		.spill = {.compare = (bcompare)}, \
+		.node_offset = offsetof(type, member)}
+
+/**
+ * spillheap_top_entry - get the struct for the node at the top of the heap.
+ * @heap:	the heap.
+ * @type:	the type of the struct the node is embedded in.
+ * @member:	unused.
+ */
+#define spillheap_top_entry(heap, type, member) \
+((type *)__spillheap_top(heap))
+
+/**
+ * spillheap_delete_root - remove the root element from the heap.
+ * @heap:	 the heap.
+ * @type (ignored):   the type of the struct the node is embedded in.
+ * @member (ignored): the name of the spillheap_node within the (type) struct.
+ */
+#define spillheap_delete_root(heap, type, member) \
+__spillheap_delete_root(heap)
+
+/**
+ * spillheap_delete - remove an arbitrary element from the heap.
+ * @to_delete:  pointer to node to be removed.
+ * @heap:	 the heap.
+ */
+#define spillheap_delete(to_delete, heap) \
+__spillheap_delete((to_delete), (heap))
+
+/**
+ * spillheap_add - insert an element to the heap
+ * new_node: node to add.
+ * @heap:	 the heap.
+ * @type (ignored):   the type of the struct the node is embedded in.
+ * @member (ignored): the name of the spillheap_node within the (type) struct.
+ * The element is located from the heap's node_offset, so every element of
+ * a heap must be of the type given at initialization.
+ */
+#define spillheap_add(new_node, heap, type, member) \
+__spillheap_add((new_node), (heap))
+
+/**
+ * spillheap_decrease - re-eval the position of a node whose value has
+ * decreased.
+ * @orig_node: node of the entry whose value has changed.
+ * @heap: the heap.
+ */
+#define spillheap_decrease(orig_node, heap) \
+__spillheap_decrease((orig_node), (heap))
+
+
+static inline void INIT_SPILLHEAP_NODE(struct spillheap_node *n)
+{
+	INIT_SBINHEAP_NODE(&n->snode);
+	INIT_BINHEAP_NODE(&n->bnode);
+}
+
+/**
+ * Initialize a heap after its array has been set up (compare, max_size and
+ * buf). 'node_offset' is offsetof() the spillheap_node in the elements'
+ * struct; it maps spilled nodes back to their elements.
+ */
+static inline void INIT_SPILLHEAP(struct spillheap *heap,
+				binheap_order_t bcompare, size_t node_offset)
+{
+	heap->array.size = 0;
+	INIT_SBINHEAP(&heap->array);
+	INIT_BINHEAP(&heap->spill, bcompare);
+	heap->node_offset = node_offset;
+}
+
+/* Returns true if spillheap is empty. */
+static inline int spillheap_empty(struct spillheap *heap)
+{
+	return sbinheap_empty(&heap->array) && binheap_empty(&heap->spill);
+}
+
+/* Returns true if the node is in a heap. */
+static inline int spillheap_is_in_heap(const struct spillheap_node *node)
+{
+	return sbinheap_is_in_heap(node->snode) ||
+		binheap_is_in_heap(&node->bnode);
+}
+
+/* Returns true if the node currently lives in the spill binheap. */
+static inline int spillheap_is_spilled(const struct spillheap_node *node)
+{
+	return binheap_is_in_heap(&node->bnode);
+}
+
+/* Returns the data pointer of the top entry, or 0 if empty. */
+void* __spillheap_top(struct spillheap *heap);
+
+/* Add a node to the array, or to the spill heap if the array is full. */
+void __spillheap_add(struct spillheap_node *new_node,
+				struct spillheap *heap);
+
+/**
+ * Removes the better of the two roots. If this frees a slot in the array,
+ * the best spilled entry migrates back into it.
+ */
+void* __spillheap_delete_root(struct spillheap *heap);
+
+/* Delete an arbitrary node. */
+void* __spillheap_delete(struct spillheap_node *node,
+				struct spillheap *heap);
+
+/* Bubble up a node whose value has decreased. */
+void __spillheap_decrease(struct spillheap_node *node,
+				struct spillheap *heap);
+
+#endif
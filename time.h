@@ -23,7 +23,7 @@ typedef enum
 	CLK_THREAD_CPUTIME
 } hosttime_t;
 
-int clk_gettime(hosttime_t clk_id, struct timespec* ts)
+static inline int clk_gettime(hosttime_t clk_id, struct timespec* ts)
 {
 	int ret = -1;
 #ifdef __MACH__
@@ -58,9 +58,9 @@ int clk_gettime(hosttime_t clk_id, struct timespec* ts)
 	return ret;
 }
 
-void timediff(const struct timespec* start,
-              const struct timespec* end,
-              struct timespec* out)
+static inline void timediff(const struct timespec* start,
+                            const struct timespec* end,
+                            struct timespec* out)
 {
 	if ((end->tv_nsec - start->tv_nsec) < 0)
 	{
@@ -0,0 +1,178 @@
+#include "timerq.h"
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+#define NSEC_PER_SEC	1000000000ull
+
+static int __timerq_less(const struct sbinheap_node *a,
+				const struct sbinheap_node *b)
+{
+	const struct timerq_node *ta = a->data;
+	const struct timerq_node *tb = b->data;
+
+	return (ta->expires < tb->expires);
+}
+
+
+/* Set the timerfd to fire at 'when', or disarm it for TIMERQ_DISARMED. */
+static void __timerq_program(struct timerq *q, timerq_time_t when)
+{
+	if(when == q->armed) {
+		return;
+	}
+
+	q->armed = when;
+
+#ifdef __linux__
+	if(q->fd >= 0) {
+		struct itimerspec its = {{0, 0}, {0, 0}};
+
+		if(when != TIMERQ_DISARMED) {
+			/* a zero it_value would disarm; 1ns is long past anyway */
+			if(unlikely(when == 0)) {
+				when = 1;
+			}
+			its.it_value.tv_sec = when / NSEC_PER_SEC;
+			its.it_value.tv_nsec = when % NSEC_PER_SEC;
+		}
+		(void)timerfd_settime(q->fd, TFD_TIMER_ABSTIME, &its, 0);
+		++q->reprograms;
+	}
+#endif
+}
+
+
+int timerq_init(struct timerq *q, struct sbinheap_node *buf, idx_t max_size)
+{
+	q->heap.compare = __timerq_less;
+	q->heap.max_size = max_size;
+	q->heap.buf = buf;
+	INIT_SBINHEAP(&q->heap);
+
+	q->armed = TIMERQ_DISARMED;
+	q->reprograms = 0;
+
+#ifdef __linux__
+	q->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(q->fd < 0) {
+		return -1;
+	}
+#else
+	q->fd = -1;
+#endif
+
+	return 0;
+}
+
+
+void timerq_destroy(struct timerq *q)
+{
+	if(q->fd >= 0) {
+		close(q->fd);
+		q->fd = -1;
+	}
+}
+
+
+timerq_time_t timerq_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (timerq_time_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+int timerq_arm(struct timerq *q, struct timerq_node *node,
+				timerq_time_t expires)
+{
+	node->expires = expires;
+	sbinheap_add(&node->hnode, &q->heap, struct timerq_node, hnode);
+	if(unlikely(!node->hnode)) {
+		return -1;
+	}
+
+	if(expires < q->armed) {
+		__timerq_program(q, expires);
+	}
+	return 0;
+}
+
+
+int timerq_rearm(struct timerq *q, struct timerq_node *node,
+				timerq_time_t expires)
+{
+	if(!timerq_is_armed(node)) {
+		return timerq_arm(q, node, expires);
+	}
+
+	if(expires == node->expires) {
+		return 0;
+	}
+
+	node->expires = expires;
+	sbinheap_update(node->hnode, &q->heap);
+
+	/* a later deadline leaves the fd armed early */
+	if(expires < q->armed) {
+		__timerq_program(q, expires);
+	}
+	return 0;
+}
+
+
+void timerq_cancel(struct timerq *q, struct timerq_node *node)
+{
+	if(timerq_is_armed(node)) {
+		/* the fd stays armed for the old root; see timerq.h */
+		sbinheap_delete(&node->hnode, &q->heap);
+	}
+}
+
+
+struct timerq_node* timerq_expire(struct timerq *q, timerq_time_t now)
+{
+	struct timerq_node *head = 0;
+	struct timerq_node **tail = &head;
+
+	while(!sbinheap_empty(&q->heap)) {
+		struct timerq_node *t =
+			sbinheap_top_entry(&q->heap, struct timerq_node, hnode);
+
+		if(t->expires > now) {
+			break;
+		}
+
+		sbinheap_delete_root(&q->heap, struct timerq_node, hnode);
+		*tail = t;
+		tail = &t->next;
+	}
+	*tail = 0;
+
+	/* the fd has fired (or is about to): aim it at the new root */
+	if(q->armed <= now) {
+		__timerq_program(q, timerq_next(q));
+	}
+
+	return head;
+}
+
+
+struct timerq_node* timerq_dispatch(struct timerq *q)
+{
+	if(q->fd >= 0) {
+		uint64_t count;
+
+		/* clear readability; EAGAIN just means a spurious poll */
+		while(read(q->fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+		}
+	}
+
+	return timerq_expire(q, timerq_now());
+}
@@ -0,0 +1,145 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "sbinheap.h"
+
+/**
+ * Event-loop timer queue: an sbinheap of deadlines behind a Linux timerfd.
+ *
+ * The timerfd is added to the caller's epoll/poll set. It becomes readable
+ * when the earliest timer is due, and timerq_dispatch() then returns every
+ * expired timer at once.
+ *
+ * Setting the timerfd after each heap change costs one timerfd_settime()
+ * per arm, rearm and cancel. Most of those calls are redundant: the fd only
+ * has to fire no later than the earliest deadline. timerq therefore
+ * reprograms it only when the root moves earlier than the armed time, and
+ * once after each expiry pass. A cancel or rearm that moves the root later
+ * leaves the fd armed early. That costs at most one spurious wakeup, and
+ * the dispatch that handles it sets the fd to the real deadline.
+ *
+ * Like sbinheap, memory is provided by the caller: a timerq_node is
+ * embedded in the caller's timer struct and the heap buffer is passed to
+ * timerq_init(). Times are absolute CLOCK_MONOTONIC nanoseconds.
+ *
+ * On systems without timerfd, fd is -1 and the caller polls timerq_next().
+ */
+
+typedef uint64_t timerq_time_t;
+
+/* armed time when the timerfd is disarmed; later than any deadline */
+#define TIMERQ_DISARMED	UINT64_MAX
+
+struct timerq_node {
+	timerq_time_t expires;
+
+	sbinheap_node_t hnode;
+
+	/* links the timers returned by timerq_expire() */
+	struct timerq_node *next;
+};
+
+struct timerq {
+	struct sbinheap heap;
+
+	/* timerfd, or -1 */
+	int fd;
+
+	/* deadline the timerfd is set to; never later than the root's */
+	timerq_time_t armed;
+
+	/* number of timerfd_settime() calls */
+	unsigned long reprograms;
+};
+
+
+/**
+ * timerq_entry - get the struct for this timer.
+ * @ptr:	the timerq_node.
+ * @type:	the type of struct the node is embedded in.
+ * @member:	the name of the timerq_node within the (type) struct.
+ */
+#define timerq_entry(ptr, type, member) \
+container_of((ptr), type, member)
+
+
+static inline void INIT_TIMERQ_NODE(struct timerq_node *n)
+{
+	n->expires = 0;
+	INIT_SBINHEAP_NODE(&n->hnode);
+	n->next = 0;
+}
+
+/**
+ * Initialize a queue of up to max_size timers in 'buf' and create its
+ * timerfd. Returns 0, or -1 with errno set if the timerfd cannot be
+ * created.
+ */
+int timerq_init(struct timerq *q, struct sbinheap_node *buf, idx_t max_size);
+
+/* Close the timerfd. Pending timers are dropped. */
+void timerq_destroy(struct timerq *q);
+
+/* The fd to poll for readability, or -1. */
+static inline int timerq_fd(const struct timerq *q)
+{
+	return q->fd;
+}
+
+/* Returns true if the timer is armed. */
+static inline int timerq_is_armed(const struct timerq_node *n)
+{
+	return sbinheap_is_in_heap(n->hnode);
+}
+
+static inline int timerq_empty(struct timerq *q)
+{
+	return sbinheap_empty(&q->heap);
+}
+
+/* Deadline of the earliest timer, or TIMERQ_DISARMED if there is none. */
+static inline timerq_time_t timerq_next(struct timerq *q)
+{
+	if(sbinheap_empty(&q->heap)) {
+		return TIMERQ_DISARMED;
+	}
+	return sbinheap_top_entry(&q->heap, struct timerq_node, hnode)->expires;
+}
+
+/* Current CLOCK_MONOTONIC time in nanoseconds. */
+timerq_time_t timerq_now(void);
+
+/**
+ * Arm a timer to expire at 'expires'. The timer must not be armed.
+ * Returns 0, or -1 if the queue is full.
+ */
+int timerq_arm(struct timerq *q, struct timerq_node *node,
+				timerq_time_t expires);
+
+/**
+ * Move a timer's deadline to 'expires', arming it if it is not armed.
+ * Returns 0, or -1 if the timer was not armed and the queue is full.
+ */
+int timerq_rearm(struct timerq *q, struct timerq_node *node,
+				timerq_time_t expires);
+
+/* Disarm a timer. Does nothing if it is not armed. */
+void timerq_cancel(struct timerq *q, struct timerq_node *node);
+
+/**
+ * Remove every timer with expires <= now and return them linked through
+ * 'next' in deadline order, or 0 if none has expired. The timerfd is
+ * reprogrammed at most once, for the new earliest deadline.
+ */
+struct timerq_node* timerq_expire(struct timerq *q, timerq_time_t now);
+
+/**
+ * Handle readability of the timerfd: consume its expiration count, then
+ * timerq_expire() at the current time.
+ */
+struct timerq_node* timerq_dispatch(struct timerq *q);
+
+#endif
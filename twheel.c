@@ -0,0 +1,222 @@
+#include "twheel.h"
+
+/* shift that selects the slot index at level k */
+#define __slot_shift(k) (TWHEEL_BITS * ((k) + 1))
+
+
+/* Heap order: earliest expiration first. */
+int __twheel_less(const struct binheap_node *a, const struct binheap_node *b)
+{
+	const struct twheel_node *ta = a->data;
+	const struct twheel_node *tb = b->data;
+
+	return (ta->expires < tb->expires);
+}
+
+
+static inline int __list_empty(const struct twheel_list *head)
+{
+	return (head->next == head);
+}
+
+static inline void __list_add(struct twheel_list *head,
+				struct twheel_list *n)
+{
+	n->next = head->next;
+	n->prev = head;
+	head->next->prev = n;
+	head->next = n;
+}
+
+static inline void __list_del(struct twheel_list *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	n->next = 0;
+	n->prev = 0;
+}
+
+/* Move all entries of 'from' onto the (empty) list 'to'. */
+static inline void __list_splice(struct twheel_list *from,
+				struct twheel_list *to)
+{
+	if(__list_empty(from)) {
+		__twheel_list_init(to);
+		return;
+	}
+
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+
+	__twheel_list_init(from);
+}
+
+
+/* File a timer relative to the current time. */
+static void __twheel_place(struct twheel *wheel, struct twheel_node *node)
+{
+	const twheel_time_t t = node->expires;
+	const twheel_time_t now = wheel->now;
+	int k;
+
+	if((t >> TWHEEL_BITS) <= (now >> TWHEEL_BITS)) {
+		/* expires in the current block (or already expired) */
+		__binheap_add(&node->heap_node, &wheel->heap, node);
+		return;
+	}
+
+	/* lowest level whose span contains both 'now' and 't' */
+	for(k = 0; k < TWHEEL_LEVELS; ++k) {
+		if((t >> __slot_shift(k + 1)) == (now >> __slot_shift(k + 1))) {
+			int s = (int)((t >> __slot_shift(k)) & TWHEEL_MASK);
+
+			__list_add(&wheel->slots[k][s], &node->link);
+			wheel->occupied[k] |= (1ULL << s);
+			return;
+		}
+	}
+
+	__list_add(&wheel->overflow, &node->link);
+}
+
+
+/* Re-file every timer on a detached list. */
+static void __twheel_refile(struct twheel *wheel, struct twheel_list *head)
+{
+	struct twheel_list pending;
+
+	__list_splice(head, &pending);
+
+	while(!__list_empty(&pending)) {
+		struct twheel_list *l = pending.next;
+
+		__list_del(l);
+		__twheel_place(wheel,
+			container_of(l, struct twheel_node, link));
+	}
+}
+
+
+/* Cascade the slots whose time begins at wheel->now. */
+static void __twheel_cascade(struct twheel *wheel)
+{
+	const twheel_time_t t = wheel->now;
+	int k;
+
+	if((t & ((1ULL << __slot_shift(TWHEEL_LEVELS)) - 1)) == 0) {
+		__twheel_refile(wheel, &wheel->overflow);
+	}
+
+	/* top-down, so entries may drop through several levels at once */
+	for(k = TWHEEL_LEVELS - 1; k >= 0; --k) {
+		int s;
+
+		if((t & ((1ULL << __slot_shift(k)) - 1)) != 0) {
+			continue;
+		}
+
+		s = (int)((t >> __slot_shift(k)) & TWHEEL_MASK);
+		if(wheel->occupied[k] & (1ULL << s)) {
+			wheel->occupied[k] &= ~(1ULL << s);
+			__twheel_refile(wheel, &wheel->slots[k][s]);
+		}
+	}
+}
+
+
+/**
+ * Earliest time after wheel->now at which a cascade could be needed.
+ * Returns 0 if the wheel (excluding the heap) is empty.
+ */
+static twheel_time_t __twheel_next_cascade(const struct twheel *wheel)
+{
+	const twheel_time_t now = wheel->now;
+	twheel_time_t next = 0;
+	int k;
+
+	for(k = 0; k < TWHEEL_LEVELS; ++k) {
+		int cur = (int)((now >> __slot_shift(k)) & TWHEEL_MASK);
+		uint64_t later;
+
+		/* slots at or before 'cur' never hold entries for this span */
+		later = (cur == TWHEEL_MASK) ? 0 :
+			(wheel->occupied[k] & ~((2ULL << cur) - 1));
+		if(later) {
+			twheel_time_t base =
+				(now >> __slot_shift(k + 1)) << __slot_shift(k + 1);
+			twheel_time_t when = base +
+				((twheel_time_t)__builtin_ctzll(later) << __slot_shift(k));
+
+			if(!next || when < next) {
+				next = when;
+			}
+		}
+	}
+
+	if(!__list_empty(&wheel->overflow)) {
+		twheel_time_t when =
+			((now >> __slot_shift(TWHEEL_LEVELS)) + 1) <<
+				__slot_shift(TWHEEL_LEVELS);
+
+		if(!next || when < next) {
+			next = when;
+		}
+	}
+
+	return next;
+}
+
+
+void twheel_add(struct twheel_node *node, struct twheel *wheel,
+				twheel_time_t expires)
+{
+	node->expires = expires;
+	__twheel_place(wheel, node);
+}
+
+
+void twheel_cancel(struct twheel_node *node, struct twheel *wheel)
+{
+	if(node->link.next != 0) {
+		/* slot bit is left set; the next cascade clears it */
+		__list_del(&node->link);
+	}
+	else if(binheap_is_in_heap(&node->heap_node)) {
+		binheap_delete(&node->heap_node, &wheel->heap);
+	}
+}
+
+
+void twheel_advance(struct twheel *wheel, twheel_time_t now)
+{
+	twheel_time_t next;
+
+	while(((next = __twheel_next_cascade(wheel)) != 0) && (next <= now)) {
+		wheel->now = next;
+		__twheel_cascade(wheel);
+	}
+
+	if(now > wheel->now) {
+		wheel->now = now;
+	}
+}
+
+
+struct twheel_node* twheel_expire(struct twheel *wheel)
+{
+	struct twheel_node *top;
+
+	if(binheap_empty(&wheel->heap)) {
+		return 0;
+	}
+
+	top = binheap_top_entry(&wheel->heap, struct twheel_node, heap_node);
+	if(top->expires > wheel->now) {
+		return 0;
+	}
+
+	(void)binheap_delete_root(&wheel->heap, struct twheel_node, heap_node);
+	return top;
+}
@@ -0,0 +1,139 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#include "defs.h"
+#include "binheap.h"
+
+/**
+ * Hierarchical timing wheel that feeds a binheap.
+ *
+ * Most timers are cancelled before they expire, yet a timer kept in a heap
+ * pays a sift on both insert and cancel. Here, timers that expire far in the
+ * future are hashed into the slots of a hierarchical timing wheel, where
+ * insert and cancel are O(1). Entries cascade down the wheel as time
+ * advances and only enter the binheap once they expire within the current
+ * block of TWHEEL_SLOTS ticks. Near timers thus keep exact expiration order.
+ *
+ * Level k slots span TWHEEL_SLOTS^(k+1) ticks. Timers beyond the reach of
+ * the top level wait on an overflow list that is re-examined each time the
+ * top level wraps.
+ *
+ * Like binheap, memory is provided by the caller: a twheel_node is embedded
+ * in the caller's timer struct. No dynamic memory is allocated.
+ */
+
+typedef uint64_t twheel_time_t;
+
+#define TWHEEL_BITS	6
+#define TWHEEL_SLOTS	(1 << TWHEEL_BITS)
+#define TWHEEL_MASK	(TWHEEL_SLOTS - 1)
+#define TWHEEL_LEVELS	4
+
+/* Circular doubly-linked list used for wheel slots. */
+struct twheel_list {
+	struct twheel_list *next;
+	struct twheel_list *prev;
+};
+
+struct twheel_node {
+	/* slot membership while the timer sits in the wheel */
+	struct twheel_list link;
+
+	/* heap membership once the timer is near */
+	struct binheap_node heap_node;
+
+	twheel_time_t expires;
+};
+
+struct twheel {
+	/* current time, in ticks */
+	twheel_time_t now;
+
+	/* timers expiring within the current block */
+	struct binheap heap;
+
+	/* per-level slot occupancy. Bits may be stale after a cancel. */
+	uint64_t occupied[TWHEEL_LEVELS];
+
+	/* timers beyond the reach of the top level */
+	struct twheel_list overflow;
+
+	struct twheel_list slots[TWHEEL_LEVELS][TWHEEL_SLOTS];
+};
+
+
+/**
+ * twheel_entry - get the struct for this timer.
+ * @ptr:	the twheel_node.
+ * @type:	the type of struct the node is embedded in.
+ * @member:	the name of the twheel_node within the (type) struct.
+ */
+#define twheel_entry(ptr, type, member) \
+container_of((ptr), type, member)
+
+
+static inline void INIT_TWHEEL_NODE(struct twheel_node *n)
+{
+	n->link.next = 0;
+	n->link.prev = 0;
+	INIT_BINHEAP_NODE(&n->heap_node);
+	n->expires = 0;
+}
+
+static inline void __twheel_list_init(struct twheel_list *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+int __twheel_less(const struct binheap_node *a, const struct binheap_node *b);
+
+static inline void INIT_TWHEEL(struct twheel *wheel, twheel_time_t now)
+{
+	int k, s;
+
+	wheel->now = now;
+	INIT_BINHEAP(&wheel->heap, __twheel_less);
+	__twheel_list_init(&wheel->overflow);
+	for(k = 0; k < TWHEEL_LEVELS; ++k) {
+		wheel->occupied[k] = 0;
+		for(s = 0; s < TWHEEL_SLOTS; ++s) {
+			__twheel_list_init(&wheel->slots[k][s]);
+		}
+	}
+}
+
+/* Returns true if the timer is armed (in the wheel or in the heap). */
+static inline int twheel_is_pending(const struct twheel_node *n)
+{
+	return (n->link.next != 0) || binheap_is_in_heap(&n->heap_node);
+}
+
+/**
+ * Arm a timer to expire at absolute time 'expires'. The timer must not
+ * already be pending. O(1) unless the timer falls in the current block.
+ */
+void twheel_add(struct twheel_node *node, struct twheel *wheel,
+				twheel_time_t expires);
+
+/**
+ * Disarm a pending timer. O(1) unless the timer has already been cascaded
+ * into the heap.
+ */
+void twheel_cancel(struct twheel_node *node, struct twheel *wheel);
+
+/**
+ * Move the wheel's clock forward to 'now', cascading slots as their time
+ * arrives. Empty stretches of the wheel are skipped.
+ */
+void twheel_advance(struct twheel *wheel, twheel_time_t now);
+
+/**
+ * Remove and return the earliest timer with expires <= now, or 0 if no
+ * timer has expired. Call repeatedly after twheel_advance().
+ */
+struct twheel_node* twheel_expire(struct twheel *wheel);
+
+#endif